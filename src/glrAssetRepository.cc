@@ -1,83 +1,165 @@
 #include "glrender/glrAssetRepository.hh"
 
-#include <memory>
-#include <unordered_map>
+#include "glrender/glrAssetTable.hh"
+#include "glrender/glrStateCache.hh"
 
 #include "glad/gl.hh"
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+
 namespace glr::asset_repo
 {
-  std::unordered_map<ID, std::shared_ptr<Shader>> shaders{};
-  std::unordered_map<ID, std::shared_ptr<Texture>> textures{};
-  std::unordered_map<ID, std::shared_ptr<Mesh>> meshes{};
-  std::unordered_map<ID, std::shared_ptr<Framebuffer>> fbos{};
-  std::unordered_map<ID, std::shared_ptr<Atlas>> atlases{};
-  std::unordered_map<ID, std::shared_ptr<ShaderPipeline>> shaderPipelines{};
-
-  ID lastShader = 0;
-  ID lastTexture = 0;
-  ID lastMesh = 0;
-  ID lastFBO = 0;
-  ID lastAtlas = 0;
-  ID lastShaderPipeline = 0;
+  AssetTable<Shader> shaders{};
+  AssetTable<Texture> textures{};
+  AssetTable<Mesh> meshes{};
+  AssetTable<Framebuffer> fbos{};
+  AssetTable<Atlas> atlases{};
+  AssetTable<ShaderPipeline> shaderPipelines{};
+
+  //Deferred creation requests, pushed onto a lock-free stack by any thread and moved into the backlog by the GL thread
+  struct QueuedCreation
+  {
+    std::function<void()> create{};
+    QueuedCreation* next = nullptr;
+  };
+
+  std::atomic<QueuedCreation*> incoming = nullptr;
+  std::deque<std::unique_ptr<QueuedCreation>> backlog{};
+
+  void enqueue(std::function<void()>&& create)
+  {
+    QueuedCreation* item = new QueuedCreation{std::move(create), incoming.load(std::memory_order_relaxed)};
+    while(!incoming.compare_exchange_weak(item->next, item, std::memory_order_release, std::memory_order_relaxed)) {}
+  }
 
   //Management
   ID newShader(const std::string& shaderName, const std::string& vertSrc, const std::string& fragSrc)
   {
-    const ID out = lastShader;
-    lastShader++;
-    shaders[out] = std::make_shared<Shader>(shaderName, vertSrc, fragSrc);
-    return out;
+    return shaders.emplace(shaderName, vertSrc, fragSrc);
   }
   
   ID newShader(const std::string& shaderName, const std::string& compSrc)
   {
-    const ID out = lastShader;
-    lastShader++;
-    shaders[out] = std::make_shared<Shader>(shaderName, compSrc);
-    return out;
+    return shaders.emplace(shaderName, compSrc);
   }
 
   ID newTexture(const std::string& textureName, const uint8_t* data, const uint32_t width, const uint32_t height, const uint8_t channels, const GLRFilterMode min, const GLRFilterMode mag, const bool sRGB)
   {
-    const ID out = lastTexture;
-    lastTexture++;
-    textures[out] = std::make_shared<Texture>(textureName, data, width, height, channels, min, mag, sRGB);
-    return out;
+    return textures.emplace(textureName, data, width, height, channels, min, mag, sRGB);
+  }
+  
+  ID newTexture(const std::string& textureName, const GLRCompressedFormat format, const uint8_t* data, const size_t dataSize, const uint32_t width, const uint32_t height, const uint32_t levels, const GLRFilterMode min, const GLRFilterMode mag)
+  {
+    return textures.emplace(textureName, format, data, dataSize, width, height, levels, min, mag);
+  }
+  
+  ID newTextureArray(const std::string& textureName, const uint32_t width, const uint32_t height, const uint8_t channels, const uint32_t layers, const GLRFilterMode min, const GLRFilterMode mag, const bool sRGB)
+  {
+    return textures.emplace(textureName, width, height, channels, layers, min, mag, sRGB);
   }
   
   ID newMesh()
   {
-    const ID out = lastMesh;
-    lastMesh++;
-    meshes[out] = std::make_shared<Mesh>();
-    return out;
+    return meshes.emplace();
   }
   
   ID newFBO()
   {
-    const ID out = lastFBO;
-    lastFBO++;
-    fbos[out] = std::make_shared<Framebuffer>();
-    return out;
+    return fbos.emplace();
   }
 
   ID newAtlas()
   {
-    const ID out = lastAtlas;
-    lastAtlas++;
-    atlases[out] = std::make_shared<Atlas>();
-    return out;
+    return atlases.emplace();
   }
   
   ID newShaderPipeline()
   {
-    const ID out = lastShaderPipeline;
-    lastShaderPipeline++;
-    shaderPipelines[out] = std::make_shared<ShaderPipeline>();
+    return shaderPipelines.emplace();
+  }
+
+  ID queueShader(const std::string& shaderName, std::string vertSrc, std::string fragSrc)
+  {
+    const ID out = shaders.reserve();
+    enqueue([out, shaderName, vertSrc = std::move(vertSrc), fragSrc = std::move(fragSrc)]
+    {
+      shaders.emplaceAt(out, shaderName, vertSrc, fragSrc);
+    });
+    return out;
+  }
+
+  ID queueShader(const std::string& shaderName, std::string compSrc)
+  {
+    const ID out = shaders.reserve();
+    enqueue([out, shaderName, compSrc = std::move(compSrc)]
+    {
+      shaders.emplaceAt(out, shaderName, compSrc);
+    });
+    return out;
+  }
+
+  ID queueTexture(const std::string& textureName, const uint32_t width, const uint32_t height, const uint8_t channels, const GLRFilterMode min, const GLRFilterMode mag, const bool sRGB)
+  {
+    const ID out = textures.reserve();
+    enqueue([out, textureName, width, height, channels, min, mag, sRGB]
+    {
+      textures.emplaceAt(out, textureName, width, height, channels, min, mag, sRGB);
+    });
+    return out;
+  }
+
+  ID queueTexture(const std::string& textureName, std::vector<uint8_t> data, const uint32_t width, const uint32_t height, const uint8_t channels, const GLRFilterMode min, const GLRFilterMode mag, const bool sRGB)
+  {
+    const ID out = textures.reserve();
+    enqueue([out, textureName, data = std::move(data), width, height, channels, min, mag, sRGB]
+    {
+      textures.emplaceAt(out, textureName, data.data(), width, height, channels, min, mag, sRGB);
+    });
     return out;
   }
 
+  bool textureIsQueued(const ID texture)
+  {
+    return textures.pending(texture);
+  }
+
+  size_t createQueued(const std::chrono::microseconds budget)
+  {
+    //The stack holds the newest request first, reverse it so assets are created in the order they were queued
+    QueuedCreation* head = incoming.exchange(nullptr, std::memory_order_acquire);
+    QueuedCreation* oldest = nullptr;
+    while(head)
+    {
+      QueuedCreation* next = head->next;
+      head->next = oldest;
+      oldest = head;
+      head = next;
+    }
+    while(oldest)
+    {
+      QueuedCreation* next = oldest->next;
+      backlog.emplace_back(oldest);
+      oldest = next;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + budget;
+    do
+    {
+      if(backlog.empty())
+      {
+        break;
+      }
+      std::unique_ptr<QueuedCreation> item = std::move(backlog.front());
+      backlog.pop_front();
+      item->create();
+    }
+    while(std::chrono::steady_clock::now() < deadline);
+    return backlog.size();
+  }
+
   bool shaderExists(const ID shader)
   {
     return shaders.contains(shader);
@@ -110,50 +192,32 @@ namespace glr::asset_repo
   
   void deleteShader(const ID shader)
   {
-    if(shaders.contains(shader))
-    {
-      shaders.erase(shader);
-    }
+    shaders.erase(shader);
   }
   
   void deleteTexture(const ID texture)
   {
-    if(textures.contains(texture))
-    {
-      textures.erase(texture);
-    }
+    textures.erase(texture);
   }
   
   void deleteMesh(const ID mesh)
   {
-    if(meshes.contains(mesh))
-    {
-      meshes.erase(mesh);
-    }
+    meshes.erase(mesh);
   }
   
   void deleteFBO(const ID fbo)
   {
-    if(fbos.contains(fbo))
-    {
-      fbos.erase(fbo);
-    }
+    fbos.erase(fbo);
   }
 
   void deleteAtlas(const ID atlas)
   {
-    if(atlases.contains(atlas))
-    {
-      atlases.erase(atlas);
-    }
+    atlases.erase(atlas);
   }
 
   void deleteShaderPipeline(const ID shaderPipeline)
   {
-    if(shaderPipelines.contains(shaderPipeline))
-    {
-      shaderPipelines.erase(shaderPipeline);
-    }
+    shaderPipelines.erase(shaderPipeline);
   }
 
   void deleteShaders()
@@ -225,6 +289,15 @@ namespace glr::asset_repo
     }
     shaders.at(shader)->sendUniforms();
   }
+  
+  Shader* shaderGet(const ID shader)
+  {
+    if(!shaders.contains(shader))
+    {
+      return nullptr;
+    }
+    return shaders.at(shader);
+  }
 
   //Texture
   void textureUse(const ID texture)
@@ -242,7 +315,7 @@ namespace glr::asset_repo
     {
       return;
     }
-    glBindImageTexture(target, textures.at(texture)->handle, 0, GL_FALSE, 0, (uint32_t)mode, (uint32_t)format);
+    stateCache().bindImage(target, textures.at(texture)->handle, mode, format);
   }
 
   void textureSetBindingTarget(const ID texture, const uint32_t target)
@@ -290,6 +363,42 @@ namespace glr::asset_repo
     textures.at(texture)->clear();
   }
   
+  void textureGenerateMipmaps(const ID texture)
+  {
+    if(!textures.contains(texture))
+    {
+      return;
+    }
+    textures.at(texture)->generateMipmaps();
+  }
+  
+  uint32_t textureAddLayer(const ID textureArray, const uint8_t* data)
+  {
+    if(!textures.contains(textureArray))
+    {
+      return INVALID_HANDLE;
+    }
+    return textures.at(textureArray)->addLayer(data);
+  }
+  
+  uint32_t textureAddLayer(const ID textureArray, const ID source)
+  {
+    if(!textures.contains(textureArray) || !textures.contains(source))
+    {
+      return INVALID_HANDLE;
+    }
+    return textures.at(textureArray)->addLayer(*textures.at(source));
+  }
+  
+  uint64_t textureGetBindlessHandle(const ID texture)
+  {
+    if(!textures.contains(texture))
+    {
+      return 0;
+    }
+    return textures.at(texture)->bindlessHandle();
+  }
+  
   DownloadedImageData textureDownload(const ID texture, const uint8_t channels)
   {
     if(!textures.contains(texture))
@@ -308,6 +417,24 @@ namespace glr::asset_repo
     return textures.at(texture)->handle;
   }
 
+  uint32_t textureGetLevels(const ID texture)
+  {
+    if(!textures.contains(texture))
+    {
+      return 0;
+    }
+    return textures.at(texture)->levels;
+  }
+
+  uint32_t textureGetBindingTarget(const ID texture)
+  {
+    if(!textures.contains(texture))
+    {
+      return INVALID_HANDLE;
+    }
+    return textures.at(texture)->bindingIndex;
+  }
+
   //Mesh
   void meshUse(const ID mesh)
   {
@@ -443,6 +570,51 @@ namespace glr::asset_repo
     }
     return meshes.at(mesh)->drawType;
   }
+  
+  GLRIndexBufferType meshGetIndexType(const ID mesh)
+  {
+    if(!meshes.contains(mesh))
+    {
+      return GLRIndexBufferType::UINT;
+    }
+    return meshes.at(mesh)->indexType;
+  }
+
+  uint32_t meshGetVertexArray(const ID mesh)
+  {
+    if(!meshes.contains(mesh))
+    {
+      return INVALID_HANDLE;
+    }
+    return meshes.at(mesh)->vertexArray();
+  }
+
+  uint32_t meshGetBaseVertex(const ID mesh)
+  {
+    if(!meshes.contains(mesh))
+    {
+      return 0;
+    }
+    return meshes.at(mesh)->baseVertex();
+  }
+
+  uint32_t meshGetFirstIndex(const ID mesh)
+  {
+    if(!meshes.contains(mesh))
+    {
+      return 0;
+    }
+    return meshes.at(mesh)->firstIndex();
+  }
+
+  float meshGetBoundingRadius(const ID mesh)
+  {
+    if(!meshes.contains(mesh))
+    {
+      return 0.0f;
+    }
+    return meshes.at(mesh)->boundingRadius();
+  }
 
   //Framebuffer
   void fboUse(const ID fbo)
@@ -588,7 +760,7 @@ namespace glr::asset_repo
     {
       return;
     }
-    shaderPipelines.at(shaderPipeline)->append(shaders.at(shader).get());
+    shaderPipelines.at(shaderPipeline)->append(shaders.at(shader));
   }
   
   void shaderPipelineSendUniforms(const ID shaderPipeline)
@@ -0,0 +1,363 @@
+#include "glrender/glrCulling.hh"
+#include "glrender/glrWorkerPool.hh"
+
+#include <glad/gl.hh>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace glr
+{
+  constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+  constexpr size_t CULL_MIN_SPHERES_PER_THREAD = 4096;
+  constexpr GLbitfield CULL_READBACK_FLAGS = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  std::string cullComp =
+R"(#version 460 core
+
+layout(local_size_x = 64) in;
+
+struct CullInput
+{
+  vec4 sphere;
+  uint multiDraw;
+  uint outputBase;
+  uint source;
+  uint indexed;
+};
+
+layout(std430, binding = 3) readonly buffer Inputs { CullInput inputs[]; };
+layout(std430, binding = 4) readonly buffer ElementCommands { uint elementCommands[]; };
+layout(std430, binding = 5) readonly buffer ArrayCommands { uint arrayCommands[]; };
+layout(std430, binding = 6) writeonly buffer CulledElementCommands { uint culledElementCommands[]; };
+layout(std430, binding = 7) writeonly buffer CulledArrayCommands { uint culledArrayCommands[]; };
+layout(std430, binding = 8) buffer Counts { uint counts[]; };
+
+uniform vec4 planes[6];
+uniform uint inputCount;
+
+void main()
+{
+  uint id = gl_GlobalInvocationID.x;
+  if(id >= inputCount)
+  {
+    return;
+  }
+
+  CullInput item = inputs[id];
+  for(int i = 0; i < 6; i++)
+  {
+    if(dot(planes[i].xyz, item.sphere.xyz) + planes[i].w < -item.sphere.w)
+    {
+      return;
+    }
+  }
+
+  uint slot = item.outputBase + atomicAdd(counts[item.multiDraw], 1);
+  if(item.indexed != 0)
+  {
+    for(uint word = 0; word < 5; word++)
+    {
+      culledElementCommands[slot * 5 + word] = elementCommands[item.source * 5 + word];
+    }
+  }
+  else
+  {
+    for(uint word = 0; word < 4; word++)
+    {
+      culledArrayCommands[slot * 4 + word] = arrayCommands[item.source * 4 + word];
+    }
+  }
+})";
+
+  Frustum frustumFromMatrix(const mat4x4<float>& viewProjection)
+  {
+    //Each plane is the sum or difference of the last row and one of the others, data is column major
+    const auto row = [&](const int32_t index)
+    {
+      return vec4<float>{viewProjection.data[0][index], viewProjection.data[1][index], viewProjection.data[2][index], viewProjection.data[3][index]};
+    };
+    const vec4<float> w = row(3);
+
+    Frustum out{};
+    for(int32_t axis = 0; axis < 3; axis++)
+    {
+      const vec4<float> r = row(axis);
+      out.planes[axis * 2] = {w.x() + r.x(), w.y() + r.y(), w.z() + r.z(), w.w() + r.w()};
+      out.planes[axis * 2 + 1] = {w.x() - r.x(), w.y() - r.y(), w.z() - r.z(), w.w() - r.w()};
+    }
+
+    for(vec4<float>& plane : out.planes)
+    {
+      const float length = std::sqrt(plane.x() * plane.x() + plane.y() * plane.y() + plane.z() * plane.z());
+      if(length > 0.0f)
+      {
+        plane = {plane.x() / length, plane.y() / length, plane.z() / length, plane.w() / length};
+      }
+    }
+    return out;
+  }
+
+  Bounds frustumBounds(const Frustum& frustum)
+  {
+    constexpr float unbounded = std::numeric_limits<float>::max();
+    Bounds out{{unbounded, unbounded, unbounded}, {-unbounded, -unbounded, -unbounded}};
+
+    //Every corner is where one of the left/right, bottom/top and near/far planes meet
+    for(int32_t corner = 0; corner < 8; corner++)
+    {
+      const vec4<float>& a = frustum.planes[corner & 1];
+      const vec4<float>& b = frustum.planes[2 + (corner >> 1 & 1)];
+      const vec4<float>& c = frustum.planes[4 + (corner >> 2 & 1)];
+      const auto cross = [](const vec4<float>& u, const vec4<float>& v)
+      {
+        return vec3<float>{u.y() * v.z() - u.z() * v.y(), u.z() * v.x() - u.x() * v.z(), u.x() * v.y() - u.y() * v.x()};
+      };
+      const vec3<float> bc = cross(b, c);
+      const vec3<float> ca = cross(c, a);
+      const vec3<float> ab = cross(a, b);
+      const float denominator = a.x() * bc.x() + a.y() * bc.y() + a.z() * bc.z();
+      if(std::abs(denominator) < 1e-6f)
+      {
+        return {{-unbounded, -unbounded, -unbounded}, {unbounded, unbounded, unbounded}};
+      }
+
+      for(int32_t axis = 0; axis < 3; axis++)
+      {
+        const float value = -(a.w() * bc.data[axis] + b.w() * ca.data[axis] + c.w() * ab.data[axis]) / denominator;
+        out.min.data[axis] = std::min(out.min.data[axis], value);
+        out.max.data[axis] = std::max(out.max.data[axis], value);
+      }
+    }
+    return out;
+  }
+
+  bool sphereVisible(const Frustum& frustum, const vec3<float>& center, const float radius)
+  {
+    for(const vec4<float>& plane : frustum.planes)
+    {
+      if(plane.x() * center.x() + plane.y() * center.y() + plane.z() * center.z() + plane.w() < -radius)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  size_t cullRange(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius, uint8_t* visible, const size_t first, const size_t last)
+  {
+    std::fill(visible + first, visible + last, 1);
+    for(const vec4<float>& plane : frustum.planes)
+    {
+      const float a = plane.x();
+      const float b = plane.y();
+      const float c = plane.z();
+      const float d = plane.w();
+      for(size_t i = first; i < last; i++)
+      {
+        visible[i] &= (uint8_t)(a * x[i] + b * y[i] + c * z[i] + d >= -radius[i]);
+      }
+    }
+
+    size_t out = 0;
+    for(size_t i = first; i < last; i++)
+    {
+      out += visible[i];
+    }
+    return out;
+  }
+
+  size_t cullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius, uint8_t* visible, const size_t count, const uint32_t threads)
+  {
+    //Small counts aren't worth splitting up
+    const size_t wanted = std::clamp<size_t>(count / CULL_MIN_SPHERES_PER_THREAD, 1, std::max(threads, 1u));
+    if(wanted == 1)
+    {
+      return cullRange(frustum, x, y, z, radius, visible, 0, count);
+    }
+
+    const size_t workers = std::min<size_t>(wanted, workerPool().size());
+    const size_t perWorker = (count + workers - 1) / workers;
+    std::vector<size_t> counts(workers, 0);
+    workerPool().run(workers, [&](const size_t worker)
+    {
+      counts[worker] = cullRange(frustum, x, y, z, radius, visible, worker * perWorker, std::min((worker + 1) * perWorker, count));
+    });
+
+    size_t out = 0;
+    for(const size_t workerCount : counts)
+    {
+      out += workerCount;
+    }
+    return out;
+  }
+
+  GpuCuller::GpuCuller()
+  {
+    this->shader = std::make_unique<Shader>("Cull Shader", cullComp);
+    this->planesLocation = glGetUniformLocation(this->shader->handle, "planes");
+    this->inputCountLocation = glGetUniformLocation(this->shader->handle, "inputCount");
+  }
+
+  GpuCuller::~GpuCuller()
+  {
+    glDeleteSync((GLsync)this->fence);
+    glDeleteBuffers(1, &this->inputBuffer.handle);
+    glDeleteBuffers(1, &this->culledElements.handle);
+    glDeleteBuffers(1, &this->culledArrays.handle);
+    glDeleteBuffers(1, &this->countBuffer.handle);
+    glDeleteBuffers(1, &this->readback.handle);
+  }
+
+  bool GpuCuller::supported()
+  {
+    return GLAD_GL_VERSION_4_6;
+  }
+
+  void GpuCuller::reserve(Buffer& buffer, const size_t size)
+  {
+    //Buffer storage is immutable, so a buffer that's too small is replaced, they're only ever grown
+    if(buffer.handle != INVALID_HANDLE && size <= buffer.capacity)
+    {
+      return;
+    }
+    if(buffer.handle != INVALID_HANDLE)
+    {
+      glDeleteBuffers(1, &buffer.handle);
+    }
+    buffer.capacity = std::max({size, buffer.capacity * 2, sizeof(uint32_t)});
+    glCreateBuffers(1, &buffer.handle);
+    glNamedBufferStorage(buffer.handle, (GLsizeiptr)buffer.capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  }
+
+  void GpuCuller::reserveReadback(const size_t size)
+  {
+    if(size <= this->readback.capacity)
+    {
+      return;
+    }
+    Buffer grown{};
+    grown.capacity = std::max(size, this->readback.capacity * 2);
+    glCreateBuffers(1, &grown.handle);
+    glNamedBufferStorage(grown.handle, (GLsizeiptr)grown.capacity, nullptr, CULL_READBACK_FLAGS | GL_CLIENT_STORAGE_BIT);
+
+    //Counts already copied from earlier passes this frame are kept
+    const size_t copied = this->frameDraws * sizeof(uint32_t);
+    if(copied > 0)
+    {
+      glCopyNamedBufferSubData(this->readback.handle, grown.handle, 0, 0, (GLsizeiptr)copied);
+    }
+    if(this->readback.handle != INVALID_HANDLE)
+    {
+      glUnmapNamedBuffer(this->readback.handle);
+      glDeleteBuffers(1, &this->readback.handle);
+    }
+    this->readback = grown;
+    this->mapped = (uint32_t*)glMapNamedBufferRange(this->readback.handle, 0, (GLsizeiptr)this->readback.capacity, CULL_READBACK_FLAGS);
+  }
+
+  void GpuCuller::cull(const Frustum& frustum, const std::vector<GpuCullInput>& inputs, const uint32_t elementCommands, const size_t elementCount, const uint32_t arrayCommands, const size_t arrayCount, const uint32_t multiDraws)
+  {
+    if(inputs.empty() || multiDraws == 0)
+    {
+      return;
+    }
+
+    //Every pass gets fresh storage for its inputs, so it doesn't wait on passes still reading the previous ones
+    reserve(this->inputBuffer, inputs.size() * sizeof(GpuCullInput));
+    glInvalidateBufferData(this->inputBuffer.handle);
+    glNamedBufferSubData(this->inputBuffer.handle, 0, (GLsizeiptr)(inputs.size() * sizeof(GpuCullInput)), inputs.data());
+    reserve(this->culledElements, elementCount * 5 * sizeof(uint32_t));
+    reserve(this->culledArrays, arrayCount * 4 * sizeof(uint32_t));
+    reserve(this->countBuffer, multiDraws * sizeof(uint32_t));
+    glClearNamedBufferSubData(this->countBuffer.handle, GL_R32UI, 0, (GLsizeiptr)(multiDraws * sizeof(uint32_t)), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_INPUT_BINDING, this->inputBuffer.handle);
+    if(elementCommands != INVALID_HANDLE)
+    {
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_ELEMENT_COMMAND_BINDING, elementCommands);
+    }
+    if(arrayCommands != INVALID_HANDLE)
+    {
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_ARRAY_COMMAND_BINDING, arrayCommands);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_CULLED_ELEMENT_COMMAND_BINDING, this->culledElements.handle);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_CULLED_ARRAY_COMMAND_BINDING, this->culledArrays.handle);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_COUNT_BINDING, this->countBuffer.handle);
+
+    std::array<float, 24> planes{};
+    for(size_t i = 0; i < frustum.planes.size(); i++)
+    {
+      std::copy(frustum.planes[i].data, frustum.planes[i].data + 4, planes.begin() + (std::ptrdiff_t)(i * 4));
+    }
+    this->shader->use();
+    glProgramUniform4fv(this->shader->handle, this->planesLocation, 6, planes.data());
+    glProgramUniform1ui(this->shader->handle, this->inputCountLocation, (uint32_t)inputs.size());
+    glDispatchCompute(((uint32_t)inputs.size() + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+    //The counts are also copied to the readback buffer, which needs the buffer update barrier
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    //The counts of every pass in a frame are copied next to each other and read back together
+    //Only one frame is read back at a time, frames drawn while one is pending don't count towards the stats
+    if(this->fence)
+    {
+      return;
+    }
+    this->reserveReadback((this->frameDraws + multiDraws) * sizeof(uint32_t));
+    glCopyNamedBufferSubData(this->countBuffer.handle, this->readback.handle, 0, (GLintptr)(this->frameDraws * sizeof(uint32_t)), (GLsizeiptr)(multiDraws * sizeof(uint32_t)));
+    this->frameDraws += multiDraws;
+    this->frameTested += inputs.size();
+  }
+
+  void GpuCuller::endFrame()
+  {
+    if(this->fence || this->frameDraws == 0)
+    {
+      return;
+    }
+    this->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    this->pendingDraws = this->frameDraws;
+    this->pendingTested = this->frameTested;
+    this->frameDraws = 0;
+    this->frameTested = 0;
+  }
+
+  uint32_t GpuCuller::culledElementCommands() const
+  {
+    return this->culledElements.handle;
+  }
+
+  uint32_t GpuCuller::culledArrayCommands() const
+  {
+    return this->culledArrays.handle;
+  }
+
+  uint32_t GpuCuller::counts() const
+  {
+    return this->countBuffer.handle;
+  }
+
+  CullStats GpuCuller::stats()
+  {
+    if(!this->fence)
+    {
+      return this->lastStats;
+    }
+    const GLenum result = glClientWaitSync((GLsync)this->fence, 0, 0);
+    if(result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+    {
+      return this->lastStats;
+    }
+    glDeleteSync((GLsync)this->fence);
+    this->fence = nullptr;
+
+    this->lastStats.tested = this->pendingTested;
+    this->lastStats.visible = 0;
+    for(size_t i = 0; i < this->pendingDraws; i++)
+    {
+      this->lastStats.visible += this->mapped[i];
+    }
+    return this->lastStats;
+  }
+}
@@ -5,8 +5,54 @@
 
 #include "glrender/glrAssetRepository.hh"
 
+#include <tuple>
+
 namespace glr
 {
+  //Byte offset of an index into the bound index buffer, in the form the draw calls take it
+  const void* indexOffset(const GLRIndexBufferType indexType, const uint32_t firstIndex)
+  {
+    const size_t size = indexType == GLRIndexBufferType::USHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    return (const void*)(firstIndex * size);
+  }
+
+  //Copy a framebuffer's color into another one without a draw, framebuffer 0 is the back buffer
+  void blitColor(const Framebuffer& from, const uint32_t to, const uint32_t toWidth, const uint32_t toHeight)
+  {
+    glBlitNamedFramebuffer(from.framebufferHandle, to, 0, 0, (GLint)from.width, (GLint)from.height, 0, 0, (GLint)toWidth, (GLint)toHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  }
+
+  //Visit the list's renderables and its objects merged in draw order, higher layers and sublayers first like the sort keys put them
+  //Both are already in that order once the list is sorted
+  //Renderables without a layer component stay in the layer of whatever came before them, object is only meaningful when entry is null
+  template <typename Visit> void visitInLayerOrder(const RenderList& rl, Visit&& visit)
+  {
+    const ObjectStore& objects = rl.objects;
+    LayerComp current{};
+    size_t entry = 0;
+    size_t object = 0;
+    while(entry < rl.list.size() || object < objects.size())
+    {
+      const Renderable* renderable = entry < rl.list.size() ? &rl.list[entry] : nullptr;
+      const LayerComp entryLayer = renderable && renderable->layerComp ? *renderable->layerComp : current;
+      if(renderable && (object == objects.size() || std::tie(entryLayer.layer, entryLayer.sublayer) >= std::tie(objects.layers[object].layer, objects.layers[object].sublayer)))
+      {
+        current = entryLayer;
+        visit(current, renderable, 0);
+        entry++;
+        continue;
+      }
+      current = objects.layers[object];
+      visit(current, nullptr, object);
+      object++;
+    }
+  }
+
+  bool sameSublayer(const LayerComp& a, const LayerComp& b)
+  {
+    return a.layer == b.layer && a.sublayer == b.sublayer;
+  }
+
   std::string transferFrag =
 R"(#version 460 core
 
@@ -35,6 +81,11 @@ void main()
   std::array fullscreenQuadVerts{1.0f, -1.0f,  1.0f, 1.0f,  -1.0f, -1.0f,  -1.0f, 1.0f};
   std::array fullscreenQuadUVs{1.0f, 0.0f,  1.0f, 1.0f,  0.0f, 0.0f,  0.0f, 1.0f};
 
+  //Member indices in the frame uniform block, in the order they're added
+  constexpr uint32_t FRAME_UNIFORM_VIEW = 0;
+  constexpr uint32_t FRAME_UNIFORM_PROJECTION = 1;
+  constexpr uint32_t FRAME_UNIFORM_TIME = 2;
+
   LoggingCallback cbFixed = nullptr;
   void glFixedDebug(const GLenum source, const GLenum type, const GLuint id, const GLenum severity, const GLsizei messageLength, const GLchar* message, const void* userData)
   {
@@ -174,6 +225,8 @@ void main()
   Renderer::Renderer(const GLLoadFunc loadFunc, const uint32_t contextWidth, const uint32_t contextHeight, const LoggingCallback& callback)
   {
     gladLoadGL(loadFunc);
+    stateCache().invalidate();
+    glGetNamedFramebufferParameteriv(0, GL_SAMPLES, &this->backBufferSamples);
     this->contextSize = {contextWidth, contextHeight};
     
     this->fboA.setDimensions(contextWidth, contextHeight)->addColorAttachment(GLRAttachmentType::TEXTURE, 4)->finalize();
@@ -185,16 +238,22 @@ void main()
     this->fullscreenQuad->addPositions(fullscreenQuadVerts.data(), fullscreenQuadVerts.size())->addUVs(fullscreenQuadUVs.data(), fullscreenQuadUVs.size())->finalize();
     this->shaderTransfer = std::make_unique<Shader>("Transfer Shader", transferVert, transferFrag);
     
+    this->frameUniforms.addMember("view", this->view);
+    this->frameUniforms.addMember("projection", this->projection);
+    this->frameUniforms.addMember("time", 0.0f);
+    this->startTime = std::chrono::steady_clock::now();
+    this->textureStreamer.allocate(TEXTURE_STREAM_RING_SIZE);
+    
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
     glDebugMessageCallback(glFixedDebug, nullptr);
     glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
 
     glHint(GL_FRAGMENT_SHADER_DERIVATIVE_HINT, GL_NICEST);
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glEnable(GL_CULL_FACE);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glViewport(0, 0, (GLsizei)contextWidth, (GLsizei)contextHeight);
+    stateCache().setDepthTest(false);
+    stateCache().setBlend(true);
+    stateCache().setCullFace(true);
+    stateCache().setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    stateCache().setViewport(0, 0, (int32_t)contextWidth, (int32_t)contextHeight);
 
     cbFixed = callback;
   }
@@ -205,8 +264,15 @@ void main()
     this->fboB.clear();
     this->scratch.clear();
     this->shaderTransfer.reset();
+    this->fallbackTexture.reset();
     this->globalPostStack.reset();
     this->layerPostStack.clear();
+    this->retained.reset();
+    glDeleteBuffers(1, &this->instanceBuffer.handle);
+    glDeleteBuffers(1, &this->instanceLayerBuffer.handle);
+    glDeleteBuffers(1, &this->instanceTextureBuffer.handle);
+    glDeleteBuffers(1, &this->elementCommandBuffer.handle);
+    glDeleteBuffers(1, &this->arrayCommandBuffer.handle);
   }
 
   //===Renderer Configuration===========================================================================
@@ -214,7 +280,7 @@ void main()
   {
     this->contextSize = {width, height};
     this->useBackBuffer();
-    glViewport(0, 0, (int32_t)width, (int32_t)height);
+    stateCache().setViewport(0, 0, (int32_t)width, (int32_t)height);
   }
   
   void Renderer::setGlobalPostStack(std::shared_ptr<PostStack> stack)
@@ -230,7 +296,7 @@ void main()
   //===OpenGL Wrappers===========================================================================
   void Renderer::useBackBuffer() const
   {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stateCache().bindFramebuffer(0);
   }
   
   void Renderer::setClearColor(const Color color) const
@@ -246,27 +312,27 @@ void main()
   
   void Renderer::setScissorTest(const bool val) const
   {
-    val ? glEnable(GL_SCISSOR_TEST) : glDisable(GL_SCISSOR_TEST);
+    stateCache().setScissorTest(val);
   }
   
   void Renderer::setDepthTest(const bool val) const
   {
-    val ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+    stateCache().setDepthTest(val);
   }
   
   void Renderer::setBlending(const bool val) const
   {
-    val ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+    stateCache().setBlend(val);
   }
   
   void Renderer::setBlendMode(const uint32_t src, const uint32_t dst) const
   {
-    glBlendFunc(src, dst);
+    stateCache().setBlendFunc(src, dst);
   }
   
   void Renderer::setCullFace(const bool val) const
   {
-    val ? glEnable(GL_CULL_FACE) : glDisable(GL_CULL_FACE);
+    stateCache().setCullFace(val);
   }
   
   void Renderer::setFilterMode(const GLRFilterMode min, const GLRFilterMode mag)
@@ -317,19 +383,29 @@ void main()
     }
   }
   
-  void Renderer::draw(const GLRDrawMode mode, const size_t numVerticies) const
+  void Renderer::draw(const GLRDrawMode mode, const size_t numVerticies, const uint32_t firstVertex) const
   {
-    glDrawArrays((GLenum)mode, 0, (GLsizei)numVerticies);
+    glDrawArrays((GLenum)mode, (GLint)firstVertex, (GLsizei)numVerticies);
   }
 
-  void Renderer::drawIndexed(const GLRDrawMode mode, const size_t numIndices) const
+  void Renderer::drawIndexed(const GLRDrawMode mode, const size_t numIndices, const GLRIndexBufferType indexType, const uint32_t firstIndex, const uint32_t baseVertex) const
   {
-    glDrawElements((GLenum)mode, (GLsizei)numIndices, GL_UNSIGNED_INT, nullptr);
+    glDrawElementsBaseVertex((GLenum)mode, (GLsizei)numIndices, (GLenum)indexType, indexOffset(indexType, firstIndex), (GLint)baseVertex);
+  }
+  
+  void Renderer::drawInstanced(const GLRDrawMode mode, const size_t numVerticies, const size_t instances, const uint32_t baseInstance, const uint32_t firstVertex) const
+  {
+    glDrawArraysInstancedBaseInstance((GLenum)mode, (GLint)firstVertex, (GLsizei)numVerticies, (GLsizei)instances, baseInstance);
+  }
+
+  void Renderer::drawIndexedInstanced(const GLRDrawMode mode, const size_t numIndices, const size_t instances, const uint32_t baseInstance, const GLRIndexBufferType indexType, const uint32_t firstIndex, const uint32_t baseVertex) const
+  {
+    glDrawElementsInstancedBaseVertexBaseInstance((GLenum)mode, (GLsizei)numIndices, (GLenum)indexType, indexOffset(indexType, firstIndex), (GLsizei)instances, (GLint)baseVertex, baseInstance);
   }
   
   void Renderer::bindImage(const uint32_t target, const uint32_t handle, const GLRIOMode mode, const GLRColorFormat format) const
   {
-    glBindImageTexture(target, handle, 0, GL_FALSE, 0, (uint32_t)mode, (uint32_t)format);
+    stateCache().bindImage(target, handle, mode, format);
   }
   
   void Renderer::startComputeShader(const vec2<uint32_t>& contextSize) const
@@ -340,48 +416,52 @@ void main()
   //===Rendering===========================================================================
   void Renderer::drawToBackBuffer() const
   {
-    this->fullscreenQuad->use();
-    this->useBackBuffer();
-    this->clearCurrentFramebuffer();
-    this->shaderTransfer->use();
-    if(this->curFBO.get())
+    const Framebuffer& frame = this->curFBO.get() ? this->fboA : this->fboB;
+    if(this->backBufferSamples > 0)
     {
-      this->fboA.bindAttachment(GLRAttachment::COLOR, GLRAttachmentType::TEXTURE, 0);
-    }
-    else
-    {
-      this->fboB.bindAttachment(GLRAttachment::COLOR, GLRAttachmentType::TEXTURE, 0);
+      //Blits can't write to a multisampled back buffer, the frame is drawn over it instead
+      this->fullscreenQuad->use();
+      this->useBackBuffer();
+      this->clearCurrentFramebuffer();
+      this->shaderTransfer->use();
+      frame.bindAttachment(GLRAttachment::COLOR, GLRAttachmentType::TEXTURE, 0);
+      this->draw(GLRDrawMode::TRI_STRIPS, this->fullscreenQuad->numVerts);
+      return;
     }
-    this->draw(GLRDrawMode::TRI_STRIPS, this->fullscreenQuad->numVerts);
+
+    //The blit covers every pixel, so the back buffer doesn't need clearing first
+    blitColor(frame, 0, this->contextSize.x(), this->contextSize.y());
+    this->useBackBuffer();
   }
 
-  void Renderer::render(RenderList renderList, const mat4x4<float>& viewMat, const mat4x4<float>& projectionMat)
+  void Renderer::render(const RenderList& rl, const mat4x4<float>& viewMat, const mat4x4<float>& projectionMat)
   {
-    RenderList rl = std::move(renderList);
+    stateCache().resetStats();
+    asset_repo::createQueued(this->assetCreationBudget);
+    this->textureStreamer.update();
     if(rl.empty())
     {
+      //The text ring and layout caches still move on to the next frame
+      this->textBatcher.endFrame();
+      this->frameStateStats = stateCache().stats();
       return;
     }
 
     ID currentTexture = INVALID_ID;
-    //std::shared_ptr<Texture> currentTexture = nullptr;
     this->view = viewMat;
     this->projection = projectionMat;
-    
-    if(rl.front().textureComp && rl.front().textureComp->texture)
-    {
-      currentTexture = rl.front().textureComp->texture;
-      asset_repo::textureUse(currentTexture);
-    }
+    this->uploadFrameUniforms();
+    this->cullObjects(rl.objects);
 
     const bool doPostprocessing = !this->layerPostStack.empty() || (this->globalPostStack && !this->globalPostStack->isEmpty());
 
-    if(!doPostprocessing) //TODO FIXME can't render directly to the back buffer, why?
+    if(!doPostprocessing)
     {
-      //TODO ideally, draw directly to the backbuffer
-      this->pingPong();
+      //Nothing reads the frame back, so it's drawn straight into the back buffer
+      this->useBackBuffer();
+      stateCache().setViewport(0, 0, (int32_t)this->contextSize.x(), (int32_t)this->contextSize.y());
+      this->clearCurrentFramebuffer();
       this->renderWithoutLayerPost(rl, currentTexture);
-      this->drawToBackBuffer();
     }
     else
     {
@@ -389,157 +469,379 @@ void main()
       {
         this->renderWithLayerPost(rl, currentTexture);
       }
+      else
+      {
+        this->pingPong();
+        this->renderWithoutLayerPost(rl, currentTexture);
+      }
       if(this->globalPostStack && !this->globalPostStack->isEmpty())
       {
         this->postProcessGlobal();
       }
       this->drawToBackBuffer();
     }
+    this->textBatcher.endFrame();
+    if(this->gpuCuller)
+    {
+      this->gpuCuller->endFrame();
+    }
+    this->frameStateStats = stateCache().stats();
   }
 
-  void Renderer::renderWithoutLayerPost(const RenderList& rl, ID& currentTexture)
+  CullStats Renderer::cullStats() const
+  {
+    return this->cpuCullStats;
+  }
+
+  CullStats Renderer::gpuCullStats() const
+  {
+    return this->gpuCuller ? this->gpuCuller->stats() : CullStats{};
+  }
+
+  StateCacheStats Renderer::stateStats() const
+  {
+    return this->frameStateStats;
+  }
+
+  bool Renderer::gpuCullingActive() const
   {
-    for(const auto& entry : rl.list)
+    //Layer post-processing draws every object on its own, only multi-draw indirect goes through the GPU culler
+    return this->frustumCulling && this->gpuCulling && this->multiDrawIndirect && this->layerPostStack.empty() && GpuCuller::supported();
+  }
+
+  void Renderer::cullObjects(const ObjectStore& objects)
+  {
+    this->objectVisible.clear();
+    this->cpuCullStats = {};
+    if(!this->frustumCulling)
+    {
+      return;
+    }
+
+    mat4x4<float> identity{};
+    for(int32_t i = 0; i < 4; i++)
+    {
+      identity.data[i][i] = 1.0f;
+    }
+    this->frustum = frustumFromMatrix(modelViewProjectionMatrix(identity, this->view, this->projection));
+
+    //The GPU tests every object drawn through it instead
+    if(this->gpuCullingActive())
     {
-      if(!currentTexture)
+      return;
+    }
+
+    //With a spatial index only the objects near the view volume are tested
+    if(objects.spatialIndex())
+    {
+      this->cullCandidates.clear();
+      objects.query(frustumBounds(this->frustum), this->cullCandidates);
+      this->objectVisible.assign(objects.size(), 0);
+      for(const ID handle : this->cullCandidates)
       {
-        if(entry.textureComp && entry.textureComp->texture)
+        const size_t i = objects.indexOf(handle);
+        if(i >= objects.size()) //Stale handle
         {
-          currentTexture = entry.textureComp->texture;
-          asset_repo::textureUse(currentTexture);
+          continue;
         }
+        const TransformComp& transform = objects.transforms[i];
+        const bool visible = sphereVisible(this->frustum, transform.pos, objectRadius(transform, objects.meshes[i]));
+        this->objectVisible[i] = visible;
+        this->cpuCullStats.visible += visible;
       }
-      else
-      {
+      this->cpuCullStats.tested += this->cullCandidates.size();
+      return;
+    }
 
-        if(entry.textureComp && asset_repo::textureExists(entry.textureComp->texture) && asset_repo::textureGetHandle(entry.textureComp->texture) != asset_repo::textureGetHandle(currentTexture))
-        {
-          currentTexture = entry.textureComp->texture;
-          asset_repo::textureUse(currentTexture);
-        }
-      }
-      this->drawRenderable(entry);
+    //Spheres are gathered into arrays of their own so they can be tested together
+    const size_t count = objects.size();
+    this->cullX.resize(count);
+    this->cullY.resize(count);
+    this->cullZ.resize(count);
+    this->cullRadius.resize(count);
+    this->objectVisible.resize(count);
+    for(size_t i = 0; i < count; i++)
+    {
+      const TransformComp& transform = objects.transforms[i];
+      this->cullX[i] = transform.pos.x();
+      this->cullY[i] = transform.pos.y();
+      this->cullZ[i] = transform.pos.z();
+      this->cullRadius[i] = objectRadius(transform, objects.meshes[i]);
     }
+    this->cpuCullStats.tested += count;
+    this->cpuCullStats.visible += cullSpheres(this->frustum, this->cullX.data(), this->cullY.data(), this->cullZ.data(), this->cullRadius.data(), this->objectVisible.data(), count, this->cullingThreads);
   }
-  
-  void Renderer::renderWithLayerPost(RenderList& rl, ID& currentTexture)
+
+  bool Renderer::objectCulled(const size_t object) const
   {
-    this->scratch.use();
-    this->clearCurrentFramebuffer();
-    this->pingPong();
-    bool bind = false;
-    size_t prevLayer = 0;
+    return !this->objectVisible.empty() && !this->objectVisible[object];
+  }
 
-    if(rl.front().layerComp)
+  bool Renderer::entryCulled(const Renderable& entry)
+  {
+    //Entries batched for the GPU culler are tested there
+    if(!this->frustumCulling || this->gpuCullingActive())
     {
-      prevLayer = rl.front().layerComp->layer;
+      return false;
     }
-    
-    for(size_t i = 0; i < rl.size(); i++)
+    const TransformComp& transform = *entry.transformComp;
+    const bool visible = sphereVisible(this->frustum, transform.pos, objectRadius(transform, entry.meshComp->mesh));
+    this->cpuCullStats.tested++;
+    this->cpuCullStats.visible += visible;
+    return !visible;
+  }
+
+  void Renderer::renderRetained(const mat4x4<float>& viewMat, const mat4x4<float>& projectionMat)
+  {
+    //Objects are merged with the list entries by layer, so they have to be back in layer order after being added, removed or moved to another layer
+    if(this->retained.objects.orderChanged())
     {
-      auto& entry = rl[i];
+      this->retained.sortObjects();
+    }
+    this->render(this->retained, viewMat, projectionMat);
+  }
+
+  void Renderer::setRetainedList(RenderList&& renderList)
+  {
+    this->retained = std::move(renderList);
+  }
+
+  RenderList& Renderer::retainedList()
+  {
+    return this->retained;
+  }
+
+  void Renderer::uploadFrameUniforms()
+  {
+    const std::chrono::duration<float> time = std::chrono::steady_clock::now() - this->startTime;
+    this->frameUniforms.set(FRAME_UNIFORM_VIEW, this->view);
+    this->frameUniforms.set(FRAME_UNIFORM_PROJECTION, this->projection);
+    this->frameUniforms.set(FRAME_UNIFORM_TIME, time.count());
+    this->frameUniforms.upload();
+    this->frameUniforms.bind(FRAME_UNIFORM_BINDING);
+  }
 
-      if(!currentTexture)
+  void Renderer::useTexture(const ID texture, ID& currentTexture) const
+  {
+    if(texture == INVALID_ID || texture == currentTexture)
+    {
+      return;
+    }
+    currentTexture = texture;
+    asset_repo::textureUse(currentTexture);
+  }
+
+  void Renderer::flushText(ID& currentTexture)
+  {
+    if(!this->textBatcher.pending())
+    {
+      return;
+    }
+    this->textBatcher.flush(this->view, this->projection);
+    currentTexture = INVALID_ID;
+  }
+
+  void Renderer::renderWithoutLayerPost(const RenderList& rl, ID& currentTexture)
+  {
+    const ObjectStore& objects = rl.objects;
+    LayerComp previous{};
+    if(this->instancedBatching || this->multiDrawIndirect)
+    {
+      visitInLayerOrder(rl, [&](const LayerComp& layer, const Renderable* entry, const size_t object)
       {
-        if(entry.textureComp && entry.textureComp->texture)
+        //Batched text is drawn before anything in the sublayers after it, the instances gathered so far go first
+        if(!sameSublayer(layer, previous) && this->textBatcher.pending())
         {
-          bind = true;
-         currentTexture = entry.textureComp->texture;
+          this->drawInstances(currentTexture);
+          this->flushText(currentTexture);
         }
-      }
-      else
-      {
-        if(entry.textureComp && asset_repo::textureExists(entry.textureComp->texture) && asset_repo::textureGetHandle(entry.textureComp->texture) != asset_repo::textureGetHandle(currentTexture))
+        previous = layer;
+
+        if(!entry)
         {
-          bind = true;
-          currentTexture = entry.textureComp->texture;
+          if(!this->objectCulled(object))
+          {
+            this->addInstance(objects.transforms[object], objects.meshes[object], objects.shaders[object], objects.textures[object], objects.textureLayers[object]);
+          }
+          return;
         }
-      }
-      
-      if(i == 0)
-      {
-        if(bind && currentTexture)
+        if(isTemplate(*entry, TEXT_RENDERABLE_TEMPLATE))
         {
-          asset_repo::textureUse(currentTexture);
+          this->textBatcher.add(*entry);
+          return;
         }
-        
-        this->drawRenderable(entry);
-      }
-      else if(i == rl.size() - 1)
-      {
-        if(entry.layerComp && entry.layerComp->layer != prevLayer)
+        if(isTemplate(*entry, OBJECT_RENDERABLE_TEMPLATE))
         {
-          this->postProcessLayer(prevLayer);
-          this->drawToScratch();
-          this->pingPong();
-          if(currentTexture)
+          if(!this->entryCulled(*entry))
           {
-            asset_repo::textureUse(currentTexture);
+            this->addInstance(*entry->transformComp, entry->meshComp->mesh, entry->fragVertShaderComp->shader, entry->textureComp->texture, entry->textureComp->layer);
           }
+          return;
         }
-        
-        if(bind && currentTexture)
-        {
-          asset_repo::textureUse(currentTexture);
-        }
-        
-        this->drawRenderable(entry);
-        if(entry.layerComp)
+
+        //Anything that can't be instanced has to be drawn in order with the objects around it
+        this->drawInstances(currentTexture);
+        if(entry->textureComp)
         {
-          this->postProcessLayer(entry.layerComp->layer);
+          this->useTexture(entry->textureComp->texture, currentTexture);
         }
-        this->drawToScratch();
+        this->drawRenderable(*entry);
+      });
+      this->drawInstances(currentTexture);
+      this->flushText(currentTexture);
+      return;
+    }
+
+    visitInLayerOrder(rl, [&](const LayerComp& layer, const Renderable* entry, const size_t object)
+    {
+      //Batched text is drawn before anything in the sublayers after it
+      if(!sameSublayer(layer, previous))
+      {
+        this->flushText(currentTexture);
       }
-      else
+      previous = layer;
+
+      if(!entry)
       {
-        if(entry.layerComp && entry.layerComp->layer != prevLayer)
+        if(!this->objectCulled(object))
         {
-          this->postProcessLayer(prevLayer);
-          this->drawToScratch();
-          this->pingPong();
-          if(currentTexture)
-          {
-            asset_repo::textureUse(currentTexture);
-          }
+          this->useTexture(objects.textures[object], currentTexture);
+          this->drawObject(objects.transforms[object], objects.meshes[object], objects.shaders[object], objects.textureLayers[object]);
         }
-        
-        if(bind && currentTexture)
+        return;
+      }
+      if(entry->textureComp)
+      {
+        this->useTexture(entry->textureComp->texture, currentTexture);
+      }
+      this->drawRenderable(*entry);
+    });
+    this->flushText(currentTexture);
+  }
+  
+  void Renderer::renderWithLayerPost(const RenderList& rl, ID& currentTexture)
+  {
+    this->scratch.use();
+    this->clearCurrentFramebuffer();
+    this->pingPong();
+    bool first = true;
+    uint64_t prevLayer = 0;
+    LayerComp previous{};
+
+    //Both sources are walked together, so each layer is finished and post-processed once with everything in it
+    const ObjectStore& objects = rl.objects;
+    visitInLayerOrder(rl, [&](const LayerComp& layer, const Renderable* entry, const size_t object)
+    {
+      if(!entry && this->objectCulled(object))
+      {
+        return;
+      }
+
+      //Finish the previous layer and start a new one whenever the layer changes
+      if(!first && layer.layer != prevLayer)
+      {
+        this->flushText(currentTexture);
+        this->postProcessLayer(prevLayer);
+        this->drawToScratch();
+        this->pingPong();
+        if(currentTexture != INVALID_ID)
         {
           asset_repo::textureUse(currentTexture);
         }
-        
-        this->drawRenderable(entry);
       }
+      else if(!sameSublayer(layer, previous))
+      {
+        this->flushText(currentTexture);
+      }
+      first = false;
+      prevLayer = layer.layer;
+      previous = layer;
 
-      if(entry.layerComp)
+      if(!entry)
       {
-        prevLayer = entry.layerComp->layer;
+        this->useTexture(objects.textures[object], currentTexture);
+        this->drawObject(objects.transforms[object], objects.meshes[object], objects.shaders[object], objects.textureLayers[object]);
+        return;
       }
-      
-      bind = false;
+      if(entry->textureComp)
+      {
+        this->useTexture(entry->textureComp->texture, currentTexture);
+      }
+      this->drawRenderable(*entry);
+    });
+
+    if(!first)
+    {
+      this->flushText(currentTexture);
+      this->postProcessLayer(prevLayer);
+      this->drawToScratch();
     }
     
     this->scratchToPingPong();
   }
 
-  void Renderer::drawRenderable(const Renderable& entry)
+  void Renderer::drawObject(const TransformComp& transform, const ID mesh, const ID shader, const uint32_t textureLayer)
+  {
+    if(mesh == INVALID_ID || shader == INVALID_ID)
+    {
+      return;
+    }
+    const ObjectShader* resolved = this->resolveObjectShader(shader);
+    if(!resolved)
+    {
+      return;
+    }
+    this->model = modelMatrix(transform.pos, transform.rotation, transform.scale);
+    this->mvp = modelViewProjectionMatrix(this->model, this->view, this->projection);
+    resolved->shader->use();
+    resolved->shader->setUniform(resolved->mvp, this->mvp);
+    resolved->shader->setUniform(resolved->textureLayer, textureLayer);
+    resolved->shader->sendUniforms();
+    asset_repo::meshUse(mesh);
+    if(asset_repo::meshIsIndexed(mesh))
+    {
+      this->drawIndexed(asset_repo::meshGetDrawMode(mesh), asset_repo::meshGetIndices(mesh), asset_repo::meshGetIndexType(mesh), asset_repo::meshGetFirstIndex(mesh), asset_repo::meshGetBaseVertex(mesh));
+    }
+    else
+    {
+      this->draw(asset_repo::meshGetDrawMode(mesh), asset_repo::meshGetVertices(mesh), asset_repo::meshGetBaseVertex(mesh));
+    }
+  }
+
+  const Renderer::ObjectShader* Renderer::resolveObjectShader(const ID shader)
   {
-    if(isTemplate(entry, OBJECT_RENDERABLE_TEMPLATE) && entry.meshComp->mesh && entry.fragVertShaderComp->shader) //Standard object rendered with a frag/vert shader
+    if(this->objectShaderRevision != shaderRevision())
     {
-      this->model = modelMatrix(entry.transformComp->pos, entry.transformComp->rotation, entry.transformComp->scale);
-      this->mvp = modelViewProjectionMatrix(this->model, this->view, this->projection);
-      asset_repo::shaderUse(entry.fragVertShaderComp->shader);
-      asset_repo::shaderSetUniform(entry.fragVertShaderComp->shader, "mvp", this->mvp);
-      asset_repo::shaderSendUniforms(entry.fragVertShaderComp->shader);
-      asset_repo::meshUse(entry.meshComp->mesh);
-      if(asset_repo::meshIsIndexed(entry.meshComp->mesh))
+      this->objectShaders.clear();
+      this->objectShaderRevision = shaderRevision();
+    }
+    auto [it, inserted] = this->objectShaders.try_emplace(shader);
+    ObjectShader& resolved = it->second;
+    if(inserted)
+    {
+      resolved.shader = asset_repo::shaderGet(shader);
+      if(resolved.shader)
       {
-        this->drawIndexed(asset_repo::meshGetDrawMode(entry.meshComp->mesh), asset_repo::meshGetIndices(entry.meshComp->mesh));
+        resolved.mvp = resolved.shader->uniformSlot("mvp");
+        resolved.textureLayer = resolved.shader->uniformSlot("textureLayer");
       }
-      else
+    }
+    return resolved.shader ? &resolved : nullptr;
+  }
+
+  void Renderer::drawRenderable(const Renderable& entry)
+  {
+    if(isTemplate(entry, TEXT_RENDERABLE_TEMPLATE)) //Text object rendered with a frag/vert shader, drawn in a batch when the sublayer ends
+    {
+      this->textBatcher.add(entry);
+    }
+    else if(isTemplate(entry, OBJECT_RENDERABLE_TEMPLATE)) //Standard object rendered with a frag/vert shader
+    {
+      if(this->entryCulled(entry))
       {
-        this->draw(asset_repo::meshGetDrawMode(entry.meshComp->mesh), asset_repo::meshGetVertices(entry.meshComp->mesh));
+        return;
       }
+      this->drawObject(*entry.transformComp, entry.meshComp->mesh, entry.fragVertShaderComp->shader, entry.textureComp ? entry.textureComp->layer : 0);
     }
     else if(isTemplate(entry, COMPUTE_RENDERABLE_TEMPLATE)) //Compute image generation
     {
@@ -552,46 +854,223 @@ void main()
       asset_repo::shaderSendUniforms(entry.computeShaderComp->shader);
       this->startComputeShader(this->contextSize);
     }
-    else if(isTemplate(entry, TEXT_RENDERABLE_TEMPLATE) && entry.meshComp->mesh && entry.fragVertShaderComp->shader) //Text object rendered with a frag/vert shader
+  }
+  
+  void Renderer::addInstance(const TransformComp& transform, const ID mesh, const ID shader, const ID texture, const uint32_t textureLayer)
+  {
+    if(mesh == INVALID_ID || shader == INVALID_ID)
+    {
+      return;
+    }
+    
+    //Bindless shaders look their texture up per instance, so textures no longer split batches
+    ID batchTexture = texture;
+    if(this->bindlessTextures && GLAD_GL_ARB_bindless_texture)
+    {
+      uint64_t handle = asset_repo::textureGetBindlessHandle(texture);
+      if(handle == 0)
+      {
+        if(!this->fallbackTexture)
+        {
+          this->fallbackTexture = std::make_unique<Texture>("Fallback Texture");
+        }
+        handle = this->fallbackTexture->bindlessHandle();
+      }
+      this->instanceTextures.emplace_back(handle);
+      batchTexture = INVALID_ID;
+    }
+    
+    if(this->instanceBatches.empty() || this->instanceBatches.back().mesh != mesh || this->instanceBatches.back().shader != shader || this->instanceBatches.back().texture != batchTexture)
+    {
+      this->instanceBatches.emplace_back(mesh, shader, batchTexture, (uint32_t)this->instances.size(), 0);
+    }
+    this->instanceBatches.back().count++;
+    
+    this->model = modelMatrix(transform.pos, transform.rotation, transform.scale);
+    this->instances.emplace_back(modelViewProjectionMatrix(this->model, this->view, this->projection));
+    this->instanceLayers.emplace_back(textureLayer);
+    if(this->gpuCullingActive())
+    {
+      this->instanceSpheres.emplace_back(transform.pos.x(), transform.pos.y(), transform.pos.z(), objectRadius(transform, mesh));
+    }
+  }
+  
+  void Renderer::streamData(StreamedBuffer& buffer, const void* data, const size_t size)
+  {
+    //Orphan the previous contents so the driver doesn't wait on draws still using them
+    if(buffer.handle == INVALID_HANDLE)
     {
-      const GLRFilterMode prevMin = this->filterModeMin;
-      const GLRFilterMode prevMag = this->filterModeMag;
-      this->setFilterMode(GLRFilterMode::BILINEAR, GLRFilterMode::BILINEAR);
+      glCreateBuffers(1, &buffer.handle);
+    }
+    if(size > buffer.capacity)
+    {
+      buffer.capacity = std::max(size, buffer.capacity * 2);
+    }
+    glNamedBufferData(buffer.handle, (GLsizeiptr)buffer.capacity, nullptr, GL_STREAM_DRAW);
+    glNamedBufferSubData(buffer.handle, 0, (GLsizeiptr)size, data);
+  }
+  
+  void Renderer::streamInstanceData(StreamedBuffer& buffer, const void* data, const size_t size, const uint32_t binding)
+  {
+    streamData(buffer, data, size);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer.handle);
+  }
+  
+  void Renderer::drawInstances(ID& currentTexture)
+  {
+    if(this->instances.empty())
+    {
+      return;
+    }
+    
+    //Upload every batch's instance data at once
+    streamInstanceData(this->instanceBuffer, this->instances.data(), this->instances.size() * sizeof(InstanceData), INSTANCE_BUFFER_BINDING);
+    streamInstanceData(this->instanceLayerBuffer, this->instanceLayers.data(), this->instanceLayers.size() * sizeof(uint32_t), INSTANCE_LAYER_BUFFER_BINDING);
+    if(!this->instanceTextures.empty())
+    {
+      streamInstanceData(this->instanceTextureBuffer, this->instanceTextures.data(), this->instanceTextures.size() * sizeof(uint64_t), INSTANCE_TEXTURE_BUFFER_BINDING);
+    }
+    
+    if(this->multiDrawIndirect)
+    {
+      this->drawInstancesIndirect(currentTexture);
+    }
+    else
+    {
+      for(const auto& [mesh, shader, texture, first, count] : this->instanceBatches)
+      {
+        this->useTexture(texture, currentTexture);
+        asset_repo::shaderUse(shader);
+        asset_repo::shaderSendUniforms(shader);
+        asset_repo::meshUse(mesh);
+        if(asset_repo::meshIsIndexed(mesh))
+        {
+          this->drawIndexedInstanced(asset_repo::meshGetDrawMode(mesh), asset_repo::meshGetIndices(mesh), count, first, asset_repo::meshGetIndexType(mesh), asset_repo::meshGetFirstIndex(mesh), asset_repo::meshGetBaseVertex(mesh));
+        }
+        else
+        {
+          this->drawInstanced(asset_repo::meshGetDrawMode(mesh), asset_repo::meshGetVertices(mesh), count, first, asset_repo::meshGetBaseVertex(mesh));
+        }
+      }
+    }
+    
+    this->instanceBatches.clear();
+    this->instances.clear();
+    this->instanceLayers.clear();
+    this->instanceTextures.clear();
+    this->instanceSpheres.clear();
+  }
+  
+  void Renderer::drawInstancesIndirect(ID& currentTexture)
+  {
+    //With GPU culling every instance gets a command of its own, so culled ones can be dropped one at a time
+    const bool gpuCull = this->gpuCullingActive();
+    
+    //Turn every batch into commands, and merge neighbouring batches that only differ by mesh into one multi-draw when their meshes share a vertex array
+    for(const auto& [mesh, shader, texture, first, count] : this->instanceBatches)
+    {
+      const bool indexed = asset_repo::meshIsIndexed(mesh);
+      const GLRDrawMode mode = asset_repo::meshGetDrawMode(mesh);
+      const GLRIndexBufferType indexType = asset_repo::meshGetIndexType(mesh);
+      const uint32_t vertexArray = asset_repo::meshGetVertexArray(mesh);
+      
+      MultiDraw* multiDraw = this->multiDraws.empty() ? nullptr : &this->multiDraws.back();
+      if(!multiDraw || multiDraw->shader != shader || multiDraw->texture != texture || multiDraw->vertexArray != vertexArray ||
+         multiDraw->indexed != indexed || multiDraw->mode != mode || (indexed && multiDraw->indexType != indexType))
+      {
+        const size_t firstCommand = indexed ? this->elementCommands.size() : this->arrayCommands.size();
+        multiDraw = &this->multiDraws.emplace_back(mesh, shader, texture, vertexArray, mode, indexType, indexed, (uint32_t)firstCommand, 0);
+      }
+      
+      const uint32_t commands = gpuCull ? count : 1;
+      const uint32_t instanceCount = gpuCull ? 1 : count;
+      for(uint32_t command = 0; command < commands; command++)
+      {
+        const uint32_t baseInstance = first + command;
+        if(gpuCull)
+        {
+          const size_t source = indexed ? this->elementCommands.size() : this->arrayCommands.size();
+          this->cullInputs.emplace_back(this->instanceSpheres[baseInstance], (uint32_t)(this->multiDraws.size() - 1), multiDraw->firstCommand, (uint32_t)source, (uint32_t)indexed);
+        }
+        if(indexed)
+        {
+          this->elementCommands.emplace_back((uint32_t)asset_repo::meshGetIndices(mesh), instanceCount, asset_repo::meshGetFirstIndex(mesh), (int32_t)asset_repo::meshGetBaseVertex(mesh), baseInstance);
+        }
+        else
+        {
+          this->arrayCommands.emplace_back((uint32_t)asset_repo::meshGetVertices(mesh), instanceCount, asset_repo::meshGetBaseVertex(mesh), baseInstance);
+        }
+      }
+      multiDraw->count += commands;
+    }
+    
+    if(!this->elementCommands.empty())
+    {
+      streamData(this->elementCommandBuffer, this->elementCommands.data(), this->elementCommands.size() * sizeof(DrawElementsIndirectCommand));
+    }
+    if(!this->arrayCommands.empty())
+    {
+      streamData(this->arrayCommandBuffer, this->arrayCommands.data(), this->arrayCommands.size() * sizeof(DrawArraysIndirectCommand));
+    }
+    
+    uint32_t elementBuffer = this->elementCommandBuffer.handle;
+    uint32_t arrayBuffer = this->arrayCommandBuffer.handle;
+    if(gpuCull)
+    {
+      if(!this->gpuCuller)
+      {
+        this->gpuCuller = std::make_unique<GpuCuller>();
+      }
+      this->gpuCuller->cull(this->frustum, this->cullInputs, elementBuffer, this->elementCommands.size(), arrayBuffer, this->arrayCommands.size(), (uint32_t)this->multiDraws.size());
+      elementBuffer = this->gpuCuller->culledElementCommands();
+      arrayBuffer = this->gpuCuller->culledArrayCommands();
+      glBindBuffer(GL_PARAMETER_BUFFER, this->gpuCuller->counts());
+    }
+    
+    for(size_t i = 0; i < this->multiDraws.size(); i++)
+    {
+      const MultiDraw& multiDraw = this->multiDraws[i];
+      this->useTexture(multiDraw.texture, currentTexture);
+      asset_repo::shaderUse(multiDraw.shader);
+      asset_repo::shaderSendUniforms(multiDraw.shader);
+      asset_repo::meshUse(multiDraw.mesh);
       
-      //TODO batch render text quads
-      Mesh textMesh;
-      textMesh.setPositionDimensions(GLRDimensions::TWO_DIMENSIONAL);
-      textMesh.bufferType = GLRBufferType::SEPARATE;
-      textMesh.drawType = GLRDrawType::STATIC_DRAW;
-      textMesh.drawMode = GLRDrawMode::TRIS;
-      for(const auto& charInfo : entry.textComp->characterInfo)
-      {
-        //TODO FIXME character info needs a position and scale, then apply that info to the quad position for batching
-        constexpr static std::array quadIndices{0u, 1u, 2u, 2u, 3u, 0u};
-        constexpr static std::array quadVerts{0.f, 0.f,  1.f, 0.f,  1.f, 1.f,  1.f, 1.f,  0.f, 1.f,  0.f, 0.f}; //ll origin
-        const auto& [ul, ll, ur, lr] = charInfo.atlasUVs;
-        const std::array quadUVs{lr.x(), lr.y(), ll.x(), ll.y(), ur.x(), ur.y(), ul.x(), ul.y()};
-        textMesh.addPositions(quadVerts.data(), quadVerts.size())->addUVs(quadUVs.data(), quadUVs.size())->addIndices(quadIndices.data(), quadIndices.size());
-      }
-      textMesh.finalize();
-      textMesh.use();
-      this->model = modelMatrix(entry.transformComp->pos, entry.transformComp->rotation, entry.transformComp->scale);
-      this->mvp = modelViewProjectionMatrix(this->model, this->view, this->projection);
-
-      asset_repo::shaderUse(entry.fragVertShaderComp->shader);
-      asset_repo::shaderSetUniform(entry.fragVertShaderComp->shader, "mvp", this->mvp);
-      asset_repo::shaderSendUniforms(entry.fragVertShaderComp->shader);
-
-      if(textMesh.isIndexed())
-      {
-        this->drawIndexed(textMesh.drawMode, textMesh.numIndices);
+      //Culled draws read how many of their commands survived from the count buffer
+      const GLintptr drawCount = (GLintptr)(i * sizeof(uint32_t));
+      if(multiDraw.indexed)
+      {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, elementBuffer);
+        const void* offset = (const void*)(multiDraw.firstCommand * sizeof(DrawElementsIndirectCommand));
+        if(gpuCull)
+        {
+          glMultiDrawElementsIndirectCount((GLenum)multiDraw.mode, (GLenum)multiDraw.indexType, offset, drawCount, (GLsizei)multiDraw.count, 0);
+        }
+        else
+        {
+          glMultiDrawElementsIndirect((GLenum)multiDraw.mode, (GLenum)multiDraw.indexType, offset, (GLsizei)multiDraw.count, 0);
+        }
       }
       else
       {
-        this->draw(textMesh.drawMode, textMesh.numVerts);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, arrayBuffer);
+        const void* offset = (const void*)(multiDraw.firstCommand * sizeof(DrawArraysIndirectCommand));
+        if(gpuCull)
+        {
+          glMultiDrawArraysIndirectCount((GLenum)multiDraw.mode, offset, drawCount, (GLsizei)multiDraw.count, 0);
+        }
+        else
+        {
+          glMultiDrawArraysIndirect((GLenum)multiDraw.mode, offset, (GLsizei)multiDraw.count, 0);
+        }
       }
-      this->setFilterMode(prevMin, prevMag);
     }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindBuffer(GL_PARAMETER_BUFFER, 0);
+    
+    this->multiDraws.clear();
+    this->elementCommands.clear();
+    this->arrayCommands.clear();
+    this->cullInputs.clear();
   }
   
   void Renderer::drawToScratch() const
@@ -605,16 +1084,20 @@ void main()
   
   void Renderer::scratchToPingPong()
   {
-    this->fullscreenQuad->use();
-    this->pingPong();
-    this->shaderTransfer->use();
-    this->scratch.bindAttachment(GLRAttachment::COLOR, GLRAttachmentType::TEXTURE, 0);
-    this->draw(GLRDrawMode::TRI_STRIPS, this->fullscreenQuad->numVerts);
+    //Scratch has no alpha, so the old blend over a cleared target was a plain copy
+    const Framebuffer& target = this->curFBO.swap() ? this->fboA : this->fboB;
+    blitColor(this->scratch, target.framebufferHandle, target.width, target.height);
+    target.use();
   }
 
   void Renderer::postProcessLayer(const uint64_t layer)
   {
-    for(const auto& stage: this->layerPostStack[layer]->getPasses())
+    if(!this->layerPostStack.contains(layer) || !this->layerPostStack.at(layer))
+    {
+      return;
+    }
+    
+    for(const auto& stage: this->layerPostStack.at(layer)->getPasses())
     {
       if(stage.enabled)
       {
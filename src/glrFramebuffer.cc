@@ -1,4 +1,5 @@
 #include "glrender/glrFramebuffer.hh"
+#include "glrender/glrStateCache.hh"
 
 #include <algorithm>
 #include <glad/gl.hh>
@@ -144,9 +145,9 @@ namespace glr
   void Framebuffer::finalize()
   {
     glCreateFramebuffers(1, &this->framebufferHandle);
-    glBindFramebuffer(GL_FRAMEBUFFER, this->framebufferHandle);
-    glViewport(0, 0, (GLsizei)this->width, (GLsizei)this->height);
-    glScissor(0, 0, (GLsizei)this->width, (GLsizei)this->height);
+    stateCache().bindFramebuffer(this->framebufferHandle);
+    stateCache().setViewport(0, 0, (int32_t)this->width, (int32_t)this->height);
+    stateCache().setScissor(0, 0, (int32_t)this->width, (int32_t)this->height);
 
     std::vector<GLenum> drawBuffers;
     
@@ -249,7 +250,7 @@ namespace glr
       }
       printf("%s\n", er.c_str());
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stateCache().bindFramebuffer(0);
     this->finalized = true;
   }
   
@@ -259,7 +260,7 @@ namespace glr
     {
       return;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, this->framebufferHandle);
+    stateCache().bindFramebuffer(this->framebufferHandle);
   }
   
   void Framebuffer::bindAttachment(const GLRAttachment attachment, const GLRAttachmentType type, const uint32_t target) const
@@ -274,7 +275,7 @@ namespace glr
           {
             case GLRAttachmentType::TEXTURE:
             {
-              glBindTextureUnit(target, this->colorHandle);
+              stateCache().bindTexture(target, this->colorHandle);
               break;
             }
             case GLRAttachmentType::RENDER_BUFFER:
@@ -295,7 +296,7 @@ namespace glr
           {
             case GLRAttachmentType::TEXTURE:
             {
-              glBindTextureUnit(target, this->depthHandle);
+              stateCache().bindTexture(target, this->depthHandle);
               break;
             }
             case GLRAttachmentType::RENDER_BUFFER:
@@ -316,7 +317,7 @@ namespace glr
           {
             case GLRAttachmentType::TEXTURE:
             {
-              glBindTextureUnit(target, this->stencilHandle);
+              stateCache().bindTexture(target, this->stencilHandle);
               break;
             }
             case GLRAttachmentType::RENDER_BUFFER:
@@ -363,12 +364,14 @@ namespace glr
   
   void Framebuffer::clear()
   {
+    stateCache().forgetFramebuffer(this->framebufferHandle);
     glDeleteFramebuffers(1, &this->framebufferHandle);
 
     if(this->hasColor)
     {
       if(this->colorType == GLRAttachmentType::TEXTURE)
       {
+        stateCache().forgetTexture(this->colorHandle);
         glDeleteTextures(1, &this->colorHandle);
       }
       else
@@ -380,6 +383,7 @@ namespace glr
     {
       if(this->depthType == GLRAttachmentType::TEXTURE)
       {
+        stateCache().forgetTexture(this->depthHandle);
         glDeleteTextures(1, &this->depthHandle);
       }
       else
@@ -391,6 +395,7 @@ namespace glr
     {
       if(this->stencilType == GLRAttachmentType::TEXTURE)
       {
+        stateCache().forgetTexture(this->stencilHandle);
         glDeleteTextures(1, &this->stencilHandle);
       }
       else
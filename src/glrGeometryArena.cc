@@ -0,0 +1,189 @@
+#include "glrender/glrGeometryArena.hh"
+#include "glrender/glrStateCache.hh"
+
+#include <glad/gl.hh>
+
+#include <algorithm>
+#include <iterator>
+
+namespace glr
+{
+  constexpr uint32_t ARENA_VERTEX_BINDING = 0;
+
+  GeometryArena& geometryArena()
+  {
+    //Never destroyed, meshes in the asset repository may still free their allocations during static destruction
+    static GeometryArena* arena = new GeometryArena();
+    return *arena;
+  }
+
+  GeometryArena::~GeometryArena()
+  {
+    this->clear();
+  }
+
+  ArenaAllocation GeometryArena::allocate(const ArenaLayout& layout, const uint8_t* vertices, const uint32_t vertexCount, const uint32_t* indices, const uint32_t indexCount)
+  {
+    ArenaAllocation out{};
+    if(vertexCount == 0 || layout.stride == 0)
+    {
+      return out;
+    }
+
+    out.pool = this->findPool(layout);
+    Pool& pool = this->pools[out.pool];
+    if(!pool.vertices.take(vertexCount, out.baseVertex))
+    {
+      this->growVertices(pool, vertexCount);
+      pool.vertices.take(vertexCount, out.baseVertex);
+    }
+    out.vertexCount = vertexCount;
+    glNamedBufferSubData(pool.vertexBuffer, (GLintptr)out.baseVertex * layout.stride, (GLsizeiptr)vertexCount * layout.stride, vertices);
+
+    if(indices && indexCount > 0)
+    {
+      if(!pool.indices.take(indexCount, out.firstIndex))
+      {
+        this->growIndices(pool, indexCount);
+        pool.indices.take(indexCount, out.firstIndex);
+      }
+      out.indexCount = indexCount;
+      glNamedBufferSubData(pool.indexBuffer, (GLintptr)(out.firstIndex * sizeof(uint32_t)), (GLsizeiptr)(indexCount * sizeof(uint32_t)), indices);
+    }
+    return out;
+  }
+
+  void GeometryArena::free(const ArenaAllocation& allocation)
+  {
+    if(!allocation.valid() || allocation.pool >= this->pools.size())
+    {
+      return;
+    }
+    Pool& pool = this->pools[allocation.pool];
+    pool.vertices.give(allocation.baseVertex, allocation.vertexCount);
+    pool.indices.give(allocation.firstIndex, allocation.indexCount);
+  }
+
+  uint32_t GeometryArena::vertexArray(const uint32_t pool) const
+  {
+    if(pool >= this->pools.size())
+    {
+      return INVALID_HANDLE;
+    }
+    return this->pools[pool].vertexArray;
+  }
+
+  void GeometryArena::clear()
+  {
+    for(Pool& pool : this->pools)
+    {
+      stateCache().forgetVertexArray(pool.vertexArray);
+      glDeleteVertexArrays(1, &pool.vertexArray);
+      glDeleteBuffers(1, &pool.vertexBuffer);
+      glDeleteBuffers(1, &pool.indexBuffer);
+    }
+    this->pools.clear();
+  }
+
+  uint32_t GeometryArena::findPool(const ArenaLayout& layout)
+  {
+    for(uint32_t i = 0; i < this->pools.size(); i++)
+    {
+      if(this->pools[i].layout == layout)
+      {
+        return i;
+      }
+    }
+
+    Pool& pool = this->pools.emplace_back();
+    pool.layout = layout;
+    glCreateVertexArrays(1, &pool.vertexArray);
+    this->growVertices(pool, GEOMETRY_ARENA_INITIAL_VERTICES);
+    this->growIndices(pool, GEOMETRY_ARENA_INITIAL_INDICES);
+    return (uint32_t)(this->pools.size() - 1);
+  }
+
+  void GeometryArena::growBuffer(uint32_t& buffer, const size_t oldSize, const size_t newSize)
+  {
+    //Buffer storage is immutable, so the contents are copied into a bigger one
+    uint32_t grown = INVALID_HANDLE;
+    glCreateBuffers(1, &grown);
+    glNamedBufferStorage(grown, (GLsizeiptr)newSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    if(buffer != INVALID_HANDLE)
+    {
+      glCopyNamedBufferSubData(buffer, grown, 0, 0, (GLsizeiptr)oldSize);
+      glDeleteBuffers(1, &buffer);
+    }
+    buffer = grown;
+  }
+
+  void GeometryArena::growVertices(Pool& pool, const uint32_t needed)
+  {
+    const uint32_t capacity = std::max(pool.vertices.capacity * 2, pool.vertices.capacity + needed);
+    growBuffer(pool.vertexBuffer, (size_t)pool.vertices.capacity * pool.layout.stride, (size_t)capacity * pool.layout.stride);
+    pool.vertices.grow(capacity);
+    glVertexArrayVertexBuffer(pool.vertexArray, ARENA_VERTEX_BINDING, pool.vertexBuffer, 0, (GLsizei)pool.layout.stride);
+  }
+
+  void GeometryArena::growIndices(Pool& pool, const uint32_t needed)
+  {
+    const uint32_t capacity = std::max(pool.indices.capacity * 2, pool.indices.capacity + needed);
+    growBuffer(pool.indexBuffer, pool.indices.capacity * sizeof(uint32_t), capacity * sizeof(uint32_t));
+    pool.indices.grow(capacity);
+    glVertexArrayElementBuffer(pool.vertexArray, pool.indexBuffer);
+  }
+
+  bool GeometryArena::FreeList::take(const uint32_t count, uint32_t& offset)
+  {
+    for(auto it = this->ranges.begin(); it != this->ranges.end(); ++it)
+    {
+      if(it->second < count)
+      {
+        continue;
+      }
+      offset = it->first;
+      const uint32_t remaining = it->second - count;
+      this->ranges.erase(it);
+      if(remaining > 0)
+      {
+        this->ranges.emplace(offset + count, remaining);
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void GeometryArena::FreeList::give(uint32_t offset, uint32_t count)
+  {
+    if(count == 0)
+    {
+      return;
+    }
+
+    //Merge with the free ranges on either side
+    auto next = this->ranges.lower_bound(offset);
+    if(next != this->ranges.begin())
+    {
+      auto prev = std::prev(next);
+      if(prev->first + prev->second == offset)
+      {
+        offset = prev->first;
+        count += prev->second;
+        this->ranges.erase(prev);
+      }
+    }
+    if(next != this->ranges.end() && offset + count == next->first)
+    {
+      count += next->second;
+      this->ranges.erase(next);
+    }
+    this->ranges.emplace(offset, count);
+  }
+
+  void GeometryArena::FreeList::grow(const uint32_t newCapacity)
+  {
+    const uint32_t oldCapacity = this->capacity;
+    this->capacity = newCapacity;
+    this->give(oldCapacity, newCapacity - oldCapacity);
+  }
+}
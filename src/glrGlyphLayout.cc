@@ -0,0 +1,110 @@
+#include "glrender/glrGlyphLayout.hh"
+
+#include "glrender/glrAssetRepository.hh"
+
+#include <algorithm>
+#include <bit>
+
+namespace glr
+{
+  uint32_t packColor(const Color& color)
+  {
+    const vec4<uint8_t> rgba = color.asRGBAui8();
+    return (uint32_t)rgba.r() | (uint32_t)rgba.g() << 8 | (uint32_t)rgba.b() << 16 | (uint32_t)rgba.a() << 24;
+  }
+
+  bool GlyphLayoutKey::operator==(const GlyphLayoutKey& other) const
+  {
+    return this->text == other.text && this->atlas == other.atlas && this->fontSize == other.fontSize && this->color == other.color;
+  }
+
+  size_t GlyphLayoutCache::KeyHash::operator()(const GlyphLayoutKey& key) const
+  {
+    size_t out = std::hash<std::string>{}(key.text);
+    const auto combine = [&](const uint64_t value)
+    {
+      out ^= std::hash<uint64_t>{}(value) + 0x9e3779b97f4a7c15ull + (out << 6) + (out >> 2);
+    };
+    combine(key.atlas);
+    combine(std::bit_cast<uint32_t>(key.fontSize));
+    combine(key.color.asHex());
+    return out;
+  }
+
+  GlyphRun layoutGlyphs(const GlyphLayoutKey& key)
+  {
+    GlyphRun out;
+    out.glyphs.reserve(key.text.size());
+    const uint32_t color = packColor(key.color);
+    float x = 0;
+    float y = 0;
+    for(const char character : key.text)
+    {
+      if(character == '\n')
+      {
+        x = 0;
+        y -= key.fontSize;
+        continue;
+      }
+
+      const std::string tile(1, character);
+      const vec2<float> dims = asset_repo::atlasGetTileDimensions(key.atlas, tile);
+      if(dims.x() == 0 || dims.y() == 0)
+      {
+        x += key.fontSize * 0.5f;
+        out.extent.x() = std::max(out.extent.x(), x);
+        continue;
+      }
+
+      LaidOutGlyph glyph;
+      glyph.pos = {x, y};
+      glyph.size = {key.fontSize * dims.x() / dims.y(), key.fontSize};
+      glyph.uvs = asset_repo::atlasGetUVsForTile(key.atlas, tile);
+      glyph.color = color;
+      out.glyphs.emplace_back(glyph);
+
+      x += glyph.size.x();
+      out.extent.x() = std::max(out.extent.x(), x);
+    }
+    out.extent.y() = key.fontSize - y;
+    return out;
+  }
+
+  const GlyphRun& GlyphLayoutCache::get(const GlyphLayoutKey& key, const uint64_t frame)
+  {
+    auto [it, inserted] = this->layouts.try_emplace(key);
+    if(inserted)
+    {
+      it->second.run = layoutGlyphs(key);
+    }
+    it->second.lastUsed = frame;
+    return it->second.run;
+  }
+
+  void GlyphLayoutCache::touch(const GlyphLayoutKey& key, const uint64_t frame)
+  {
+    const auto it = this->layouts.find(key);
+    if(it != this->layouts.end())
+    {
+      it->second.lastUsed = frame;
+    }
+  }
+
+  void GlyphLayoutCache::trim(const uint64_t oldestFrame)
+  {
+    std::erase_if(this->layouts, [&](const auto& entry)
+    {
+      return entry.second.lastUsed < oldestFrame;
+    });
+  }
+
+  void GlyphLayoutCache::clear()
+  {
+    this->layouts.clear();
+  }
+
+  size_t GlyphLayoutCache::size() const
+  {
+    return this->layouts.size();
+  }
+}
@@ -1,14 +1,200 @@
 #include "glrender/glrMesh.hh"
 
+#include "glrender/glrStateCache.hh"
+
 #include <glad/gl.hh>
 #include <commons/math/vec3.hh>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 namespace glr
 {
+  constexpr uint32_t MESH_VERTEX_BINDING = 0; //Interleaved meshes read every attribute through this binding
+  constexpr size_t MESH_DYNAMIC_MIN_VERTICES = 64;
+  constexpr size_t MESH_DYNAMIC_MIN_INDICES = 192;
+  constexpr uint64_t MESH_FENCE_TIMEOUT = 1000000; //Nanoseconds
+  constexpr GLbitfield MESH_DYNAMIC_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  std::atomic<uint64_t> meshBoundsRevisionCounter = 0;
+
+  uint64_t meshBoundsRevision()
+  {
+    return meshBoundsRevisionCounter.load(std::memory_order_relaxed);
+  }
+
+  struct VertexAttribute
+  {
+    const std::vector<float>* data = nullptr;
+    uint32_t Mesh::* buffer = nullptr; //Used by separate buffers
+    int32_t location = 0;
+    int32_t elements = 0;
+    GLRAttribFormat format = GLRAttribFormat::FLOAT;
+    size_t offset = 0; //In bytes, within an interleaved vertex
+  };
+  
+  uint16_t floatToHalf(const float value)
+  {
+    const uint32_t bits = std::bit_cast<uint32_t>(value);
+    const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    const int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    const uint32_t mantissa = bits & 0x7FFFFF;
+    if(((bits >> 23) & 0xFF) == 0xFF)
+    {
+      return sign | 0x7C00 | (mantissa ? 0x200 : 0); //Infinity or NaN
+    }
+    if(exponent <= 0)
+    {
+      return sign;
+    }
+    if(exponent >= 31)
+    {
+      return sign | 0x7C00;
+    }
+    const uint32_t rounded = ((uint32_t)exponent << 10 | mantissa >> 13) + ((mantissa >> 12) & 1);
+    return (uint16_t)(sign | std::min(rounded, 0x7C00u));
+  }
+  
+  uint32_t packSnorm10(const float* value)
+  {
+    uint32_t out = 0;
+    for(int32_t i = 0; i < 3; i++)
+    {
+      const int32_t quantized = (int32_t)std::lround(std::clamp(value[i], -1.0f, 1.0f) * 511.0f);
+      out |= ((uint32_t)quantized & 0x3FF) << (i * 10);
+    }
+    return out;
+  }
+  
+  //Bytes one attribute takes up in a vertex, padded to 4 bytes so every attribute stays aligned
+  size_t attributeSize(const GLRAttribFormat format, const int32_t elements)
+  {
+    size_t size = 0;
+    switch(format)
+    {
+      case GLRAttribFormat::FLOAT: size = elements * sizeof(float); break;
+      case GLRAttribFormat::HALF_FLOAT: size = elements * sizeof(uint16_t); break;
+      case GLRAttribFormat::UNORM8: size = elements; break;
+      case GLRAttribFormat::UNORM16: size = elements * sizeof(uint16_t); break;
+      case GLRAttribFormat::SNORM_2_10_10_10: size = sizeof(uint32_t); break;
+    }
+    return (size + 3) & ~(size_t)3;
+  }
+  
+  //Convert an attribute to its format and write it into every vertex, vertices past the end of the attribute's data are left as they are
+  //The format and element count are picked once per attribute, so each conversion is a tight loop with a fixed size copy per vertex
+  void encodeAttribute(const VertexAttribute& attribute, uint8_t* vertices, const size_t stride, const size_t firstVertex, const size_t lastVertex)
+  {
+    const float* src = attribute.data->data();
+    const int32_t elements = attribute.elements;
+    const size_t available = std::min(attribute.data->size() / elements, lastVertex);
+    uint8_t* dst = vertices + attribute.offset;
+    const auto encodeElements = [&]<typename T, int32_t Elements>(const auto& convert)
+    {
+      for(size_t vertex = firstVertex; vertex < available; vertex++)
+      {
+        std::array<T, Elements> value{};
+        for(int32_t i = 0; i < Elements; i++)
+        {
+          value[i] = convert(src[vertex * Elements + i]);
+        }
+        std::memcpy(dst + vertex * stride, value.data(), sizeof(value));
+      }
+    };
+    const auto encode = [&]<typename T>(const auto& convert)
+    {
+      switch(elements)
+      {
+        case 1: encodeElements.template operator()<T, 1>(convert); break;
+        case 2: encodeElements.template operator()<T, 2>(convert); break;
+        case 3: encodeElements.template operator()<T, 3>(convert); break;
+        default: encodeElements.template operator()<T, 4>(convert); break;
+      }
+    };
+    
+    switch(attribute.format)
+    {
+      case GLRAttribFormat::FLOAT:
+      {
+        encode.operator()<float>([](const float value) { return value; });
+        break;
+      }
+      case GLRAttribFormat::HALF_FLOAT:
+      {
+        encode.operator()<uint16_t>(floatToHalf);
+        break;
+      }
+      case GLRAttribFormat::UNORM8:
+      {
+        encode.operator()<uint8_t>([](const float value) { return (uint8_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); });
+        break;
+      }
+      case GLRAttribFormat::UNORM16:
+      {
+        encode.operator()<uint16_t>([](const float value) { return (uint16_t)(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f); });
+        break;
+      }
+      case GLRAttribFormat::SNORM_2_10_10_10:
+      {
+        for(size_t vertex = firstVertex; vertex < available; vertex++)
+        {
+          const float* value = src + vertex * elements;
+          const float xyz[3] = {value[0], elements > 1 ? value[1] : 0.0f, elements > 2 ? value[2] : 0.0f};
+          const uint32_t packed = packSnorm10(xyz);
+          std::memcpy(dst + vertex * stride, &packed, sizeof(uint32_t));
+        }
+        break;
+      }
+    }
+  }
+  
+  void enableAttribute(const uint32_t vertexArray, const VertexAttribute& attribute, const uint32_t binding)
+  {
+    const GLuint offset = (GLuint)attribute.offset;
+    switch(attribute.format)
+    {
+      case GLRAttribFormat::FLOAT:
+      {
+        glVertexArrayAttribFormat(vertexArray, attribute.location, attribute.elements, GL_FLOAT, GL_FALSE, offset);
+        break;
+      }
+      case GLRAttribFormat::HALF_FLOAT:
+      {
+        glVertexArrayAttribFormat(vertexArray, attribute.location, attribute.elements, GL_HALF_FLOAT, GL_FALSE, offset);
+        break;
+      }
+      case GLRAttribFormat::UNORM8:
+      {
+        glVertexArrayAttribFormat(vertexArray, attribute.location, attribute.elements, GL_UNSIGNED_BYTE, GL_TRUE, offset);
+        break;
+      }
+      case GLRAttribFormat::UNORM16:
+      {
+        glVertexArrayAttribFormat(vertexArray, attribute.location, attribute.elements, GL_UNSIGNED_SHORT, GL_TRUE, offset);
+        break;
+      }
+      case GLRAttribFormat::SNORM_2_10_10_10:
+      {
+        glVertexArrayAttribFormat(vertexArray, attribute.location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offset);
+        break;
+      }
+    }
+    glVertexArrayAttribBinding(vertexArray, attribute.location, binding);
+    glEnableVertexArrayAttrib(vertexArray, attribute.location);
+  }
+
   Mesh::~Mesh()
   {
+    this->deleteDynamic();
+    geometryArena().free(this->arenaAllocation);
+    stateCache().forgetVertexArray(this->vertexArrayHandle);
     glDeleteVertexArrays(1, &this->vertexArrayHandle);
     glDeleteBuffers(1, &this->indexBufferHandle);
+    glDeleteBuffers(1, &this->vertexBufferHandle);
     glDeleteBuffers(1, &this->positionBufferHandle);
     glDeleteBuffers(1, &this->normalBufferHandle);
     glDeleteBuffers(1, &this->uvBufferHandle);
@@ -45,6 +231,9 @@ namespace glr
     this->indexBufferHandle = moveFrom.indexBufferHandle;
     moveFrom.indexBufferHandle = INVALID_HANDLE;
 
+    this->vertexBufferHandle = moveFrom.vertexBufferHandle;
+    moveFrom.vertexBufferHandle = INVALID_HANDLE;
+
     this->normalBufferHandle = moveFrom.normalBufferHandle;
     moveFrom.normalBufferHandle = INVALID_HANDLE;
 
@@ -95,6 +284,47 @@ namespace glr
 
     this->positionStride = moveFrom.positionStride;
     moveFrom.positionStride = moveFrom.positionElements * sizeof(float);
+
+    this->positionFormat = moveFrom.positionFormat;
+    moveFrom.positionFormat = GLRAttribFormat::FLOAT;
+
+    this->uvFormat = moveFrom.uvFormat;
+    moveFrom.uvFormat = GLRAttribFormat::FLOAT;
+
+    this->normalFormat = moveFrom.normalFormat;
+    moveFrom.normalFormat = GLRAttribFormat::FLOAT;
+
+    this->colorFormat = moveFrom.colorFormat;
+    moveFrom.colorFormat = GLRAttribFormat::FLOAT;
+
+    this->compactIndices = moveFrom.compactIndices;
+    moveFrom.compactIndices = true;
+
+    this->indexType = moveFrom.indexType;
+    moveFrom.indexType = GLRIndexBufferType::UINT;
+
+    this->dynamic = moveFrom.dynamic;
+    moveFrom.dynamic = false;
+
+    this->regions = moveFrom.regions;
+    moveFrom.regions = {};
+
+    this->region = moveFrom.region;
+    this->vertexCapacity = moveFrom.vertexCapacity;
+    moveFrom.vertexCapacity = 0;
+
+    this->indexCapacity = moveFrom.indexCapacity;
+    moveFrom.indexCapacity = 0;
+
+    this->vertexStride = moveFrom.vertexStride;
+    this->dynamicDirty = moveFrom.dynamicDirty;
+    moveFrom.dynamicDirty = false;
+
+    this->arena = moveFrom.arena;
+    this->radius = moveFrom.radius;
+    meshBoundsRevisionCounter++;
+    this->arenaAllocation = moveFrom.arenaAllocation;
+    moveFrom.arenaAllocation = {};
   }
   
   Mesh& Mesh::operator=(Mesh&& moveFrom) noexcept
@@ -104,6 +334,8 @@ namespace glr
       return *this;
     }
     
+    this->deleteDynamic();
+    geometryArena().free(this->arenaAllocation);
     this->bufferType = moveFrom.bufferType;
     this->drawMode = moveFrom.drawMode;
     this->drawType = moveFrom.drawType;
@@ -132,6 +364,9 @@ namespace glr
     this->indexBufferHandle = moveFrom.indexBufferHandle;
     moveFrom.indexBufferHandle = INVALID_HANDLE;
 
+    this->vertexBufferHandle = moveFrom.vertexBufferHandle;
+    moveFrom.vertexBufferHandle = INVALID_HANDLE;
+
     this->normalBufferHandle = moveFrom.normalBufferHandle;
     moveFrom.normalBufferHandle = INVALID_HANDLE;
 
@@ -182,6 +417,47 @@ namespace glr
 
     this->positionStride = moveFrom.positionStride;
     moveFrom.positionStride = moveFrom.positionElements * sizeof(float);
+
+    this->positionFormat = moveFrom.positionFormat;
+    moveFrom.positionFormat = GLRAttribFormat::FLOAT;
+
+    this->uvFormat = moveFrom.uvFormat;
+    moveFrom.uvFormat = GLRAttribFormat::FLOAT;
+
+    this->normalFormat = moveFrom.normalFormat;
+    moveFrom.normalFormat = GLRAttribFormat::FLOAT;
+
+    this->colorFormat = moveFrom.colorFormat;
+    moveFrom.colorFormat = GLRAttribFormat::FLOAT;
+
+    this->compactIndices = moveFrom.compactIndices;
+    moveFrom.compactIndices = true;
+
+    this->indexType = moveFrom.indexType;
+    moveFrom.indexType = GLRIndexBufferType::UINT;
+
+    this->dynamic = moveFrom.dynamic;
+    moveFrom.dynamic = false;
+
+    this->regions = moveFrom.regions;
+    moveFrom.regions = {};
+
+    this->region = moveFrom.region;
+    this->vertexCapacity = moveFrom.vertexCapacity;
+    moveFrom.vertexCapacity = 0;
+
+    this->indexCapacity = moveFrom.indexCapacity;
+    moveFrom.indexCapacity = 0;
+
+    this->vertexStride = moveFrom.vertexStride;
+    this->dynamicDirty = moveFrom.dynamicDirty;
+    moveFrom.dynamicDirty = false;
+
+    this->arena = moveFrom.arena;
+    this->radius = moveFrom.radius;
+    meshBoundsRevisionCounter++;
+    this->arenaAllocation = moveFrom.arenaAllocation;
+    moveFrom.arenaAllocation = {};
     
     return *this;
   }
@@ -235,6 +511,7 @@ namespace glr
     this->hasPositions = true;
     this->numVerts = positionsSize / this->positionElements;
     this->positions.insert(this->positions.end(), positions, positions + positionsSize);
+    this->growRadius(positions, positionsSize);
     
     return this;
   }
@@ -326,73 +603,105 @@ namespace glr
         callback(GLRLogType::WARNING, "Mesh::finalize(): The number of color elements that have been added is not divisible by 4, this will cause unintended effects\n");
       }
     }
+
+    //2_10_10_10 only packs three elements, a color's alpha would be lost
+    if(this->colorFormat == GLRAttribFormat::SNORM_2_10_10_10)
+    {
+      if(callback)
+      {
+        callback(GLRLogType::WARNING, "Mesh::finalize(): Colors can't be stored as SNORM_2_10_10_10, storing them as UNORM8 instead\n");
+      }
+      this->colorFormat = GLRAttribFormat::UNORM8;
+    }
+    
+    //Each attribute is converted to its format while it's copied into place
+    const std::vector<VertexAttribute> attributes = this->attributes();
+    this->vertexStride = attributes.back().offset + attributeSize(attributes.back().format, attributes.back().elements);
+    
+    if(this->arena && !this->dynamic)
+    {
+      if(this->finalizeInArena(attributes))
+      {
+        return;
+      }
+      if(callback)
+      {
+        callback(GLRLogType::WARNING, "Mesh::finalize(): The geometry arena couldn't hold the Mesh, giving it buffers of its own instead\n");
+      }
+    }
     
     //Create a vertex array to hold all of our state for this mesh, reducing API call overhead when switching meshes
     glCreateVertexArrays(1, &this->vertexArrayHandle);
-
-    if(this->bufferType == GLRBufferType::SEPARATE)
+    
+    if(this->dynamic)
     {
-      //Create a buffer in the GPU's VRAM to hold our vertex position data
-      glCreateBuffers(1, &this->positionBufferHandle);
-      
-      //Upload our position data to the buffer we created
-      glNamedBufferData(this->positionBufferHandle, (GLsizeiptr)(this->positions.size() * sizeof(float)), this->positions.data(), (int)this->drawType);
-
-      //Bind the attribute to an index in the shaders
-      glVertexArrayAttribBinding(this->vertexArrayHandle, this->positionBindingPoint, this->positionBindingPoint);
-      
-      //Bind the buffer to our vertex array and give it the stride information
-      glVertexArrayVertexBuffer(this->vertexArrayHandle, this->positionBindingPoint, this->positionBufferHandle, 0, this->positionStride);
-
-      //Enable the attribute for our data buffer
-      glEnableVertexArrayAttrib(this->vertexArrayHandle, this->positionBindingPoint);
-
-      //Define the format of the buffer so OpenGL knows how to read data out of it
-      glVertexArrayAttribFormat(this->vertexArrayHandle, this->positionBindingPoint, this->positionElements, GL_FLOAT, GL_FALSE, 0);
+      //Every region is filled the first time it's used
+      for(const VertexAttribute& attribute : attributes)
+      {
+        enableAttribute(this->vertexArrayHandle, attribute, MESH_VERTEX_BINDING);
+      }
+      this->bufferType = GLRBufferType::INTERLEAVED;
+      this->indexType = GLRIndexBufferType::UINT;
+      this->retainBufferData = true;
+      this->finalized = true;
+      this->markDirty(0, this->numVerts, 0, this->numIndices);
+      this->commitDynamic();
+      return;
+    }
+    
+    if(this->bufferType == GLRBufferType::INTERLEAVED)
+    {
+      //Lay the attributes out one after another inside each vertex, all reading from one buffer through one binding
+      constexpr uint32_t vertexBinding = MESH_VERTEX_BINDING;
+      const size_t stride = this->vertexStride;
       
-      //Repeat for any other vertex data
-      if(this->hasIndices)
+      std::vector<uint8_t> vertices(this->numVerts * stride, 0);
+      for(const VertexAttribute& attribute : attributes)
       {
-        glCreateBuffers(1, &this->indexBufferHandle);
-        glNamedBufferData(this->indexBufferHandle, (GLsizeiptr)(this->indices.size() * sizeof(uint32_t)), this->indices.data(), (int)this->drawType);
-        glVertexArrayElementBuffer(this->vertexArrayHandle, this->indexBufferHandle);
+        encodeAttribute(attribute, vertices.data(), stride, 0, this->numVerts);
+        enableAttribute(this->vertexArrayHandle, attribute, vertexBinding);
       }
-      if(this->hasNormals)
+      
+      glCreateBuffers(1, &this->vertexBufferHandle);
+      glNamedBufferData(this->vertexBufferHandle, (GLsizeiptr)vertices.size(), vertices.data(), (int)this->drawType);
+      glVertexArrayVertexBuffer(this->vertexArrayHandle, vertexBinding, this->vertexBufferHandle, 0, (GLsizei)stride);
+    }
+    else
+    {
+      //Give every attribute its own buffer, bound at the attribute's location
+      for(VertexAttribute attribute : attributes)
       {
-        glCreateBuffers(1, &this->normalBufferHandle);
-        glNamedBufferData(this->normalBufferHandle, (GLsizeiptr)(this->normals.size() * sizeof(float)), this->normals.data(), (int)this->drawType);
-        glVertexArrayAttribBinding(this->vertexArrayHandle, this->normalBindingPoint, this->normalBindingPoint);
-        glVertexArrayVertexBuffer(this->vertexArrayHandle, this->normalBindingPoint, this->normalBufferHandle, 0, NORMAL_STRIDE);
-        glEnableVertexArrayAttrib(this->vertexArrayHandle, this->normalBindingPoint);
-        glVertexArrayAttribFormat(this->vertexArrayHandle, this->normalBindingPoint, NORMAL_ELEMENTS, GL_FLOAT, GL_FALSE, 0);
+        const size_t stride = attributeSize(attribute.format, attribute.elements);
+        attribute.offset = 0;
+        std::vector<uint8_t> vertices(this->numVerts * stride, 0);
+        encodeAttribute(attribute, vertices.data(), stride, 0, this->numVerts);
+        enableAttribute(this->vertexArrayHandle, attribute, (uint32_t)attribute.location);
+        
+        uint32_t& buffer = this->*attribute.buffer;
+        glCreateBuffers(1, &buffer);
+        glNamedBufferData(buffer, (GLsizeiptr)vertices.size(), vertices.data(), (int)this->drawType);
+        glVertexArrayVertexBuffer(this->vertexArrayHandle, (uint32_t)attribute.location, buffer, 0, (GLsizei)stride);
       }
-      if(this->hasUVs)
+    }
+    
+    if(this->hasIndices)
+    {
+      //16 bit indices are enough to address the first 65536 vertices, which halves the index buffer of most meshes
+      const bool compact = this->compactIndices && (this->indices.empty() || std::ranges::max(this->indices) <= std::numeric_limits<uint16_t>::max());
+      this->indexType = compact ? GLRIndexBufferType::USHORT : GLRIndexBufferType::UINT;
+      glCreateBuffers(1, &this->indexBufferHandle);
+      if(compact)
       {
-        glCreateBuffers(1, &this->uvBufferHandle);
-        glNamedBufferData(this->uvBufferHandle, (GLsizeiptr)(this->uvs.size() * sizeof(float)), this->uvs.data(), (int)this->drawType);
-        glVertexArrayAttribBinding(this->vertexArrayHandle, this->uvBindingPoint, this->uvBindingPoint);
-        glVertexArrayVertexBuffer(this->vertexArrayHandle, this->uvBindingPoint, this->uvBufferHandle, 0, UV_STRIDE);
-        glEnableVertexArrayAttrib(this->vertexArrayHandle, this->uvBindingPoint);
-        glVertexArrayAttribFormat(this->vertexArrayHandle, this->uvBindingPoint, UV_ELEMENTS, GL_FLOAT, GL_FALSE, 0);
+        const std::vector<uint16_t> shortIndices(this->indices.begin(), this->indices.end());
+        glNamedBufferData(this->indexBufferHandle, (GLsizeiptr)(shortIndices.size() * sizeof(uint16_t)), shortIndices.data(), (int)this->drawType);
       }
-      if(this->hasColors)
+      else
       {
-        glCreateBuffers(1, &this->colorBufferHandle);
-        glNamedBufferData(this->colorBufferHandle, (GLsizeiptr)(this->colors.size() * sizeof(float)), this->colors.data(), (int)this->drawType);
-        glVertexArrayAttribBinding(this->vertexArrayHandle, this->colorBindingPoint, this->colorBindingPoint);
-        glVertexArrayVertexBuffer(this->vertexArrayHandle, this->colorBindingPoint, this->colorBufferHandle, 0, COLOR_STRIDE);
-        glEnableVertexArrayAttrib(this->vertexArrayHandle, this->colorBindingPoint);
-        glVertexArrayAttribFormat(this->vertexArrayHandle, this->colorBindingPoint, COLOR_ELEMENTS, GL_FLOAT, GL_FALSE, 0);
+        glNamedBufferData(this->indexBufferHandle, (GLsizeiptr)(this->indices.size() * sizeof(uint32_t)), this->indices.data(), (int)this->drawType);
       }
+      glVertexArrayElementBuffer(this->vertexArrayHandle, this->indexBufferHandle);
     }
-    if(!this->retainBufferData)
-    {
-      this->indices.clear();
-      this->positions.clear();
-      this->normals.clear();
-      this->uvs.clear();
-      this->colors.clear();
-    }
+    this->releaseBufferData();
     this->finalized = true;
   }
   
@@ -400,7 +709,8 @@ namespace glr
   {
     if(this->finalized)
     {
-      glBindVertexArray(this->vertexArrayHandle);
+      this->commitDynamic();
+      stateCache().bindVertexArray(this->vertexArray());
     }
   }
 
@@ -413,4 +723,363 @@ namespace glr
   {
     return this->hasIndices;
   }
+
+  uint32_t Mesh::vertexArray() const
+  {
+    if(this->arenaAllocation.valid())
+    {
+      return geometryArena().vertexArray(this->arenaAllocation.pool);
+    }
+    return this->vertexArrayHandle;
+  }
+
+  float Mesh::boundingRadius() const
+  {
+    return this->radius;
+  }
+
+  uint32_t Mesh::baseVertex() const
+  {
+    return this->arenaAllocation.baseVertex;
+  }
+
+  uint32_t Mesh::firstIndex() const
+  {
+    return this->arenaAllocation.firstIndex;
+  }
+
+  Mesh* Mesh::setPositions(const float* positions, const size_t positionsSize, const size_t firstElement, const LoggingCallback& callback)
+  {
+    return this->setElements(this->positions, this->hasPositions, this->positionElements, positions, positionsSize, firstElement, "positions", callback);
+  }
+
+  Mesh* Mesh::setUVs(const float* uvs, const size_t uvsSize, const size_t firstElement, const LoggingCallback& callback)
+  {
+    return this->setElements(this->uvs, this->hasUVs, UV_ELEMENTS, uvs, uvsSize, firstElement, "UVs", callback);
+  }
+
+  Mesh* Mesh::setNormals(const float* normals, const size_t normalsSize, const size_t firstElement, const LoggingCallback& callback)
+  {
+    return this->setElements(this->normals, this->hasNormals, NORMAL_ELEMENTS, normals, normalsSize, firstElement, "normals", callback);
+  }
+
+  Mesh* Mesh::setColors(const float* colors, const size_t colorsSize, const size_t firstElement, const LoggingCallback& callback)
+  {
+    return this->setElements(this->colors, this->hasColors, COLOR_ELEMENTS, colors, colorsSize, firstElement, "colors", callback);
+  }
+
+  Mesh* Mesh::setIndices(const uint32_t* indices, const size_t indicesSize, const size_t firstIndex, const LoggingCallback& callback)
+  {
+    if(this->finalized && (!this->dynamic || !this->hasIndices))
+    {
+      if(callback)
+      {
+        callback(GLRLogType::WARNING, "Mesh::setIndices(): Only dynamic Meshes that were finalized with indices can have them changed\n");
+      }
+      return this;
+    }
+
+    const size_t end = firstIndex + indicesSize;
+    if(end > this->indices.size())
+    {
+      this->indices.resize(end);
+    }
+    std::copy(indices, indices + indicesSize, this->indices.begin() + (std::ptrdiff_t)firstIndex);
+    this->hasIndices = true;
+    this->numIndices = this->indices.size();
+    this->markDirty(0, 0, firstIndex, end);
+    return this;
+  }
+
+  Mesh* Mesh::resize(const size_t vertices, const size_t indices, const LoggingCallback& callback)
+  {
+    if(this->finalized && !this->dynamic)
+    {
+      if(callback)
+      {
+        callback(GLRLogType::WARNING, "Mesh::resize(): Attempting to resize a finalized Mesh that isn't dynamic\n");
+      }
+      return this;
+    }
+
+    const size_t oldVertices = this->numVerts;
+    const size_t oldIndices = this->numIndices;
+    this->positions.resize(vertices * this->positionElements);
+    if(this->hasUVs)
+    {
+      this->uvs.resize(vertices * UV_ELEMENTS);
+    }
+    if(this->hasNormals)
+    {
+      this->normals.resize(vertices * NORMAL_ELEMENTS);
+    }
+    if(this->hasColors)
+    {
+      this->colors.resize(vertices * COLOR_ELEMENTS);
+    }
+    if(this->hasIndices)
+    {
+      this->indices.resize(indices);
+      this->numIndices = indices;
+    }
+    this->numVerts = vertices;
+
+    //Shrinking only changes what's drawn, nothing has to be sent
+    if(this->numVerts > oldVertices || this->numIndices > oldIndices)
+    {
+      this->markDirty(oldVertices, this->numVerts, oldIndices, this->numIndices);
+    }
+    return this;
+  }
+
+  std::vector<VertexAttribute> Mesh::attributes() const
+  {
+    std::vector<VertexAttribute> out{};
+    out.emplace_back(&this->positions, &Mesh::positionBufferHandle, this->positionBindingPoint, this->positionElements, this->positionFormat);
+    if(this->hasUVs)
+    {
+      out.emplace_back(&this->uvs, &Mesh::uvBufferHandle, this->uvBindingPoint, UV_ELEMENTS, this->uvFormat);
+    }
+    if(this->hasNormals)
+    {
+      out.emplace_back(&this->normals, &Mesh::normalBufferHandle, this->normalBindingPoint, NORMAL_ELEMENTS, this->normalFormat);
+    }
+    if(this->hasColors)
+    {
+      out.emplace_back(&this->colors, &Mesh::colorBufferHandle, this->colorBindingPoint, COLOR_ELEMENTS, this->colorFormat);
+    }
+
+    //Offsets within an interleaved vertex
+    size_t offset = 0;
+    for(VertexAttribute& attribute : out)
+    {
+      attribute.offset = offset;
+      offset += attributeSize(attribute.format, attribute.elements);
+    }
+    return out;
+  }
+
+  Mesh* Mesh::setElements(std::vector<float>& target, bool& present, const int32_t elements, const float* data, const size_t size, const size_t firstElement, const char* name, const LoggingCallback& callback)
+  {
+    //A dynamic mesh's vertex layout is fixed when it's finalized, so attributes can't be added afterwards
+    if(this->finalized && (!this->dynamic || !present))
+    {
+      if(callback)
+      {
+        callback(GLRLogType::WARNING, std::string("Mesh::set(): Only dynamic Meshes that were finalized with ") + name + " can have them changed\n");
+      }
+      return this;
+    }
+
+    const size_t end = firstElement + size;
+    if(end > target.size())
+    {
+      target.resize(end);
+    }
+    std::copy(data, data + size, target.begin() + (std::ptrdiff_t)firstElement);
+    present = true;
+    const size_t firstVertex = firstElement / elements;
+    const size_t lastVertex = (end + elements - 1) / elements;
+    if(&target == &this->positions)
+    {
+      //Measure whole vertices, a slice may start or end partway through one
+      const size_t first = firstVertex * elements;
+      this->growRadius(this->positions.data() + first, std::min(lastVertex * elements, this->positions.size()) - first);
+      this->numVerts = this->positions.size() / this->positionElements;
+    }
+    this->markDirty(firstVertex, lastVertex, 0, 0);
+    return this;
+  }
+
+  void Mesh::markDirty(const size_t firstVertex, const size_t lastVertex, const size_t firstIndex, const size_t lastIndex)
+  {
+    if(!this->dynamic)
+    {
+      return;
+    }
+
+    const auto extend = [](size_t& begin, size_t& end, const size_t first, const size_t last)
+    {
+      if(first >= last)
+      {
+        return;
+      }
+      begin = begin == end ? first : std::min(begin, first);
+      end = std::max(end, last);
+    };
+    for(DynamicRegion& dynamicRegion : this->regions)
+    {
+      extend(dynamicRegion.vertexBegin, dynamicRegion.vertexEnd, firstVertex, lastVertex);
+      extend(dynamicRegion.indexBegin, dynamicRegion.indexEnd, firstIndex, lastIndex);
+    }
+    this->dynamicDirty = true;
+  }
+
+  void Mesh::growDynamic() const
+  {
+    //Buffer storage is immutable, so growing means waiting for every region to be free and making new buffers
+    this->deleteDynamic();
+    this->vertexCapacity = std::max({this->numVerts, this->vertexCapacity * 2, MESH_DYNAMIC_MIN_VERTICES});
+    if(this->hasIndices)
+    {
+      this->indexCapacity = std::max({this->numIndices, this->indexCapacity * 2, MESH_DYNAMIC_MIN_INDICES});
+    }
+
+    for(DynamicRegion& dynamicRegion : this->regions)
+    {
+      const GLsizeiptr vertexSize = (GLsizeiptr)(this->vertexCapacity * this->vertexStride);
+      glCreateBuffers(1, &dynamicRegion.vertexBuffer);
+      glNamedBufferStorage(dynamicRegion.vertexBuffer, vertexSize, nullptr, MESH_DYNAMIC_FLAGS);
+      dynamicRegion.vertices = (uint8_t*)glMapNamedBufferRange(dynamicRegion.vertexBuffer, 0, vertexSize, MESH_DYNAMIC_FLAGS);
+      std::memset(dynamicRegion.vertices, 0, (size_t)vertexSize); //Past the mesh's end the buffer is never written otherwise
+      dynamicRegion.vertexBegin = 0;
+      dynamicRegion.vertexEnd = this->numVerts;
+
+      if(this->hasIndices)
+      {
+        const GLsizeiptr indexSize = (GLsizeiptr)(this->indexCapacity * sizeof(uint32_t));
+        glCreateBuffers(1, &dynamicRegion.indexBuffer);
+        glNamedBufferStorage(dynamicRegion.indexBuffer, indexSize, nullptr, MESH_DYNAMIC_FLAGS);
+        dynamicRegion.indices = (uint32_t*)glMapNamedBufferRange(dynamicRegion.indexBuffer, 0, indexSize, MESH_DYNAMIC_FLAGS);
+        std::memset(dynamicRegion.indices, 0, (size_t)indexSize);
+        dynamicRegion.indexBegin = 0;
+        dynamicRegion.indexEnd = this->numIndices;
+      }
+    }
+  }
+
+  void Mesh::commitDynamic() const
+  {
+    if(!this->dynamic || !this->dynamicDirty)
+    {
+      return;
+    }
+
+    //Everything drawn from the current region so far is fenced before moving on, so it isn't overwritten while the GPU reads it
+    DynamicRegion& previous = this->regions[this->region];
+    if(previous.vertexBuffer != INVALID_HANDLE)
+    {
+      glDeleteSync((GLsync)previous.fence);
+      previous.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    if(this->numVerts > this->vertexCapacity || this->numIndices > this->indexCapacity || previous.vertexBuffer == INVALID_HANDLE)
+    {
+      this->growDynamic();
+    }
+
+    this->region = (this->region + 1) % MESH_DYNAMIC_REGIONS;
+    DynamicRegion& current = this->regions[this->region];
+    if(current.fence)
+    {
+      while(glClientWaitSync((GLsync)current.fence, GL_SYNC_FLUSH_COMMANDS_BIT, MESH_FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED) {}
+      glDeleteSync((GLsync)current.fence);
+      current.fence = nullptr;
+    }
+
+    //Only what changed since this region was last written is copied
+    if(current.vertexBegin < current.vertexEnd)
+    {
+      for(const VertexAttribute& attribute : this->attributes())
+      {
+        encodeAttribute(attribute, current.vertices, this->vertexStride, current.vertexBegin, std::min(current.vertexEnd, this->numVerts));
+      }
+    }
+    if(current.indices && current.indexBegin < current.indexEnd)
+    {
+      const size_t end = std::min(current.indexEnd, this->numIndices);
+      std::copy(this->indices.begin() + (std::ptrdiff_t)current.indexBegin, this->indices.begin() + (std::ptrdiff_t)end, current.indices + current.indexBegin);
+    }
+    current.vertexBegin = current.vertexEnd = 0;
+    current.indexBegin = current.indexEnd = 0;
+
+    glVertexArrayVertexBuffer(this->vertexArrayHandle, MESH_VERTEX_BINDING, current.vertexBuffer, 0, (GLsizei)this->vertexStride);
+    if(current.indexBuffer != INVALID_HANDLE)
+    {
+      glVertexArrayElementBuffer(this->vertexArrayHandle, current.indexBuffer);
+    }
+    this->dynamicDirty = false;
+  }
+
+  void Mesh::deleteDynamic() const
+  {
+    for(DynamicRegion& dynamicRegion : this->regions)
+    {
+      if(dynamicRegion.fence)
+      {
+        while(glClientWaitSync((GLsync)dynamicRegion.fence, GL_SYNC_FLUSH_COMMANDS_BIT, MESH_FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync((GLsync)dynamicRegion.fence);
+      }
+      if(dynamicRegion.vertexBuffer != INVALID_HANDLE)
+      {
+        glDeleteBuffers(1, &dynamicRegion.vertexBuffer);
+      }
+      if(dynamicRegion.indexBuffer != INVALID_HANDLE)
+      {
+        glDeleteBuffers(1, &dynamicRegion.indexBuffer);
+      }
+      dynamicRegion = {};
+    }
+  }
+
+  bool Mesh::finalizeInArena(const std::vector<VertexAttribute>& attributes)
+  {
+    ArenaLayout layout{};
+    layout.stride = (uint32_t)this->vertexStride;
+    std::vector<uint8_t> vertices(this->numVerts * this->vertexStride, 0);
+    for(const VertexAttribute& attribute : attributes)
+    {
+      encodeAttribute(attribute, vertices.data(), this->vertexStride, 0, this->numVerts);
+      layout.attributes.emplace_back(attribute.location, attribute.elements, attribute.format, (uint32_t)attribute.offset);
+    }
+
+    GeometryArena& arena = geometryArena();
+    this->arenaAllocation = arena.allocate(layout, vertices.data(), (uint32_t)this->numVerts, this->hasIndices ? this->indices.data() : nullptr, (uint32_t)this->numIndices);
+    if(!this->arenaAllocation.valid())
+    {
+      return false;
+    }
+
+    //Every mesh in the pool has the same formats, so setting them again changes nothing
+    for(const VertexAttribute& attribute : attributes)
+    {
+      enableAttribute(arena.vertexArray(this->arenaAllocation.pool), attribute, MESH_VERTEX_BINDING);
+    }
+    this->bufferType = GLRBufferType::INTERLEAVED;
+    this->indexType = GLRIndexBufferType::UINT;
+    this->releaseBufferData();
+    this->finalized = true;
+    return true;
+  }
+
+  void Mesh::releaseBufferData()
+  {
+    if(!this->retainBufferData)
+    {
+      this->indices.clear();
+      this->positions.clear();
+      this->normals.clear();
+      this->uvs.clear();
+      this->colors.clear();
+    }
+  }
+
+  void Mesh::growRadius(const float* positions, const size_t size)
+  {
+    //Overwritten positions may have been the furthest out, but a radius that's too big only costs some culling
+    float furthest = this->radius * this->radius;
+    for(size_t i = 0; i + this->positionElements <= size; i += this->positionElements)
+    {
+      float lengthSquared = 0.0f;
+      for(int32_t element = 0; element < this->positionElements; element++)
+      {
+        lengthSquared += positions[i + element] * positions[i + element];
+      }
+      furthest = std::max(furthest, lengthSquared);
+    }
+    if(furthest > this->radius * this->radius)
+    {
+      this->radius = std::sqrt(furthest);
+      meshBoundsRevisionCounter++;
+    }
+  }
 }
@@ -0,0 +1,384 @@
+#include "glrender/glrObjectStore.hh"
+#include "glrender/glrMesh.hh"
+
+namespace glr
+{
+  ID makeHandle(const uint32_t slot, const uint32_t generation)
+  {
+    return (ID)generation << 32 | slot;
+  }
+
+  ObjectStore::ObjectStore(const ObjectStore& copyFrom)
+  {
+    *this = copyFrom;
+  }
+
+  ObjectStore& ObjectStore::operator=(const ObjectStore& copyFrom)
+  {
+    if(this == &copyFrom)
+    {
+      return *this;
+    }
+    this->transforms = copyFrom.transforms;
+    this->layers = copyFrom.layers;
+    this->textures = copyFrom.textures;
+    this->meshes = copyFrom.meshes;
+    this->shaders = copyFrom.shaders;
+    this->handles = copyFrom.handles;
+    this->textureLayers = copyFrom.textureLayers;
+    this->slots = copyFrom.slots;
+    this->generations = copyFrom.generations;
+    this->freeSlots = copyFrom.freeSlots;
+
+    //Handles are copied as they are, so the copy's index can start as a clone
+    this->objectIndex = copyFrom.objectIndex ? copyFrom.objectIndex->clone() : nullptr;
+    this->boundsRevision = copyFrom.boundsRevision;
+    this->reordered = copyFrom.reordered;
+    return *this;
+  }
+
+  ID ObjectStore::add(const TransformComp& transform, const LayerComp& layer, const ID texture, const ID mesh, const ID shader, const uint32_t textureLayer)
+  {
+    uint32_t slot = 0;
+    if(!this->freeSlots.empty())
+    {
+      slot = this->freeSlots.back();
+      this->freeSlots.pop_back();
+    }
+    else
+    {
+      slot = (uint32_t)this->slots.size();
+      this->slots.emplace_back(FREE_SLOT);
+      this->generations.emplace_back(0);
+    }
+
+    const ID handle = makeHandle(slot, this->generations[slot]);
+    this->slots[slot] = (uint32_t)this->handles.size();
+    this->transforms.emplace_back(transform);
+    this->layers.emplace_back(layer);
+    this->textures.emplace_back(texture);
+    this->meshes.emplace_back(mesh);
+    this->shaders.emplace_back(shader);
+    this->handles.emplace_back(handle);
+    this->textureLayers.emplace_back(textureLayer);
+    if(this->objectIndex)
+    {
+      this->objectIndex->insert(handle, objectBounds(transform, mesh));
+    }
+    this->reordered = true;
+    return handle;
+  }
+
+  void ObjectStore::remove(const ID handle)
+  {
+    const size_t slot = this->slotOf(handle);
+    if(slot == FREE_SLOT)
+    {
+      return;
+    }
+    if(this->objectIndex)
+    {
+      this->objectIndex->remove(handle);
+    }
+
+    const size_t index = this->slots[slot];
+    const size_t last = this->handles.size() - 1;
+    if(index != last)
+    {
+      this->transforms[index] = this->transforms[last];
+      this->layers[index] = this->layers[last];
+      this->textures[index] = this->textures[last];
+      this->meshes[index] = this->meshes[last];
+      this->shaders[index] = this->shaders[last];
+      this->handles[index] = this->handles[last];
+      this->textureLayers[index] = this->textureLayers[last];
+      this->slots[(uint32_t)this->handles[index]] = (uint32_t)index;
+    }
+    this->transforms.pop_back();
+    this->layers.pop_back();
+    this->textures.pop_back();
+    this->meshes.pop_back();
+    this->shaders.pop_back();
+    this->handles.pop_back();
+    this->textureLayers.pop_back();
+
+    this->slots[slot] = FREE_SLOT;
+    this->generations[slot]++;
+    this->freeSlots.emplace_back((uint32_t)slot);
+    this->reordered = true;
+  }
+
+  void ObjectStore::append(const ObjectStore& other)
+  {
+    this->reserve(this->size() + other.size());
+    for(size_t i = 0; i < other.size(); i++)
+    {
+      this->add(other.transforms[i], other.layers[i], other.textures[i], other.meshes[i], other.shaders[i], other.textureLayers[i]);
+    }
+  }
+
+  void ObjectStore::reserve(const size_t amount)
+  {
+    this->transforms.reserve(amount);
+    this->layers.reserve(amount);
+    this->textures.reserve(amount);
+    this->meshes.reserve(amount);
+    this->shaders.reserve(amount);
+    this->handles.reserve(amount);
+    this->textureLayers.reserve(amount);
+    this->slots.reserve(amount);
+    this->generations.reserve(amount);
+  }
+
+  void ObjectStore::clear()
+  {
+    //Generations are kept and bumped for every live object, so handles from before the clear stay invalid once their slots are reused
+    for(const ID handle : this->handles)
+    {
+      const uint32_t slot = (uint32_t)handle;
+      this->slots[slot] = FREE_SLOT;
+      this->generations[slot]++;
+    }
+    this->freeSlots.clear();
+    for(uint32_t slot = (uint32_t)this->slots.size(); slot > 0; slot--)
+    {
+      this->freeSlots.emplace_back(slot - 1);
+    }
+
+    this->transforms.clear();
+    this->layers.clear();
+    this->textures.clear();
+    this->meshes.clear();
+    this->shaders.clear();
+    this->handles.clear();
+    this->textureLayers.clear();
+    this->reordered = false;
+    if(this->objectIndex)
+    {
+      this->objectIndex->clear();
+    }
+  }
+
+  bool ObjectStore::contains(const ID handle) const
+  {
+    return this->slotOf(handle) != FREE_SLOT;
+  }
+
+  bool ObjectStore::empty() const
+  {
+    return this->handles.empty();
+  }
+
+  size_t ObjectStore::size() const
+  {
+    return this->handles.size();
+  }
+
+  size_t ObjectStore::indexOf(const ID handle) const
+  {
+    const size_t slot = this->slotOf(handle);
+    if(slot == FREE_SLOT)
+    {
+      return FREE_SLOT;
+    }
+    return this->slots[slot];
+  }
+
+  TransformComp* ObjectStore::transform(const ID handle)
+  {
+    const size_t index = this->indexOf(handle);
+    if(index == FREE_SLOT)
+    {
+      return nullptr;
+    }
+    return &this->transforms[index];
+  }
+
+  LayerComp* ObjectStore::layer(const ID handle)
+  {
+    const size_t index = this->indexOf(handle);
+    if(index == FREE_SLOT)
+    {
+      return nullptr;
+    }
+    //The layer may be changed through the pointer
+    this->reordered = true;
+    return &this->layers[index];
+  }
+
+  void ObjectStore::setTexture(const ID handle, const ID texture)
+  {
+    const size_t index = this->indexOf(handle);
+    if(index == FREE_SLOT)
+    {
+      return;
+    }
+    this->textures[index] = texture;
+  }
+
+  void ObjectStore::setMesh(const ID handle, const ID mesh)
+  {
+    const size_t index = this->indexOf(handle);
+    if(index == FREE_SLOT)
+    {
+      return;
+    }
+    this->meshes[index] = mesh;
+    if(this->objectIndex)
+    {
+      this->objectIndex->update(handle, objectBounds(this->transforms[index], mesh));
+    }
+  }
+
+  void ObjectStore::setShader(const ID handle, const ID shader)
+  {
+    const size_t index = this->indexOf(handle);
+    if(index == FREE_SLOT)
+    {
+      return;
+    }
+    this->shaders[index] = shader;
+  }
+
+  void ObjectStore::setTextureLayer(const ID handle, const uint32_t textureLayer)
+  {
+    const size_t index = this->indexOf(handle);
+    if(index == FREE_SLOT)
+    {
+      return;
+    }
+    this->textureLayers[index] = textureLayer;
+  }
+
+  void ObjectStore::setTransform(const ID handle, const TransformComp& transform)
+  {
+    const size_t index = this->indexOf(handle);
+    if(index == FREE_SLOT)
+    {
+      return;
+    }
+    this->transforms[index] = transform;
+    if(this->objectIndex)
+    {
+      this->objectIndex->update(handle, objectBounds(transform, this->meshes[index]));
+    }
+  }
+
+  void ObjectStore::refit(const ID handle)
+  {
+    const size_t index = this->indexOf(handle);
+    if(index == FREE_SLOT || !this->objectIndex)
+    {
+      return;
+    }
+    this->objectIndex->update(handle, objectBounds(this->transforms[index], this->meshes[index]));
+  }
+
+  void ObjectStore::setSpatialIndex(std::unique_ptr<SpatialIndex> spatialIndex)
+  {
+    this->objectIndex = std::move(spatialIndex);
+    if(!this->objectIndex)
+    {
+      return;
+    }
+    this->objectIndex->clear();
+    this->boundsRevision = meshBoundsRevision();
+    for(size_t i = 0; i < this->size(); i++)
+    {
+      this->objectIndex->insert(this->handles[i], objectBounds(this->transforms[i], this->meshes[i]));
+    }
+  }
+
+  void ObjectStore::refreshBounds() const
+  {
+    //Meshes that weren't created or finalized yet when their objects were indexed had no radius
+    const uint64_t revision = meshBoundsRevision();
+    if(!this->objectIndex || revision == this->boundsRevision)
+    {
+      return;
+    }
+    this->boundsRevision = revision;
+    for(size_t i = 0; i < this->size(); i++)
+    {
+      this->objectIndex->update(this->handles[i], objectBounds(this->transforms[i], this->meshes[i]));
+    }
+  }
+
+  const SpatialIndex* ObjectStore::spatialIndex() const
+  {
+    return this->objectIndex.get();
+  }
+
+  void ObjectStore::query(const Bounds& bounds, std::vector<ID>& out) const
+  {
+    if(this->objectIndex)
+    {
+      this->refreshBounds();
+      this->objectIndex->query(bounds, out);
+      return;
+    }
+    for(size_t i = 0; i < this->size(); i++)
+    {
+      if(boundsOverlap(objectBounds(this->transforms[i], this->meshes[i]), bounds))
+      {
+        out.emplace_back(this->handles[i]);
+      }
+    }
+  }
+
+  template <typename T> void permuteValues(std::vector<T>& values, const std::vector<uint32_t>& order, std::vector<T>& scratch)
+  {
+    scratch.resize(order.size());
+    for(size_t i = 0; i < order.size(); i++)
+    {
+      scratch[i] = values[order[i]];
+    }
+    values.swap(scratch);
+  }
+
+  void ObjectStore::permute(const std::vector<uint32_t>& order)
+  {
+    if(order.size() != this->size())
+    {
+      return;
+    }
+
+    this->scratchTransforms.resize(order.size());
+    this->scratchLayers.resize(order.size());
+    for(size_t i = 0; i < order.size(); i++)
+    {
+      this->scratchTransforms[i] = this->transforms[order[i]];
+      this->scratchLayers[i] = this->layers[order[i]];
+    }
+    this->transforms.swap(this->scratchTransforms);
+    this->layers.swap(this->scratchLayers);
+
+    permuteValues(this->textures, order, this->scratchIDs);
+    permuteValues(this->meshes, order, this->scratchIDs);
+    permuteValues(this->shaders, order, this->scratchIDs);
+    permuteValues(this->handles, order, this->scratchIDs);
+    permuteValues(this->textureLayers, order, this->scratchTextureLayers);
+
+    for(size_t i = 0; i < this->handles.size(); i++)
+    {
+      this->slots[(uint32_t)this->handles[i]] = (uint32_t)i;
+    }
+    this->reordered = false;
+  }
+
+  bool ObjectStore::orderChanged() const
+  {
+    return this->reordered;
+  }
+
+  size_t ObjectStore::slotOf(const ID handle) const
+  {
+    const uint32_t slot = (uint32_t)handle;
+    const uint32_t generation = (uint32_t)(handle >> 32);
+    if(slot >= this->slots.size() || this->generations[slot] != generation || this->slots[slot] == FREE_SLOT)
+    {
+      return FREE_SLOT;
+    }
+    return slot;
+  }
+}
@@ -1,7 +1,10 @@
 #include "glrender/glrPipelineRenderer.hh"
 #include "glrender/glrAssetRepository.hh"
+#include "glrender/glrStateCache.hh"
 
 #include <glad/gl.hh>
+#include <cstring>
+#include <utility>
 
 namespace glr
 {
@@ -136,63 +139,62 @@ namespace glr
     #endif
   }
   
-  Pipeline::Pipeline()
+  template <typename... Args> void Pipeline::record(Args&&... args)
   {
-    int32_t maxTextures;
-    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxTextures);
-    this->currentTexture.resize(maxTextures, INVALID_ID);
+    this->instructions.emplace_back(std::forward<Args>(args)...);
+    this->compiled = false;
   }
   
   void Pipeline::setModelMatrix(const MatrixCallback& callback)
   {
-    this->instructions.emplace_back(OpCode::SET_MODEL_MATRIX);
+    this->record(OpCode::SET_MODEL_MATRIX);
     this->instructions.back().matrixCallback = callback;
   }
   
   void Pipeline::setViewMatrix(const MatrixCallback& callback)
   {
-    this->instructions.emplace_back(OpCode::SET_VIEW_MATRIX);
+    this->record(OpCode::SET_VIEW_MATRIX);
     this->instructions.back().matrixCallback = callback;
   }
   
   void Pipeline::setPerspectiveProjectionMatrix(const MatrixCallback& callback)
   {
-    this->instructions.emplace_back(OpCode::SET_PERSP_PROJECTION_MATRIX);
+    this->record(OpCode::SET_PERSP_PROJECTION_MATRIX);
     this->instructions.back().matrixCallback = callback;
   }
   
   void Pipeline::setOrthoProjectionMatrix(const MatrixCallback& callback)
   {
-    this->instructions.emplace_back(OpCode::SET_ORTHO_PROJECTION_MATRIX);
+    this->record(OpCode::SET_ORTHO_PROJECTION_MATRIX);
     this->instructions.back().matrixCallback = callback;
   }
 
   void Pipeline::calculateMVP()
   {
-    this->instructions.emplace_back(OpCode::CALCULATE_MVP);
+    this->record(OpCode::CALCULATE_MVP);
   }
   
   void Pipeline::setClearColor(const vec4<float>& color)
   {
-    this->instructions.emplace_back(OpCode::SET_CLEAR_COLOR);
+    this->record(OpCode::SET_CLEAR_COLOR);
     this->instructions.back().data.varVec4f = color;
   }
 
   void Pipeline::setClearDepth(const float value)
   {
-    this->instructions.emplace_back(OpCode::SET_CLEAR_DEPTH);
+    this->record(OpCode::SET_CLEAR_DEPTH);
     this->instructions.back().data.varF = value;
   }
 
   void Pipeline::setClearStencil(const int32_t value)
   {
-    this->instructions.emplace_back(OpCode::SET_CLEAR_STENCIL);
+    this->record(OpCode::SET_CLEAR_STENCIL);
     this->instructions.back().data.varI32 = value;
   }
   
   void Pipeline::clearCurrentFramebuffer(const GLRClearType a, const GLRClearType b, const GLRClearType c)
   {
-    this->instructions.emplace_back(OpCode::CLEAR);
+    this->record(OpCode::CLEAR);
     this->instructions.back().enumA = (uint32_t)a;
     this->instructions.back().enumB = (uint32_t)b;
     this->instructions.back().enumC = (uint32_t)c;
@@ -200,222 +202,371 @@ namespace glr
 
   void Pipeline::bindTexture(const ID texture, const uint32_t target)
   {
-    this->instructions.emplace_back(OpCode::USE_TEX, texture, target);
+    this->record(OpCode::USE_TEX, texture, target);
   }
 
   void Pipeline::bindImage(const ID texture, const uint32_t target, const GLRIOMode a, const GLRColorFormat b)
   {
-    this->instructions.emplace_back(OpCode::USE_IMG, texture, target, (uint16_t)a, (uint16_t)b);
+    this->record(OpCode::USE_IMG, texture, target, (uint16_t)a, (uint16_t)b);
   }
   
   void Pipeline::bindMesh(const ID mesh)
   {
-    this->instructions.emplace_back(OpCode::USE_MESH, mesh);
+    this->record(OpCode::USE_MESH, mesh);
   }
 
   void Pipeline::bindShader(const ID shader)
   {
-    this->instructions.emplace_back(OpCode::USE_SHADER, shader);
+    this->record(OpCode::USE_SHADER, shader);
   }
 
   void Pipeline::bindBackbuffer()
   {
-    this->instructions.emplace_back(OpCode::USE_BACKBUFFER);
+    this->record(OpCode::USE_BACKBUFFER);
   }
 
   void Pipeline::bindFramebuffer(const ID framebuffer)
   {
-    this->instructions.emplace_back(OpCode::USE_FBO, framebuffer);
+    this->record(OpCode::USE_FBO, framebuffer);
   }
 
   void Pipeline::bindFramebufferAttachment(const ID framebuffer, const uint32_t target, const GLRAttachment a, const GLRAttachmentType b)
   {
-    this->instructions.emplace_back(OpCode::USE_ATTACH, framebuffer, target, (uint16_t)a, (uint16_t)b);
+    this->record(OpCode::USE_ATTACH, framebuffer, target, (uint16_t)a, (uint16_t)b);
   }
 
   void Pipeline::bindShaderPipeline(const ID shaderPipeline)
   {
-    this->instructions.emplace_back(OpCode::USE_PIPELINE, shaderPipeline);
+    this->record(OpCode::USE_PIPELINE, shaderPipeline);
   }
 
   void Pipeline::setUniformFloat(const ID shader, const std::string& name, const float value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_F, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_F, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varF = value;
   }
 
   void Pipeline::setUniformU8(const ID shader, const std::string& name, const uint32_t value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_U8, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_U8, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varU8 = value;
   }
   
   void Pipeline::setUniformI8(const ID shader, const std::string& name, const uint32_t value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_I8, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_I8, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varI8 = value;
   }
   
   void Pipeline::setUniformU16(const ID shader, const std::string& name, const uint32_t value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_U16, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_U16, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varU16 = value;
   }
   
   void Pipeline::setUniformI16(const ID shader, const std::string& name, const uint32_t value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_I16, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_I16, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varI16 = value;
   }
   
   void Pipeline::setUniformU32(const ID shader, const std::string& name, const uint32_t value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_U32, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_U32, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varU32 = value;
   }
 
   void Pipeline::setUniformI32(const ID shader, const std::string& name, const int32_t value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_I32, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_I32, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varI32 = value;
   }
 
   
   void Pipeline::setUniformVec2u(ID shader, const std::string& name, const vec2<uint32_t>& value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_VEC2U, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_VEC2U, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varVec2u = value;
   }
   
   void Pipeline::setUniformVec2i(ID shader, const std::string& name, const vec2<int32_t>& value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_VEC2I, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_VEC2I, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varVec2i = value;
   }
   
   void Pipeline::setUniformVec2f(ID shader, const std::string& name, const vec2<float>& value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_VEC2F, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_VEC2F, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varVec2f = value;
   }
 
 
   void Pipeline::setUniformVec3u(ID shader, const std::string& name, const vec3<uint32_t>& value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_VEC3U, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_VEC3U, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varVec3u = value;
   }
   
   void Pipeline::setUniformVec3i(ID shader, const std::string& name, const vec3<int32_t>& value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_VEC3I, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_VEC3I, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varVec3i = value;
   }
   
   void Pipeline::setUniformVec3f(ID shader, const std::string& name, const vec3<float>& value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_VEC3F, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_VEC3F, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varVec3f = value;
   }
 
 
   void Pipeline::setUniformVec4u(ID shader, const std::string& name, const vec4<uint32_t>& value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_VEC4U, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_VEC4U, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varVec4u = value;
   }
   
   void Pipeline::setUniformVec4i(ID shader, const std::string& name, const vec4<int32_t>& value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_VEC4I, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_VEC4I, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varVec4i = value;
   }
   
   void Pipeline::setUniformVec4f(ID shader, const std::string& name, const vec4<float>& value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_VEC4F, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_VEC4F, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varVec4f = value;
   }
   
   void Pipeline::setUniformMat3f(ID shader, const std::string& name, const mat3x3<float>& value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_MAT3F, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_MAT3F, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varMat3f = value;
   }
   
   void Pipeline::setUniformMat4f(ID shader, const std::string& name, const mat4x4<float>& value)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_MAT4F, shader, 0, 0, 0, 0, name);
+    this->record(OpCode::SET_UNI_MAT4F, shader, 0, 0, 0, 0, name);
     this->instructions.back().data.varMat4f = value;
   }
 
   void Pipeline::setUniformMVP(ID shader)
   {
-    this->instructions.emplace_back(OpCode::SET_UNI_MVP, shader);
+    this->record(OpCode::SET_UNI_MVP, shader);
     this->instructions.back().name = "mvp";
   }
 
   
   void Pipeline::sendUniforms(const ID shader)
   {
-    this->instructions.emplace_back(OpCode::SEND_UNIFORMS, shader);
+    this->record(OpCode::SEND_UNIFORMS, shader);
   }
 
   void Pipeline::dispatchCompute()
   {
-    this->instructions.emplace_back(OpCode::DISPATCH_COMPUTE);
+    this->record(OpCode::DISPATCH_COMPUTE);
   }
 
   void Pipeline::draw(const GLRDrawMode a, const uint64_t numVertices)
   {
-    this->instructions.emplace_back(OpCode::DRAW, INVALID_ID, 0, (uint16_t)a);
+    this->record(OpCode::DRAW, INVALID_ID, 0, (uint16_t)a);
     this->instructions.back().data.varU64 = numVertices;
   }
 
   void Pipeline::drawIndexed(const GLRDrawMode a, const uint64_t numIndices, const GLRIndexBufferType b)
   {
-    this->instructions.emplace_back(OpCode::DRAW_INDEXED, INVALID_ID, 0, (uint16_t)a, (uint16_t)b);
+    this->record(OpCode::DRAW_INDEXED, INVALID_ID, 0, (uint16_t)a, (uint16_t)b);
     this->instructions.back().data.varU64 = numIndices;
   }
 
   void Pipeline::setFilterMode(const GLRFilterMode min, const GLRFilterMode mag)
   {
-    this->instructions.emplace_back(OpCode::SET_FILTER_MODE, INVALID_ID, 0, (uint16_t)min, (uint16_t)mag);
+    this->record(OpCode::SET_FILTER_MODE, INVALID_ID, 0, (uint16_t)min, (uint16_t)mag);
   }
 
   void Pipeline::setBlend(const bool enabled)
   {
-    this->instructions.emplace_back(OpCode::SET_BLEND);
+    this->record(OpCode::SET_BLEND);
     this->instructions.back().data.varBool = enabled;
   }
 
   void Pipeline::setBlendMode(const GLRBlendMode src, const GLRBlendMode dst)
   {
-    this->instructions.emplace_back(OpCode::SET_BLEND_MODE, INVALID_ID, 0, (uint16_t)src, (uint16_t)dst);
+    this->record(OpCode::SET_BLEND_MODE, INVALID_ID, 0, (uint16_t)src, (uint16_t)dst);
   }
 
   void Pipeline::setDepthTest(const bool enabled)
   {
-    this->instructions.emplace_back(OpCode::SET_DEPTH_TEST);
+    this->record(OpCode::SET_DEPTH_TEST);
     this->instructions.back().data.varBool = enabled;
   }
   
   void Pipeline::setScissorTest(const bool enabled)
   {
-    this->instructions.emplace_back(OpCode::SET_SCISSOR_TEST);
+    this->record(OpCode::SET_SCISSOR_TEST);
     this->instructions.back().data.varBool = enabled;
   }
 
   void Pipeline::setCullBackfaces(const bool enabled)
   {
-    this->instructions.emplace_back(OpCode::SET_CULL_BACKFACE);
+    this->record(OpCode::SET_CULL_BACKFACE);
     this->instructions.back().data.varBool = enabled;
   }
   
 
+  uint32_t Pipeline::compileID(const ID id, std::unordered_map<ID, uint32_t>& lookup)
+  {
+    const auto [it, inserted] = lookup.try_emplace(id, (uint32_t)this->ids.size());
+    if(inserted)
+    {
+      this->ids.emplace_back(id);
+    }
+    return it->second;
+  }
+
+  uint32_t Pipeline::compileUniform(const uint32_t shader, const std::string& name, std::map<std::pair<uint32_t, std::string>, uint32_t>& lookup)
+  {
+    const auto [it, inserted] = lookup.try_emplace({shader, name}, (uint32_t)this->uniformBindings.size());
+    if(inserted)
+    {
+      this->uniformBindings.emplace_back(shader, name);
+    }
+    return it->second;
+  }
+
+  void Pipeline::resolveUniforms()
+  {
+    for(auto& [shader, name, resolved, slot] : this->uniformBindings)
+    {
+      resolved = asset_repo::shaderGet(this->ids[shader]);
+      slot = resolved ? resolved->uniformSlot(name) : 0;
+    }
+    this->resolvedRevision = shaderRevision();
+  }
+
+  template <typename T> uint32_t Pipeline::compileData(const T& value)
+  {
+    const uint32_t offset = (uint32_t)this->dataArena.size();
+    this->dataArena.resize(offset + sizeof(T));
+    std::memcpy(this->dataArena.data() + offset, &value, sizeof(T));
+    return offset;
+  }
+
+  template <typename T> T Pipeline::readData(const uint32_t offset) const
+  {
+    T out;
+    std::memcpy(&out, this->dataArena.data() + offset, sizeof(T));
+    return out;
+  }
+
+  void Pipeline::compile()
+  {
+    this->program.clear();
+    this->ids.clear();
+    this->uniformBindings.clear();
+    this->matrixCallbacks.clear();
+    this->dataArena.clear();
+    this->program.reserve(this->instructions.size());
+
+    std::unordered_map<ID, uint32_t> idLookup{};
+    std::map<std::pair<uint32_t, std::string>, uint32_t> uniformLookup{};
+    for(const auto& [op, id, target, enumA, enumB, enumC, name, matrixCallback, data] : this->instructions)
+    {
+      CompiledInstruction& out = this->program.emplace_back(op, (uint16_t)enumA, (uint16_t)enumB, (uint16_t)enumC, target);
+      switch(op)
+      {
+        case OpCode::SET_MODEL_MATRIX:
+        case OpCode::SET_VIEW_MATRIX:
+        case OpCode::SET_ORTHO_PROJECTION_MATRIX:
+        case OpCode::SET_PERSP_PROJECTION_MATRIX:
+        {
+          out.operand = (uint32_t)this->matrixCallbacks.size();
+          this->matrixCallbacks.emplace_back(matrixCallback);
+          break;
+        }
+        case OpCode::SET_CLEAR_COLOR: out.operand = this->compileData(data.varVec4f); break;
+        case OpCode::SET_CLEAR_DEPTH: out.operand = this->compileData(data.varF); break;
+        case OpCode::SET_CLEAR_STENCIL: out.operand = this->compileData(data.varI32); break;
+        case OpCode::CLEAR:
+        {
+          //Combined ahead of time so executing it is one glClear with the mask
+          out.operand = enumA | enumB | enumC;
+          break;
+        }
+        
+        case OpCode::USE_TEX:
+        case OpCode::USE_IMG:
+        case OpCode::USE_SHADER:
+        case OpCode::USE_MESH:
+        case OpCode::USE_FBO:
+        case OpCode::USE_ATTACH:
+        case OpCode::USE_PIPELINE:
+        case OpCode::SEND_UNIFORMS:
+        {
+          out.id = this->compileID(id, idLookup);
+          break;
+        }
+        
+        case OpCode::SET_UNI_F: out.operand = this->compileData(data.varF); break;
+        case OpCode::SET_UNI_U8: out.operand = this->compileData((uint32_t)data.varU8); break;
+        case OpCode::SET_UNI_I8: out.operand = this->compileData((int32_t)data.varI8); break;
+        case OpCode::SET_UNI_U16: out.operand = this->compileData((uint32_t)data.varU16); break;
+        case OpCode::SET_UNI_I16: out.operand = this->compileData((int32_t)data.varI16); break;
+        case OpCode::SET_UNI_U32: out.operand = this->compileData(data.varU32); break;
+        case OpCode::SET_UNI_I32: out.operand = this->compileData(data.varI32); break;
+        case OpCode::SET_UNI_VEC2U: out.operand = this->compileData(data.varVec2u); break;
+        case OpCode::SET_UNI_VEC2I: out.operand = this->compileData(data.varVec2i); break;
+        case OpCode::SET_UNI_VEC2F: out.operand = this->compileData(data.varVec2f); break;
+        case OpCode::SET_UNI_VEC3U: out.operand = this->compileData(data.varVec3u); break;
+        case OpCode::SET_UNI_VEC3I: out.operand = this->compileData(data.varVec3i); break;
+        case OpCode::SET_UNI_VEC3F: out.operand = this->compileData(data.varVec3f); break;
+        case OpCode::SET_UNI_VEC4U: out.operand = this->compileData(data.varVec4u); break;
+        case OpCode::SET_UNI_VEC4I: out.operand = this->compileData(data.varVec4i); break;
+        case OpCode::SET_UNI_VEC4F: out.operand = this->compileData(data.varVec4f); break;
+        case OpCode::SET_UNI_MAT3F: out.operand = this->compileData(data.varMat3f); break;
+        case OpCode::SET_UNI_MAT4F: out.operand = this->compileData(data.varMat4f); break;
+        case OpCode::SET_UNI_MVP: break;
+        
+        case OpCode::DRAW:
+        case OpCode::DRAW_INDEXED:
+        {
+          out.operand = this->compileData(data.varU64);
+          break;
+        }
+        
+        case OpCode::SET_CULL_BACKFACE:
+        case OpCode::SET_BLEND:
+        case OpCode::SET_DEPTH_TEST:
+        case OpCode::SET_SCISSOR_TEST:
+        {
+          out.enumA = data.varBool;
+          break;
+        }
+        
+        default: break;
+      }
+      
+      if(op >= OpCode::SET_UNI_F && op <= OpCode::SET_UNI_MVP)
+      {
+        out.id = this->compileID(id, idLookup);
+        out.target = this->compileUniform(out.id, name, uniformLookup);
+      }
+    }
+    this->resolveUniforms();
+    this->compiled = true;
+  }
+
+  bool Pipeline::isCompiled() const
+  {
+    return this->compiled;
+  }
+  
+
   PipelineRenderer::PipelineRenderer(const GLLoadFunc loadFunc, const uint32_t contextWidth, const uint32_t contextHeight, const LoggingCallback& callback)
   {
     gladLoadGL(loadFunc);
+    stateCache().invalidate();
     this->viewport = {contextWidth, contextHeight};
     
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
@@ -423,7 +574,7 @@ namespace glr
     glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
 
     glHint(GL_FRAGMENT_SHADER_DERIVATIVE_HINT, GL_NICEST);
-    glViewport(0, 0, (GLsizei)contextWidth, (GLsizei)contextHeight);
+    stateCache().setViewport(0, 0, (int32_t)contextWidth, (int32_t)contextHeight);
     
     glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &this->maxTextureUnitsPerStage);
     glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &this->maxTextureUnits);
@@ -436,6 +587,10 @@ namespace glr
     const ID out = this->lastPipeline;
     this->lastPipeline++;
     this->pipelines[out] = pipeline;
+    if(!this->pipelines.at(out).isCompiled())
+    {
+      this->pipelines.at(out).compile();
+    }
     return out;
   }
 
@@ -448,35 +603,55 @@ namespace glr
     this->currentPipeline = pipeline;
   }
 
+  StateCacheStats PipelineRenderer::stateStats() const
+  {
+    return this->frameStateStats;
+  }
+
   void PipelineRenderer::render()
   {
+    stateCache().resetStats();
+    asset_repo::createQueued(this->assetCreationBudget);
     auto& curPipeline = this->pipelines.at(this->currentPipeline);
-    for(const auto& [op, id, target, enumA, enumB, enumC, name, matrixCallback, data] : curPipeline.instructions)
+    const std::vector<ID>& ids = curPipeline.ids;
+    if(curPipeline.resolvedRevision != shaderRevision())
+    {
+      curPipeline.resolveUniforms();
+    }
+    const auto setUniform = [&](const uint32_t binding, const Shader::UniformValue& value)
+    {
+      const Pipeline::UniformBinding& uniform = curPipeline.uniformBindings[binding];
+      if(uniform.resolved)
+      {
+        uniform.resolved->setUniform(uniform.slot, value);
+      }
+    };
+    for(const auto& [op, enumA, enumB, enumC, target, id, operand] : curPipeline.program)
     {
       switch(op)
       {
         case Pipeline::OpCode::SET_MODEL_MATRIX:
         {
           lg("Set model");
-          this->model = matrixCallback();
+          this->model = curPipeline.matrixCallbacks[operand]();
           break;
         }
         case Pipeline::OpCode::SET_ORTHO_PROJECTION_MATRIX:
         {
           lg("Set ortho projection");
-          this->projection = matrixCallback();
+          this->projection = curPipeline.matrixCallbacks[operand]();
           break;
         }
         case Pipeline::OpCode::SET_PERSP_PROJECTION_MATRIX:
         {
           lg("Set perspective projection");
-          this->projection = matrixCallback();
+          this->projection = curPipeline.matrixCallbacks[operand]();
           break;
         }
         case Pipeline::OpCode::SET_VIEW_MATRIX:
         {
           lg("Set view");
-          this->view = matrixCallback();
+          this->view = curPipeline.matrixCallbacks[operand]();
           break;
         }
         case Pipeline::OpCode::CALCULATE_MVP:
@@ -488,252 +663,217 @@ namespace glr
         case Pipeline::OpCode::SET_CLEAR_COLOR:
         {
           lg("Set color clear value\n");
-          const auto& c = data.varVec4f;
+          const auto c = curPipeline.readData<vec4<float>>(operand);
           glClearColor(c.r(), c.g(), c.b(), c.a());
           break;
         }
         case Pipeline::OpCode::SET_CLEAR_DEPTH:
         {
           lg("Set depth clear value\n");
-          glClearDepth(data.varF);
+          glClearDepth(curPipeline.readData<float>(operand));
           break;
         }
         case Pipeline::OpCode::SET_CLEAR_STENCIL:
         {
           lg("Set stencil clear value\n");
-          glClearStencil(data.varI32);
+          glClearStencil(curPipeline.readData<int32_t>(operand));
           break;
         }
         case Pipeline::OpCode::CLEAR:
         {
           lg("Clear\n");
-          glClear(enumA | enumB | enumC);
+          glClear(operand);
           break;
         }
 
         case Pipeline::OpCode::USE_ATTACH:
         {
-          lg("Use FBO attachment %zu, 0x%04x, 0x%04x, %u\n", id, enumA, enumB, target);
-          asset_repo::fboBindAttachment(id, (GLRAttachment)enumA, (GLRAttachmentType)enumB, target);
+          lg("Use FBO attachment %zu, 0x%04x, 0x%04x, %u\n", ids[id], enumA, enumB, target);
+          asset_repo::fboBindAttachment(ids[id], (GLRAttachment)enumA, (GLRAttachmentType)enumB, target);
           break;
         }
         case Pipeline::OpCode::USE_TEX:
         {
-          auto& tex = curPipeline.currentTexture;
-          if(target >= tex.size() || tex.at(target) == id)
-          {
-            lg("Use texture: already bound\n");
-            continue;
-          }
           lg("Use texture\n");
-          tex.at(target) = id;
-          asset_repo::textureSetBindingTarget(id, target);
-          asset_repo::textureUse(id);
+          asset_repo::textureSetBindingTarget(ids[id], target);
+          asset_repo::textureUse(ids[id]);
           break;
         }
         case Pipeline::OpCode::USE_IMG: //TODO support layered images/levels
         {
-          if(target >= curPipeline.currentTexture.size() || curPipeline.currentTexture.at(target) == id)
-          {
-            lg("Use image: already bound\n");
-            continue;
-          }
           lg("Use image\n");
-          curPipeline.currentTexture.at(target) = id;
-          asset_repo::textureUseAsImage(id, target, (GLRIOMode)enumA, (GLRColorFormat)enumB);
+          asset_repo::textureUseAsImage(ids[id], target, (GLRIOMode)enumA, (GLRColorFormat)enumB);
           break;
         }
         case Pipeline::OpCode::USE_SHADER:
         {
-          if(curPipeline.currentShader == id)
-          {
-            lg("Use shader: already bound\n");
-            continue;
-          }
           lg("Use shader\n");
-          curPipeline.currentShader = id;
-          asset_repo::shaderUse(id);
+          asset_repo::shaderUse(ids[id]);
           break;
         }
         case Pipeline::OpCode::USE_MESH:
         {
-          if(curPipeline.currentMesh == id)
-          {
-            lg("Use mesh: already bound\n");
-            continue;
-          }
           lg("Use mesh\n");
-          curPipeline.currentMesh = id;
-          asset_repo::meshUse(id);
+          asset_repo::meshUse(ids[id]);
           break;
         }
         case Pipeline::OpCode::USE_BACKBUFFER:
         {
           lg("Use backbuffer\n");
-          asset_repo::fboUse(0);
+          stateCache().bindFramebuffer(0);
           break;
         }
         case Pipeline::OpCode::USE_FBO:
         {
-          if(curPipeline.currentFramebuffer == id)
-          {
-            lg("Use framebuffer: already bound\n");
-            continue;
-          }
           lg("Use framebuffer\n");
-          curPipeline.currentFramebuffer = id;
-          asset_repo::fboUse(id);
+          asset_repo::fboUse(ids[id]);
           break;
         }
         case Pipeline::OpCode::USE_PIPELINE:
         {
-          if(curPipeline.currentShaderPipeline == id)
-          {
-            lg("Use shader pipeline: already bound\n");
-            continue;
-          }
           lg("Use shader pipeline\n");
-          curPipeline.currentShaderPipeline = id;
-          asset_repo::shaderPipelineUse(id);
+          asset_repo::shaderPipelineUse(ids[id]);
           break;
         }
 
         case Pipeline::OpCode::SET_UNI_F:
         {
           lg("Set float uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varF);
+          setUniform(target, curPipeline.readData<float>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_U8:
         {
           lg("Set u8 uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varU8);
+          setUniform(target, curPipeline.readData<uint32_t>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_I8:
         {
           lg("Set i8 uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varI8);
+          setUniform(target, curPipeline.readData<int32_t>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_U16:
         {
           lg("Set u16 uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varU16);
+          setUniform(target, curPipeline.readData<uint32_t>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_I16:
         {
           lg("Set i16 uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varI16);
+          setUniform(target, curPipeline.readData<int32_t>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_U32:
         {
           lg("Set u32 uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varU32);
+          setUniform(target, curPipeline.readData<uint32_t>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_I32:
         {
           lg("Set i32 uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varI32);
+          setUniform(target, curPipeline.readData<int32_t>(operand));
           break;
         }
 
         case Pipeline::OpCode::SET_UNI_VEC2U:
         {
           lg("Set vec2u uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varVec2u);
+          setUniform(target, curPipeline.readData<vec2<uint32_t>>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_VEC2I:
         {
           lg("Set vec2i uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varVec2i);
+          setUniform(target, curPipeline.readData<vec2<int32_t>>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_VEC2F:
         {
           lg("Set vec2f uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varVec2f);
+          setUniform(target, curPipeline.readData<vec2<float>>(operand));
           break;
         }
 
         case Pipeline::OpCode::SET_UNI_VEC3U:
         {
           lg("Set vec3u uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varVec3u);
+          setUniform(target, curPipeline.readData<vec3<uint32_t>>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_VEC3I:
         {
           lg("Set vec3i uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varVec3i);
+          setUniform(target, curPipeline.readData<vec3<int32_t>>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_VEC3F:
         {
           lg("Set vec3f uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varVec3f);
+          setUniform(target, curPipeline.readData<vec3<float>>(operand));
           break;
         }
 
         case Pipeline::OpCode::SET_UNI_VEC4U:
         {
           lg("Set vec4u uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varVec4u);
+          setUniform(target, curPipeline.readData<vec4<uint32_t>>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_VEC4I:
         {
           lg("Set vec4i uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varVec4i);
+          setUniform(target, curPipeline.readData<vec4<int32_t>>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_VEC4F:
         {
           lg("Set vec4f uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varVec4f);
+          setUniform(target, curPipeline.readData<vec4<float>>(operand));
           break;
         }
 
         case Pipeline::OpCode::SET_UNI_MAT3F:
         {
           lg("Set mat3x3f uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varMat3f);
+          setUniform(target, curPipeline.readData<mat3x3<float>>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_MAT4F:
         {
           lg("Set mat4x4f uniform\n");
-          asset_repo::shaderSetUniform(id, name, data.varMat4f);
+          setUniform(target, curPipeline.readData<mat4x4<float>>(operand));
           break;
         }
         case Pipeline::OpCode::SET_UNI_MVP:
         {
           lg("Set MVP uniform\n");
-          asset_repo::shaderSetUniform(id, name, this->mvp);
+          setUniform(target, this->mvp);
           break;
         }
 
         case Pipeline::OpCode::SEND_UNIFORMS:
         {
           lg("Send uniforms\n");
-          asset_repo::shaderSendUniforms(id);
+          asset_repo::shaderSendUniforms(ids[id]);
           break;
         }
 
         case Pipeline::OpCode::DRAW:
         {
-          lg("Draw %zu vertices with mode 0x%04x\n", data.varU64, enumA);
-          glDrawArrays((GLenum)enumA, 0, data.varU64);
+          const uint64_t count = curPipeline.readData<uint64_t>(operand);
+          lg("Draw %zu vertices with mode 0x%04x\n", count, enumA);
+          glDrawArrays((GLenum)enumA, 0, (GLsizei)count);
           break;
         }
         case Pipeline::OpCode::DRAW_INDEXED:
         {
-          lg("Draw %zu indices with draw mode 0x%04x, index buffer format 0x%04x\n", data.varU64, enumA, enumB);
-          glDrawElements((GLenum)enumA, data.varU64, (int32_t)enumB, nullptr);
+          const uint64_t count = curPipeline.readData<uint64_t>(operand);
+          lg("Draw %zu indices with draw mode 0x%04x, index buffer format 0x%04x\n", count, enumA, enumB);
+          glDrawElements((GLenum)enumA, (GLsizei)count, (GLenum)enumB, nullptr);
           break;
         }
         case Pipeline::OpCode::DISPATCH_COMPUTE:
@@ -793,31 +933,31 @@ namespace glr
         case Pipeline::OpCode::SET_BLEND:
         {
           lg("Set blend\n");
-          data.varBool ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+          stateCache().setBlend(enumA);
           break;
         }
         case Pipeline::OpCode::SET_BLEND_MODE:
         {
           lg("Set blend modes\n");
-          glBlendFunc((int32_t)enumA, (int32_t)enumB);
+          stateCache().setBlendFunc(enumA, enumB);
           break;
         }
         case Pipeline::OpCode::SET_DEPTH_TEST:
         {
           lg("Set depth testing\n");
-          data.varBool ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+          stateCache().setDepthTest(enumA);
           break;
         }
         case Pipeline::OpCode::SET_CULL_BACKFACE:
         {
           lg("Set backface culling\n");
-          data.varBool ? glEnable(GL_CULL_FACE) : glDisable(GL_CULL_FACE);
+          stateCache().setCullFace(enumA);
           break;
         }
         case Pipeline::OpCode::SET_SCISSOR_TEST:
         {
           lg("Set scissor testing\n");
-          data.varBool ? glEnable(GL_SCISSOR_TEST) : glDisable(GL_SCISSOR_TEST);
+          stateCache().setScissorTest(enumA);
           break;
         }
           
@@ -826,5 +966,6 @@ namespace glr
       }
     }
     lg("\n");
+    this->frameStateStats = stateCache().stats();
   }
 }
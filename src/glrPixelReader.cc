@@ -0,0 +1,198 @@
+#include "glrender/glrPixelReader.hh"
+
+#include <glad/gl.hh>
+
+#include "glrender/glrAssetRepository.hh"
+
+#include <algorithm>
+
+namespace glr
+{
+  constexpr GLbitfield READBACK_STORAGE_FLAGS = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT | GL_CLIENT_STORAGE_BIT;
+  constexpr GLbitfield READBACK_MAP_FLAGS = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  constexpr uint64_t READBACK_WAIT_TIMEOUT = 1000000; //Nanoseconds
+
+  GLenum readbackFormat(const uint8_t channels)
+  {
+    switch(channels)
+    {
+      case 1: return GL_RED;
+      case 2: return GL_RG;
+      case 3: return GL_RGB;
+      default: return GL_RGBA;
+    }
+  }
+
+  PixelReader::PixelReader(const uint32_t framesInFlight)
+  {
+    this->slots.resize(std::max(framesInFlight, 1u));
+  }
+
+  PixelReader::~PixelReader()
+  {
+    for(Slot& slot : this->slots)
+    {
+      glDeleteSync((GLsync)slot.fence);
+      if(slot.buffer != INVALID_HANDLE)
+      {
+        glUnmapNamedBuffer(slot.buffer);
+        glDeleteBuffers(1, &slot.buffer);
+      }
+    }
+  }
+
+  ReadbackHandle PixelReader::readFramebuffer(const uint32_t xPos, const uint32_t yPos, const uint32_t width, const uint32_t height, const uint8_t channels)
+  {
+    uint32_t index = 0;
+    Slot* slot = this->begin(width, height, channels, index);
+    if(!slot)
+    {
+      return 0;
+    }
+    glReadPixels((GLint)xPos, (GLint)yPos, (GLsizei)width, (GLsizei)height, readbackFormat(channels), GL_UNSIGNED_BYTE, nullptr);
+    return this->finish(*slot, index);
+  }
+
+  ReadbackHandle PixelReader::readTexture(const ID texture, const uint8_t channels)
+  {
+    const uint32_t handle = asset_repo::textureGetHandle(texture);
+    if(handle == INVALID_HANDLE)
+    {
+      return 0;
+    }
+
+    int32_t width = 0;
+    int32_t height = 0;
+    glGetTextureLevelParameteriv(handle, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTextureLevelParameteriv(handle, 0, GL_TEXTURE_HEIGHT, &height);
+
+    uint32_t index = 0;
+    Slot* slot = this->begin((uint32_t)width, (uint32_t)height, channels, index);
+    if(!slot)
+    {
+      return 0;
+    }
+    glGetTextureImage(handle, 0, readbackFormat(channels), GL_UNSIGNED_BYTE, (GLsizei)slot->capacity, nullptr);
+    return this->finish(*slot, index);
+  }
+
+  bool PixelReader::isReady(const ReadbackHandle readback)
+  {
+    Slot* slot = this->find(readback);
+    return slot && this->poll(*slot, false);
+  }
+
+  ReadbackView PixelReader::get(const ReadbackHandle readback, const bool wait)
+  {
+    Slot* slot = this->find(readback);
+    if(!slot || !this->poll(*slot, wait))
+    {
+      return {};
+    }
+    return {slot->mapped, slot->width, slot->height, slot->channels};
+  }
+
+  void PixelReader::release(const ReadbackHandle readback)
+  {
+    Slot* slot = this->find(readback);
+    if(!slot)
+    {
+      return;
+    }
+    glDeleteSync((GLsync)slot->fence);
+    slot->fence = nullptr;
+    slot->state = SlotState::FREE;
+    slot->generation = slot->generation == UINT32_MAX ? 1 : slot->generation + 1;
+  }
+
+  PixelReader::Slot* PixelReader::begin(const uint32_t width, const uint32_t height, const uint8_t channels, uint32_t& index)
+  {
+    //Nothing to read, and a slot that was never grown has no buffer to pack into
+    if(width == 0 || height == 0 || channels == 0)
+    {
+      return nullptr;
+    }
+
+    for(index = 0; index < this->slots.size(); index++)
+    {
+      if(this->slots[index].state == SlotState::FREE)
+      {
+        break;
+      }
+    }
+    if(index == this->slots.size())
+    {
+      return nullptr;
+    }
+
+    //Buffer storage is immutable, so a buffer that's too small is replaced, they're only ever grown
+    Slot& slot = this->slots[index];
+    const size_t size = (size_t)width * height * channels;
+    if(size > slot.capacity)
+    {
+      if(slot.buffer != INVALID_HANDLE)
+      {
+        glUnmapNamedBuffer(slot.buffer);
+        glDeleteBuffers(1, &slot.buffer);
+      }
+      glCreateBuffers(1, &slot.buffer);
+      glNamedBufferStorage(slot.buffer, (GLsizeiptr)size, nullptr, READBACK_STORAGE_FLAGS);
+      slot.mapped = (uint8_t*)glMapNamedBufferRange(slot.buffer, 0, (GLsizeiptr)size, READBACK_MAP_FLAGS);
+      slot.capacity = size;
+    }
+
+    slot.width = width;
+    slot.height = height;
+    slot.channels = channels;
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    return &slot;
+  }
+
+  ReadbackHandle PixelReader::finish(Slot& slot, const uint32_t index)
+  {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state = SlotState::PENDING;
+    return (ReadbackHandle)slot.generation << 32 | index;
+  }
+
+  PixelReader::Slot* PixelReader::find(const ReadbackHandle readback)
+  {
+    const uint32_t index = (uint32_t)readback;
+    if(index >= this->slots.size())
+    {
+      return nullptr;
+    }
+    Slot& slot = this->slots[index];
+    if(slot.state == SlotState::FREE || slot.generation != (uint32_t)(readback >> 32))
+    {
+      return nullptr;
+    }
+    return &slot;
+  }
+
+  bool PixelReader::poll(Slot& slot, const bool wait)
+  {
+    if(slot.state == SlotState::READY)
+    {
+      return true;
+    }
+
+    GLenum result = glClientWaitSync((GLsync)slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while(wait && result == GL_TIMEOUT_EXPIRED)
+    {
+      result = glClientWaitSync((GLsync)slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, READBACK_WAIT_TIMEOUT);
+    }
+    if(result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+    {
+      return false;
+    }
+
+    glDeleteSync((GLsync)slot.fence);
+    slot.fence = nullptr;
+    slot.state = SlotState::READY;
+    return true;
+  }
+}
@@ -1,25 +1,54 @@
 #include "glrender/glrRenderList.hh"
-#include "glrender/glrAssetRepository.hh"
+#include "glrender/glrSortKey.hh"
 
 #include <algorithm>
+#include <numeric>
 
 namespace glr
 {
   bool RenderList::renderableComparator(const Renderable& a, const Renderable& b)
   {
-    bool textures = false;
-    bool layers = false;
-    if(a.textureComp && b.textureComp)
+    const uint64_t layerA = a.layerComp ? a.layerComp->layer : 0;
+    const uint64_t layerB = b.layerComp ? b.layerComp->layer : 0;
+    if(layerA != layerB)
     {
-      textures = asset_repo::textureGetHandle(a.textureComp->texture) > asset_repo::textureGetHandle(b.textureComp->texture);
+      return layerA > layerB;
     }
-    if(a.layerComp && b.layerComp)
+    
+    const uint64_t sublayerA = a.layerComp ? a.layerComp->sublayer : 0;
+    const uint64_t sublayerB = b.layerComp ? b.layerComp->sublayer : 0;
+    if(sublayerA != sublayerB)
     {
-      layers = a.layerComp->layer == b.layerComp->layer ? a.layerComp->sublayer > b.layerComp->sublayer : a.layerComp->layer > b.layerComp->layer;
+      return sublayerA > sublayerB;
     }
-    return textures && layers;
+    
+    const ID textureA = a.textureComp ? a.textureComp->texture : INVALID_ID;
+    const ID textureB = b.textureComp ? b.textureComp->texture : INVALID_ID;
+    return textureA < textureB;
   }
   
+  //Order by the full layer and sublayer first, for when some don't fit in a sort key and would be clamped into one
+  //The keys still group what's in the same sublayer by shader, texture and mesh
+  template <typename LayerOf> void sortByFullLayer(const std::vector<uint64_t>& keys, std::vector<uint32_t>& order, LayerOf&& layerOf)
+  {
+    order.resize(keys.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](const uint32_t a, const uint32_t b)
+    {
+      const LayerComp layerA = layerOf(a);
+      const LayerComp layerB = layerOf(b);
+      if(layerA.layer != layerB.layer)
+      {
+        return layerA.layer > layerB.layer;
+      }
+      if(layerA.sublayer != layerB.sublayer)
+      {
+        return layerA.sublayer > layerB.sublayer;
+      }
+      return keys[a] < keys[b];
+    });
+  }
+
   RenderList::~RenderList()
   {
     if(this->shaderPipeline.has_value())
@@ -31,6 +60,7 @@ namespace glr
   RenderList::RenderList(const RenderList& copyFrom)
   {
     this->list = copyFrom.list;
+    this->objects = copyFrom.objects;
     this->shaderPipeline = copyFrom.shaderPipeline;
   }
   
@@ -41,6 +71,7 @@ namespace glr
       return *this;
     }
     this->list = copyFrom.list;
+    this->objects = copyFrom.objects;
     this->shaderPipeline = copyFrom.shaderPipeline;
     return *this;
   }
@@ -49,6 +80,8 @@ namespace glr
   {
     this->list = std::move(moveFrom.list);
     moveFrom.list = {};
+    this->objects = std::move(moveFrom.objects);
+    moveFrom.objects = {};
     this->shaderPipeline = std::move(moveFrom.shaderPipeline);
     moveFrom.shaderPipeline = {};
   }
@@ -62,6 +95,8 @@ namespace glr
     
     this->list = std::move(moveFrom.list);
     moveFrom.list = {};
+    this->objects = std::move(moveFrom.objects);
+    moveFrom.objects = {};
     this->shaderPipeline = std::move(moveFrom.shaderPipeline);
     moveFrom.shaderPipeline = {};
     return *this;
@@ -70,12 +105,14 @@ namespace glr
   RenderList& RenderList::operator +(const RenderList& other)
   {
     this->list.insert(this->list.end(), other.list.begin(), other.list.end());
+    this->objects.append(other.objects);
     return *this;
   }
   
   RenderList& RenderList::operator +=(const RenderList& other)
   {
     this->list.insert(this->list.end(), other.list.begin(), other.list.end());
+    this->objects.append(other.objects);
     return *this;
   }
   
@@ -117,21 +154,90 @@ namespace glr
   void RenderList::clear()
   {
     this->list.clear();
+    this->objects.clear();
   }
   
   bool RenderList::empty() const
   {
-    return this->list.empty();
+    return this->list.empty() && this->objects.empty();
   }
   
   size_t RenderList::size() const
   {
-    return this->list.size();
+    return this->list.size() + this->objects.size();
+  }
+  
+  void RenderList::sort()
+  {
+    const size_t count = this->list.size();
+    const auto layerOf = [this](const size_t i)
+    {
+      const Renderable& entry = this->list[i];
+      return entry.layerComp ? *entry.layerComp : LayerComp{};
+    };
+    this->sortKeys.resize(count);
+    bool fits = true;
+    for(size_t i = 0; i < count; i++)
+    {
+      const Renderable& entry = this->list[i];
+      const LayerComp layer = layerOf(i);
+      fits = fits && sortKeyLayerFits(layer.layer, layer.sublayer);
+      this->sortKeys[i] = makeSortKey(layer.layer,
+                                      layer.sublayer,
+                                      entry.fragVertShaderComp ? entry.fragVertShaderComp->shader : INVALID_ID,
+                                      entry.textureComp ? entry.textureComp->texture : INVALID_ID,
+                                      entry.meshComp ? entry.meshComp->mesh : INVALID_ID);
+    }
+    if(fits)
+    {
+      radixSort(this->sortKeys, this->sortOrder, count >= PARALLEL_SORT_THRESHOLD);
+    }
+    else
+    {
+      sortByFullLayer(this->sortKeys, this->sortOrder, layerOf);
+    }
+    
+    this->sortScratch.clear();
+    this->sortScratch.reserve(count);
+    for(const uint32_t index : this->sortOrder)
+    {
+      this->sortScratch.emplace_back(std::move(this->list[index]));
+    }
+    this->list.swap(this->sortScratch);
+    this->sortScratch.clear();
+    
+    this->sortObjects();
   }
   
   void RenderList::sort(const Comparator& cmp)
   {
-    std::sort(this->list.begin(), this->list.end(), cmp);
+    std::stable_sort(this->list.begin(), this->list.end(), cmp);
+    this->sortObjects();
+  }
+  
+  void RenderList::sortObjects()
+  {
+    const size_t count = this->objects.size();
+    this->sortKeys.resize(count);
+    bool fits = true;
+    for(size_t i = 0; i < count; i++)
+    {
+      const LayerComp& layer = this->objects.layers[i];
+      fits = fits && sortKeyLayerFits(layer.layer, layer.sublayer);
+      this->sortKeys[i] = makeSortKey(layer.layer, layer.sublayer, this->objects.shaders[i], this->objects.textures[i], this->objects.meshes[i]);
+    }
+    if(fits)
+    {
+      radixSort(this->sortKeys, this->sortOrder, count >= PARALLEL_SORT_THRESHOLD);
+    }
+    else
+    {
+      sortByFullLayer(this->sortKeys, this->sortOrder, [this](const size_t i)
+      {
+        return this->objects.layers[i];
+      });
+    }
+    this->objects.permute(this->sortOrder);
   }
   
   void RenderList::reset()
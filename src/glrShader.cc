@@ -1,14 +1,28 @@
 #include "glrender/glrShader.hh"
 
+#include "glrender/glrStateCache.hh"
+
 #include <glad/gl.hh>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 
 namespace glr
 {
+  std::atomic<uint64_t> shaderRevisionCounter = 0;
+  
+  uint64_t shaderRevision()
+  {
+    return shaderRevisionCounter.load(std::memory_order_relaxed);
+  }
+  
   Shader::Shader(const std::string& name, const std::string& vertShader, const std::string& fragShader)
   {
     const uint32_t vertHandle = glCreateShader(GL_VERTEX_SHADER);
     const uint32_t fragHandle = glCreateShader(GL_FRAGMENT_SHADER);
     this->handle = glCreateProgram();
+    shaderRevisionCounter++;
     
     const char* vertSource = vertShader.data();
     const char* fragSource = fragShader.data();
@@ -85,6 +99,7 @@ namespace glr
   {
     const uint32_t compHandle = glCreateShader(GL_COMPUTE_SHADER);
     this->handle = glCreateProgram();
+    shaderRevisionCounter++;
     const char* compSource = compShader.data();
     glShaderSource(compHandle, 1, &compSource, nullptr);
     glCompileShader(compHandle);
@@ -133,7 +148,9 @@ namespace glr
   
   Shader::~Shader()
   {
+    stateCache().forgetProgram(this->handle);
     glDeleteProgram(this->handle);
+    shaderRevisionCounter++;
   }
   
   Shader::Shader(Shader&& moveFrom) noexcept
@@ -147,8 +164,19 @@ namespace glr
     this->uniforms = std::move(moveFrom.uniforms);
     moveFrom.uniforms = {};
     
+    this->uniformSlots = std::move(moveFrom.uniformSlots);
+    moveFrom.uniformSlots = {};
+    
+    this->block = std::move(moveFrom.block);
+    this->blockBinding = moveFrom.blockBinding;
+    moveFrom.blockBinding = INVALID_HANDLE;
+    
+    this->stats = moveFrom.stats;
+    moveFrom.stats = {};
+    
     this->init = true;
     moveFrom.init = false;
+    shaderRevisionCounter++;
   }
   
   Shader& Shader::operator=(Shader&& moveFrom) noexcept
@@ -167,37 +195,151 @@ namespace glr
     this->uniforms = std::move(moveFrom.uniforms);
     moveFrom.uniforms = {};
     
+    this->uniformSlots = std::move(moveFrom.uniformSlots);
+    moveFrom.uniformSlots = {};
+    
+    this->block = std::move(moveFrom.block);
+    this->blockBinding = moveFrom.blockBinding;
+    moveFrom.blockBinding = INVALID_HANDLE;
+    
+    this->stats = moveFrom.stats;
+    moveFrom.stats = {};
+    
     this->init = true;
     moveFrom.init = false;
+    shaderRevisionCounter++;
     
     return *this;
   }
   
   void Shader::use() const
   {
-    glUseProgram(this->handle);
+    stateCache().useProgram(this->handle);
   }
   
-  void makeUniform(const std::string& location, const uint32_t shaderHandle, std::unordered_map<std::string, Shader::Uniform>& uniforms)
+  uint32_t Shader::uniformSlot(const std::string& name)
   {
-    if(!uniforms.contains(location))
+    const auto [it, inserted] = this->uniformSlots.try_emplace(name, (uint32_t)this->uniforms.size());
+    if(inserted)
     {
-      uniforms[location] = {};
-      uniforms.at(location).handle = glGetUniformLocation(shaderHandle, location.data());
+      this->uniforms.emplace_back(glGetUniformLocation(this->handle, name.data()), UniformValue{}, this->block.memberIndex(name));
     }
+    return it->second;
+  }
+
+  bool sameUniformValue(const Shader::UniformValue& a, const Shader::UniformValue& b)
+  {
+    if(a.index() != b.index())
+    {
+      return false;
+    }
+    return std::visit([&](const auto& val)
+    {
+      using T = std::decay_t<decltype(val)>;
+      return std::memcmp(&val, &std::get<T>(b), sizeof(T)) == 0;
+    }, a);
   }
 
   void Shader::setUniform(const std::string& name, UniformValue val)
   {
-    makeUniform(name, this->handle, this->uniforms);
-    this->uniforms.at(name).val = std::move(val);
+    this->setUniform(this->uniformSlot(name), std::move(val));
+  }
+
+  void Shader::setUniform(const uint32_t slot, UniformValue val)
+  {
+    if(slot >= this->uniforms.size())
+    {
+      return;
+    }
+    Uniform& uniform = this->uniforms[slot];
+    if(uniform.blockMember >= 0)
+    {
+      this->block.set((uint32_t)uniform.blockMember, val);
+      return;
+    }
+    if(sameUniformValue(uniform.val, val))
+    {
+      return;
+    }
+    uniform.val = std::move(val);
+    uniform.dirty = true;
+  }
+
+  bool Shader::useUniformBlock(const std::string& blockName, const uint32_t binding, const GLRBlockType type)
+  {
+    const GLenum blockInterface = type == GLRBlockType::UNIFORM ? GL_UNIFORM_BLOCK : GL_SHADER_STORAGE_BLOCK;
+    const GLenum memberInterface = type == GLRBlockType::UNIFORM ? GL_UNIFORM : GL_BUFFER_VARIABLE;
+    const uint32_t index = glGetProgramResourceIndex(this->handle, blockInterface, blockName.data());
+    if(index == GL_INVALID_INDEX)
+    {
+      return false;
+    }
+    
+    constexpr std::array<GLenum, 2> blockProps{GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES};
+    std::array<int32_t, 2> blockInfo{};
+    glGetProgramResourceiv(this->handle, blockInterface, index, (GLsizei)blockProps.size(), blockProps.data(), (GLsizei)blockInfo.size(), nullptr, blockInfo.data());
+    const auto& [blockSize, memberCount] = blockInfo;
+    
+    std::vector<int32_t> variables(memberCount);
+    constexpr GLenum activeVariables = GL_ACTIVE_VARIABLES;
+    glGetProgramResourceiv(this->handle, blockInterface, index, 1, &activeVariables, (GLsizei)variables.size(), nullptr, variables.data());
+    
+    UniformBlock newBlock(type);
+    newBlock.resize(blockSize);
+    for(const int32_t variable : variables)
+    {
+      constexpr std::array<GLenum, 3> memberProps{GL_NAME_LENGTH, GL_OFFSET, GL_MATRIX_STRIDE};
+      std::array<int32_t, 3> memberInfo{};
+      glGetProgramResourceiv(this->handle, memberInterface, variable, (GLsizei)memberProps.size(), memberProps.data(), (GLsizei)memberInfo.size(), nullptr, memberInfo.data());
+      const auto& [nameLength, offset, matrixStride] = memberInfo;
+      
+      std::string name(nameLength, '\0');
+      glGetProgramResourceName(this->handle, memberInterface, variable, nameLength, nullptr, name.data());
+      name.resize(name.find('\0') == std::string::npos ? name.size() : name.find('\0'));
+      newBlock.addMember(name, offset, std::max(matrixStride, 0));
+    }
+    
+    type == GLRBlockType::UNIFORM ? glUniformBlockBinding(this->handle, index, binding) : glShaderStorageBlockBinding(this->handle, index, binding);
+    this->block = std::move(newBlock);
+    this->blockBinding = binding;
+    
+    //Uniforms that were already set on their own move into the block
+    for(const auto& [name, slot] : this->uniformSlots)
+    {
+      Uniform& uniform = this->uniforms[slot];
+      uniform.blockMember = this->block.memberIndex(name);
+      if(uniform.blockMember >= 0)
+      {
+        this->block.set((uint32_t)uniform.blockMember, uniform.val);
+        uniform.dirty = false;
+      }
+    }
+    return true;
   }
 
   void Shader::sendUniforms() const
   {
-    for(const auto& pair : this->uniforms)
+    if(this->blockBinding != INVALID_HANDLE)
     {
-      const auto& [handle, val] = pair.second;
+      this->block.isDirty() ? this->stats.sent++ : this->stats.skipped++;
+      this->block.upload();
+      this->block.bind(this->blockBinding);
+    }
+    
+    for(const auto& [handle, val, blockMember, dirty] : this->uniforms)
+    {
+      if(blockMember >= 0)
+      {
+        continue;
+      }
+      if(!dirty)
+      {
+        this->stats.skipped++;
+        continue;
+      }
+      dirty = false;
+      this->stats.sent++;
+      
       if(std::holds_alternative<float>(val))
       {
         glProgramUniform1f(this->handle, handle, std::get<float>(val));
@@ -210,14 +352,38 @@ namespace glr
       {
         glProgramUniform1ui(this->handle, handle, std::get<uint32_t>(val));
       }
+      else if(std::holds_alternative<vec2<uint32_t>>(val))
+      {
+        glProgramUniform2uiv(this->handle, handle, 1, std::get<vec2<uint32_t>>(val).data);
+      }
+      else if(std::holds_alternative<vec2<int32_t>>(val))
+      {
+        glProgramUniform2iv(this->handle, handle, 1, std::get<vec2<int32_t>>(val).data);
+      }
       else if(std::holds_alternative<vec2<float>>(val))
       {
         glProgramUniform2fv(this->handle, handle, 1, std::get<vec2<float>>(val).data);
       }
+      else if(std::holds_alternative<vec3<uint32_t>>(val))
+      {
+        glProgramUniform3uiv(this->handle, handle, 1, std::get<vec3<uint32_t>>(val).data);
+      }
+      else if(std::holds_alternative<vec3<int32_t>>(val))
+      {
+        glProgramUniform3iv(this->handle, handle, 1, std::get<vec3<int32_t>>(val).data);
+      }
       else if(std::holds_alternative<vec3<float>>(val))
       {
         glProgramUniform3fv(this->handle, handle, 1, std::get<vec3<float>>(val).data);
       }
+      else if(std::holds_alternative<vec4<uint32_t>>(val))
+      {
+        glProgramUniform4uiv(this->handle, handle, 1, std::get<vec4<uint32_t>>(val).data);
+      }
+      else if(std::holds_alternative<vec4<int32_t>>(val))
+      {
+        glProgramUniform4iv(this->handle, handle, 1, std::get<vec4<int32_t>>(val).data);
+      }
       else if(std::holds_alternative<vec4<float>>(val))
       {
         glProgramUniform4fv(this->handle, handle, 1, std::get<vec4<float>>(val).data);
@@ -233,6 +399,16 @@ namespace glr
     }
   }
   
+  const Shader::UniformStats& Shader::uniformStats() const
+  {
+    return this->stats;
+  }
+  
+  void Shader::resetUniformStats()
+  {
+    this->stats = {};
+  }
+  
   bool Shader::isValid() const
   {
     return this->init && this->handle != INVALID_HANDLE;
@@ -245,9 +421,14 @@ namespace glr
   
   void Shader::reset()
   {
+    stateCache().forgetProgram(this->handle);
     glDeleteProgram(this->handle);
     this->handle = INVALID_HANDLE;
     this->uniforms = {};
+    this->uniformSlots = {};
+    this->block = {};
+    this->blockBinding = INVALID_HANDLE;
     this->init = false;
+    shaderRevisionCounter++;
   }
 }
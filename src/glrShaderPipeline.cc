@@ -1,5 +1,7 @@
 #include "glrender/glrShaderPipeline.hh"
 
+#include "glrender/glrStateCache.hh"
+
 #include "glad/gl.hh"
 
 namespace glr
@@ -22,6 +24,7 @@ namespace glr
 
   ShaderPipeline::~ShaderPipeline()
   {
+    stateCache().forgetProgramPipeline(this->handle);
     glDeleteProgramPipelines(1, &this->handle);
   }
   
@@ -109,6 +112,7 @@ namespace glr
   
   void ShaderPipeline::reset()
   {
+    stateCache().forgetProgramPipeline(this->handle);
     glDeleteProgramPipelines(1, &this->handle);
     this->handle = INVALID_HANDLE;
     this->shaders.clear();
@@ -117,8 +121,8 @@ namespace glr
 
   void ShaderPipeline::use() const
   {
-    glUseProgram(0);
-    glBindProgramPipeline(this->handle);
+    stateCache().useProgram(0);
+    stateCache().bindProgramPipeline(this->handle);
   }
   
   void ShaderPipeline::sendUniforms() const
@@ -0,0 +1,182 @@
+#include "glrender/glrSortKey.hh"
+#include "glrender/glrWorkerPool.hh"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+namespace glr
+{
+  constexpr uint32_t RADIX_BITS = 8;
+  constexpr uint32_t RADIX_BUCKETS = 1 << RADIX_BITS;
+  constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+  constexpr uint32_t MAX_SORT_THREADS = 8;
+
+  using RadixHistogram = std::array<uint32_t, RADIX_BUCKETS>;
+
+  //Reused between sorts so sorting every frame doesn't allocate
+  thread_local std::vector<uint64_t> radixKeysA{};
+  thread_local std::vector<uint64_t> radixKeysB{};
+  thread_local std::vector<uint32_t> radixOrder{};
+
+  uint64_t packSortKeyField(const uint64_t value, const uint32_t bits)
+  {
+    return value & ((1ull << bits) - 1);
+  }
+
+  uint64_t packSortKeyLayer(const uint64_t value, const uint32_t bits)
+  {
+    //Higher layers sort first, so store the distance from the top of the range
+    const uint64_t max = (1ull << bits) - 1;
+    return max - std::min(value, max);
+  }
+
+  bool sortKeyLayerFits(const uint64_t layer, const uint64_t sublayer)
+  {
+    return layer < (1ull << SORT_KEY_LAYER_BITS) && sublayer < (1ull << SORT_KEY_SUBLAYER_BITS);
+  }
+
+  uint64_t makeSortKey(const uint64_t layer, const uint64_t sublayer, const ID shader, const ID texture, const ID mesh)
+  {
+    uint64_t out = packSortKeyLayer(layer, SORT_KEY_LAYER_BITS);
+    out = out << SORT_KEY_SUBLAYER_BITS | packSortKeyLayer(sublayer, SORT_KEY_SUBLAYER_BITS);
+    out = out << SORT_KEY_SHADER_BITS | packSortKeyField(shader, SORT_KEY_SHADER_BITS);
+    out = out << SORT_KEY_TEXTURE_BITS | packSortKeyField(texture, SORT_KEY_TEXTURE_BITS);
+    out = out << SORT_KEY_MESH_BITS | packSortKeyField(mesh, SORT_KEY_MESH_BITS);
+    return out;
+  }
+
+  void radixSortSerial(const size_t n, std::vector<uint32_t>& order)
+  {
+    //Count every digit of every pass in one read over the keys
+    std::array<RadixHistogram, RADIX_PASSES> histograms{};
+    for(size_t i = 0; i < n; i++)
+    {
+      const uint64_t key = radixKeysA[i];
+      for(uint32_t pass = 0; pass < RADIX_PASSES; pass++)
+      {
+        histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+      }
+    }
+
+    uint64_t* srcKeys = radixKeysA.data();
+    uint64_t* dstKeys = radixKeysB.data();
+    uint32_t* srcOrder = order.data();
+    uint32_t* dstOrder = radixOrder.data();
+    for(uint32_t pass = 0; pass < RADIX_PASSES; pass++)
+    {
+      const uint32_t shift = pass * RADIX_BITS;
+      const RadixHistogram& histogram = histograms[pass];
+
+      //Every key has the same digit, this pass wouldn't move anything
+      if(histogram[(srcKeys[0] >> shift) & (RADIX_BUCKETS - 1)] == n)
+      {
+        continue;
+      }
+
+      RadixHistogram offsets{};
+      std::exclusive_scan(histogram.begin(), histogram.end(), offsets.begin(), 0u);
+      for(size_t i = 0; i < n; i++)
+      {
+        const uint32_t position = offsets[(srcKeys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+        dstKeys[position] = srcKeys[i];
+        dstOrder[position] = srcOrder[i];
+      }
+      std::swap(srcKeys, dstKeys);
+      std::swap(srcOrder, dstOrder);
+    }
+
+    if(srcOrder != order.data())
+    {
+      std::copy_n(srcOrder, n, order.data());
+    }
+  }
+
+  void radixSortParallel(const size_t n, std::vector<uint32_t>& order)
+  {
+    WorkerPool& pool = workerPool();
+    const uint32_t chunks = std::min(pool.size(), MAX_SORT_THREADS);
+    std::array<RadixHistogram, MAX_SORT_THREADS> histograms{};
+
+    uint64_t* srcKeys = radixKeysA.data();
+    uint64_t* dstKeys = radixKeysB.data();
+    uint32_t* srcOrder = order.data();
+    uint32_t* dstOrder = radixOrder.data();
+    for(uint32_t pass = 0; pass < RADIX_PASSES; pass++)
+    {
+      const uint32_t shift = pass * RADIX_BITS;
+      pool.run(chunks, [&](const size_t chunk)
+      {
+        RadixHistogram& histogram = histograms[chunk];
+        histogram.fill(0);
+        for(size_t i = n * chunk / chunks; i < n * (chunk + 1) / chunks; i++)
+        {
+          histogram[(srcKeys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+        }
+      });
+
+      //Turn the per-chunk counts into per-chunk scatter offsets, chunks are scattered in order so the sort stays stable
+      uint32_t running = 0;
+      bool skipPass = false;
+      for(uint32_t bucket = 0; bucket < RADIX_BUCKETS; bucket++)
+      {
+        uint32_t total = 0;
+        for(uint32_t chunk = 0; chunk < chunks; chunk++)
+        {
+          const uint32_t count = histograms[chunk][bucket];
+          histograms[chunk][bucket] = running;
+          running += count;
+          total += count;
+        }
+        skipPass = skipPass || total == n;
+      }
+      //Every key has the same digit, this pass wouldn't move anything
+      if(skipPass)
+      {
+        continue;
+      }
+
+      pool.run(chunks, [&](const size_t chunk)
+      {
+        RadixHistogram& offsets = histograms[chunk];
+        for(size_t i = n * chunk / chunks; i < n * (chunk + 1) / chunks; i++)
+        {
+          const uint32_t position = offsets[(srcKeys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+          dstKeys[position] = srcKeys[i];
+          dstOrder[position] = srcOrder[i];
+        }
+      });
+      std::swap(srcKeys, dstKeys);
+      std::swap(srcOrder, dstOrder);
+    }
+
+    if(srcOrder != order.data())
+    {
+      std::copy_n(srcOrder, n, order.data());
+    }
+  }
+
+  void radixSort(const std::vector<uint64_t>& keys, std::vector<uint32_t>& order, const bool parallel)
+  {
+    const size_t n = keys.size();
+    order.resize(n);
+    std::iota(order.begin(), order.end(), 0u);
+    if(n < 2)
+    {
+      return;
+    }
+
+    radixKeysA.assign(keys.begin(), keys.end());
+    radixKeysB.resize(n);
+    radixOrder.resize(n);
+
+    if(parallel && workerPool().size() > 1)
+    {
+      radixSortParallel(n, order);
+    }
+    else
+    {
+      radixSortSerial(n, order);
+    }
+  }
+}
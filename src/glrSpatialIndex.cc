@@ -0,0 +1,528 @@
+#include "glrender/glrSpatialIndex.hh"
+
+#include "glrender/glrAssetRepository.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace glr
+{
+  Bounds unite(const Bounds& a, const Bounds& b)
+  {
+    return {{std::min(a.min.x(), b.min.x()), std::min(a.min.y(), b.min.y()), std::min(a.min.z(), b.min.z())},
+            {std::max(a.max.x(), b.max.x()), std::max(a.max.y(), b.max.y()), std::max(a.max.z(), b.max.z())}};
+  }
+
+  bool contains(const Bounds& outer, const Bounds& inner)
+  {
+    return outer.min.x() <= inner.min.x() && outer.min.y() <= inner.min.y() && outer.min.z() <= inner.min.z() &&
+           outer.max.x() >= inner.max.x() && outer.max.y() >= inner.max.y() && outer.max.z() >= inner.max.z();
+  }
+
+  //Half the surface area, the cost of a node is how likely a query is to have to visit it
+  float area(const Bounds& bounds)
+  {
+    const float x = bounds.max.x() - bounds.min.x();
+    const float y = bounds.max.y() - bounds.min.y();
+    const float z = bounds.max.z() - bounds.min.z();
+    return x * y + y * z + z * x;
+  }
+
+  bool boundsOverlap(const Bounds& a, const Bounds& b)
+  {
+    return a.min.x() <= b.max.x() && a.max.x() >= b.min.x() &&
+           a.min.y() <= b.max.y() && a.max.y() >= b.min.y() &&
+           a.min.z() <= b.max.z() && a.max.z() >= b.min.z();
+  }
+
+  float objectRadius(const TransformComp& transform, const ID mesh)
+  {
+    const float scale = std::max({std::abs(transform.scale.x()), std::abs(transform.scale.y()), std::abs(transform.scale.z())});
+    return asset_repo::meshGetBoundingRadius(mesh) * scale;
+  }
+
+  Bounds objectBounds(const TransformComp& transform, const ID mesh)
+  {
+    const float radius = objectRadius(transform, mesh);
+    const vec3<float>& pos = transform.pos;
+    return {{pos.x() - radius, pos.y() - radius, pos.z() - radius}, {pos.x() + radius, pos.y() + radius, pos.z() + radius}};
+  }
+
+  //===UniformGrid=========================================================================
+  uint64_t cellKey(const int32_t x, const int32_t y)
+  {
+    return (uint64_t)(uint32_t)x << 32 | (uint32_t)y;
+  }
+
+  //Worked out in 64 bits, the range of unbounded boxes spans more cells than fit in an int32_t
+  uint64_t cellCount(const int32_t minX, const int32_t minY, const int32_t maxX, const int32_t maxY)
+  {
+    return (uint64_t)((int64_t)maxX - (int64_t)minX + 1) * (uint64_t)((int64_t)maxY - (int64_t)minY + 1);
+  }
+
+  UniformGrid::UniformGrid(const float cellSize)
+  {
+    this->cellSize = cellSize > 0.0f ? cellSize : 1.0f;
+  }
+
+  void UniformGrid::insert(const ID handle, const Bounds& bounds)
+  {
+    if(this->entries.contains(handle))
+    {
+      this->update(handle, bounds);
+      return;
+    }
+    Entry& entry = this->entries[handle];
+    entry.bounds = bounds;
+    entry.cells = this->placementOf(bounds);
+    this->addToCells(handle, entry.cells);
+  }
+
+  void UniformGrid::update(const ID handle, const Bounds& bounds)
+  {
+    const auto it = this->entries.find(handle);
+    if(it == this->entries.end())
+    {
+      return;
+    }
+    Entry& entry = it->second;
+    entry.bounds = bounds;
+    const CellRange cells = this->placementOf(bounds);
+    if(cells == entry.cells)
+    {
+      return;
+    }
+    this->removeFromCells(handle, entry.cells);
+    this->addToCells(handle, cells);
+    entry.cells = cells;
+  }
+
+  void UniformGrid::remove(const ID handle)
+  {
+    const auto it = this->entries.find(handle);
+    if(it == this->entries.end())
+    {
+      return;
+    }
+    this->removeFromCells(handle, it->second.cells);
+    this->entries.erase(it);
+  }
+
+  void UniformGrid::clear()
+  {
+    this->cells.clear();
+    this->oversized.clear();
+    this->entries.clear();
+  }
+
+  void UniformGrid::query(const Bounds& bounds, std::vector<ID>& out) const
+  {
+    this->queryStamp++;
+    const auto visit = [&](const std::vector<ID>& cell)
+    {
+      for(const ID handle : cell)
+      {
+        const Entry& entry = this->entries.at(handle);
+        if(entry.stamp != this->queryStamp && boundsOverlap(entry.bounds, bounds))
+        {
+          entry.stamp = this->queryStamp;
+          out.emplace_back(handle);
+        }
+      }
+    };
+
+    visit(this->oversized);
+
+    //Queries much bigger than the occupied part of the grid walk the occupied cells instead
+    const CellRange range = this->cellsOf(bounds);
+    const uint64_t covered = cellCount(range.minX, range.minY, range.maxX, range.maxY);
+    if(covered > this->cells.size())
+    {
+      for(const auto& [key, cell] : this->cells)
+      {
+        visit(cell);
+      }
+      return;
+    }
+    for(int32_t y = range.minY; y <= range.maxY; y++)
+    {
+      for(int32_t x = range.minX; x <= range.maxX; x++)
+      {
+        const auto cell = this->cells.find(cellKey(x, y));
+        if(cell != this->cells.end())
+        {
+          visit(cell->second);
+        }
+      }
+    }
+  }
+
+  std::unique_ptr<SpatialIndex> UniformGrid::clone() const
+  {
+    return std::make_unique<UniformGrid>(*this);
+  }
+
+  UniformGrid::CellRange UniformGrid::cellsOf(const Bounds& bounds) const
+  {
+    //Clamped so huge or infinite bounds still give a usable range
+    constexpr float limit = 1 << 30;
+    const auto cell = [&](const float value)
+    {
+      return (int32_t)std::floor(std::clamp(value / this->cellSize, -limit, limit));
+    };
+    return {cell(bounds.min.x()), cell(bounds.min.y()), cell(bounds.max.x()), cell(bounds.max.y())};
+  }
+
+  UniformGrid::CellRange UniformGrid::placementOf(const Bounds& bounds) const
+  {
+    //Objects covering too many cells aren't put in any, they'd take longer to add and move than to test on every query
+    const CellRange cells = this->cellsOf(bounds);
+    if(cellCount(cells.minX, cells.minY, cells.maxX, cells.maxY) > MAX_OBJECT_CELLS)
+    {
+      return {};
+    }
+    return cells;
+  }
+
+  void UniformGrid::addToCells(const ID handle, const CellRange& cells)
+  {
+    if(cells == CellRange{})
+    {
+      this->oversized.emplace_back(handle);
+      return;
+    }
+    for(int32_t y = cells.minY; y <= cells.maxY; y++)
+    {
+      for(int32_t x = cells.minX; x <= cells.maxX; x++)
+      {
+        this->cells[cellKey(x, y)].emplace_back(handle);
+      }
+    }
+  }
+
+  void UniformGrid::removeFromCells(const ID handle, const CellRange& cells)
+  {
+    if(cells == CellRange{})
+    {
+      const auto found = std::ranges::find(this->oversized, handle);
+      if(found != this->oversized.end())
+      {
+        *found = this->oversized.back();
+        this->oversized.pop_back();
+      }
+      return;
+    }
+    for(int32_t y = cells.minY; y <= cells.maxY; y++)
+    {
+      for(int32_t x = cells.minX; x <= cells.maxX; x++)
+      {
+        const auto it = this->cells.find(cellKey(x, y));
+        if(it == this->cells.end())
+        {
+          continue;
+        }
+        std::vector<ID>& cell = it->second;
+        const auto found = std::ranges::find(cell, handle);
+        if(found != cell.end())
+        {
+          *found = cell.back();
+          cell.pop_back();
+        }
+        if(cell.empty())
+        {
+          this->cells.erase(it);
+        }
+      }
+    }
+  }
+
+  //===BoundingVolumeHierarchy=============================================================
+  BoundingVolumeHierarchy::BoundingVolumeHierarchy(const float margin)
+  {
+    this->margin = std::max(margin, 0.0f);
+  }
+
+  void BoundingVolumeHierarchy::insert(const ID handle, const Bounds& bounds)
+  {
+    if(this->leaves.contains(handle))
+    {
+      this->update(handle, bounds);
+      return;
+    }
+    const int32_t leaf = this->allocateNode();
+    Node& node = this->nodes[leaf];
+    node.handle = handle;
+    node.height = 0;
+    node.bounds = {{bounds.min.x() - this->margin, bounds.min.y() - this->margin, bounds.min.z() - this->margin},
+                   {bounds.max.x() + this->margin, bounds.max.y() + this->margin, bounds.max.z() + this->margin}};
+    this->insertLeaf(leaf);
+    this->leaves[handle] = leaf;
+  }
+
+  void BoundingVolumeHierarchy::update(const ID handle, const Bounds& bounds)
+  {
+    const auto it = this->leaves.find(handle);
+    if(it == this->leaves.end())
+    {
+      return;
+    }
+
+    //Still inside its margin, nothing to do
+    const int32_t leaf = it->second;
+    if(contains(this->nodes[leaf].bounds, bounds))
+    {
+      return;
+    }
+    this->removeLeaf(leaf);
+    this->nodes[leaf].bounds = {{bounds.min.x() - this->margin, bounds.min.y() - this->margin, bounds.min.z() - this->margin},
+                                {bounds.max.x() + this->margin, bounds.max.y() + this->margin, bounds.max.z() + this->margin}};
+    this->insertLeaf(leaf);
+  }
+
+  void BoundingVolumeHierarchy::remove(const ID handle)
+  {
+    const auto it = this->leaves.find(handle);
+    if(it == this->leaves.end())
+    {
+      return;
+    }
+    this->removeLeaf(it->second);
+    this->freeNode(it->second);
+    this->leaves.erase(it);
+  }
+
+  void BoundingVolumeHierarchy::clear()
+  {
+    this->nodes.clear();
+    this->leaves.clear();
+    this->root = NONE;
+    this->freeList = NONE;
+  }
+
+  void BoundingVolumeHierarchy::query(const Bounds& bounds, std::vector<ID>& out) const
+  {
+    if(this->root == NONE)
+    {
+      return;
+    }
+    this->stack.clear();
+    this->stack.emplace_back(this->root);
+    while(!this->stack.empty())
+    {
+      const Node& node = this->nodes[this->stack.back()];
+      this->stack.pop_back();
+      if(!boundsOverlap(node.bounds, bounds))
+      {
+        continue;
+      }
+      if(node.isLeaf())
+      {
+        out.emplace_back(node.handle);
+        continue;
+      }
+      this->stack.emplace_back(node.left);
+      this->stack.emplace_back(node.right);
+    }
+  }
+
+  std::unique_ptr<SpatialIndex> BoundingVolumeHierarchy::clone() const
+  {
+    return std::make_unique<BoundingVolumeHierarchy>(*this);
+  }
+
+  int32_t BoundingVolumeHierarchy::allocateNode()
+  {
+    if(this->freeList == NONE)
+    {
+      this->nodes.emplace_back();
+      return (int32_t)this->nodes.size() - 1;
+    }
+    const int32_t node = this->freeList;
+    this->freeList = this->nodes[node].parent;
+    this->nodes[node] = {};
+    return node;
+  }
+
+  void BoundingVolumeHierarchy::freeNode(const int32_t node)
+  {
+    this->nodes[node] = {};
+    this->nodes[node].height = -1;
+    this->nodes[node].parent = this->freeList;
+    this->freeList = node;
+  }
+
+  void BoundingVolumeHierarchy::insertLeaf(const int32_t leaf)
+  {
+    if(this->root == NONE)
+    {
+      this->root = leaf;
+      this->nodes[leaf].parent = NONE;
+      return;
+    }
+
+    //Walk down to the sibling that grows the tree's total area the least
+    const Bounds leafBounds = this->nodes[leaf].bounds;
+    int32_t index = this->root;
+    while(!this->nodes[index].isLeaf())
+    {
+      const Node& node = this->nodes[index];
+      const float combinedArea = area(unite(node.bounds, leafBounds));
+      const float cost = 2.0f * combinedArea;
+      const float inheritance = 2.0f * (combinedArea - area(node.bounds));
+      const auto childCost = [&](const int32_t child)
+      {
+        const Bounds& childBounds = this->nodes[child].bounds;
+        const float united = area(unite(childBounds, leafBounds));
+        return (this->nodes[child].isLeaf() ? united : united - area(childBounds)) + inheritance;
+      };
+      const float leftCost = childCost(node.left);
+      const float rightCost = childCost(node.right);
+      if(cost < leftCost && cost < rightCost)
+      {
+        break;
+      }
+      index = leftCost < rightCost ? node.left : node.right;
+    }
+
+    //Give the sibling and the new leaf a new parent in the sibling's place
+    const int32_t sibling = index;
+    const int32_t oldParent = this->nodes[sibling].parent;
+    const int32_t newParent = this->allocateNode();
+    Node& parent = this->nodes[newParent];
+    parent.parent = oldParent;
+    parent.bounds = unite(leafBounds, this->nodes[sibling].bounds);
+    parent.height = this->nodes[sibling].height + 1;
+    parent.left = sibling;
+    parent.right = leaf;
+    if(oldParent != NONE)
+    {
+      this->replaceChild(oldParent, sibling, newParent);
+    }
+    else
+    {
+      this->root = newParent;
+    }
+    this->nodes[sibling].parent = newParent;
+    this->nodes[leaf].parent = newParent;
+
+    this->refitFrom(newParent);
+  }
+
+  void BoundingVolumeHierarchy::removeLeaf(const int32_t leaf)
+  {
+    if(leaf == this->root)
+    {
+      this->root = NONE;
+      return;
+    }
+
+    //The leaf's sibling takes its parent's place
+    const int32_t parent = this->nodes[leaf].parent;
+    const int32_t grandParent = this->nodes[parent].parent;
+    const int32_t sibling = this->nodes[parent].left == leaf ? this->nodes[parent].right : this->nodes[parent].left;
+    if(grandParent != NONE)
+    {
+      this->replaceChild(grandParent, parent, sibling);
+      this->nodes[sibling].parent = grandParent;
+      this->freeNode(parent);
+      this->refitFrom(grandParent);
+    }
+    else
+    {
+      this->root = sibling;
+      this->nodes[sibling].parent = NONE;
+      this->freeNode(parent);
+    }
+  }
+
+  void BoundingVolumeHierarchy::refitFrom(int32_t node)
+  {
+    while(node != NONE)
+    {
+      node = this->balance(node);
+      Node& current = this->nodes[node];
+      const Node& left = this->nodes[current.left];
+      const Node& right = this->nodes[current.right];
+      current.height = 1 + std::max(left.height, right.height);
+      current.bounds = unite(left.bounds, right.bounds);
+      node = current.parent;
+    }
+  }
+
+  void BoundingVolumeHierarchy::replaceChild(const int32_t parent, const int32_t oldChild, const int32_t newChild)
+  {
+    if(this->nodes[parent].left == oldChild)
+    {
+      this->nodes[parent].left = newChild;
+    }
+    else
+    {
+      this->nodes[parent].right = newChild;
+    }
+  }
+
+  int32_t BoundingVolumeHierarchy::balance(const int32_t indexA)
+  {
+    Node& a = this->nodes[indexA];
+    if(a.isLeaf() || a.height < 2)
+    {
+      return indexA;
+    }
+
+    //Rotate the taller child up when the children's heights differ by more than one
+    const int32_t indexB = a.left;
+    const int32_t indexC = a.right;
+    Node& b = this->nodes[indexB];
+    Node& c = this->nodes[indexC];
+    const int32_t difference = c.height - b.height;
+    if(difference == 0 || std::abs(difference) == 1)
+    {
+      return indexA;
+    }
+
+    const bool rotateRight = difference > 1;
+    const int32_t indexUp = rotateRight ? indexC : indexB;
+    const int32_t indexStay = rotateRight ? indexB : indexC;
+    Node& up = this->nodes[indexUp];
+    const Node& stay = this->nodes[indexStay];
+    const int32_t indexF = up.left;
+    const int32_t indexG = up.right;
+    Node& f = this->nodes[indexF];
+    Node& g = this->nodes[indexG];
+
+    up.left = indexA;
+    up.parent = a.parent;
+    a.parent = indexUp;
+    if(up.parent != NONE)
+    {
+      this->replaceChild(up.parent, indexA, indexUp);
+    }
+    else
+    {
+      this->root = indexUp;
+    }
+
+    //The taller grandchild stays with the node that moved up, the other one moves down to a
+    const bool keepF = f.height > g.height;
+    const int32_t indexKeep = keepF ? indexF : indexG;
+    const int32_t indexMove = keepF ? indexG : indexF;
+    up.right = indexKeep;
+    if(rotateRight)
+    {
+      a.right = indexMove;
+    }
+    else
+    {
+      a.left = indexMove;
+    }
+    this->nodes[indexMove].parent = indexA;
+
+    const Node& moved = this->nodes[indexMove];
+    const Node& kept = this->nodes[indexKeep];
+    a.bounds = unite(stay.bounds, moved.bounds);
+    a.height = 1 + std::max(stay.height, moved.height);
+    up.bounds = unite(a.bounds, kept.bounds);
+    up.height = 1 + std::max(a.height, kept.height);
+    return indexUp;
+  }
+}
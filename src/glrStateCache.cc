@@ -0,0 +1,234 @@
+#include "glrender/glrStateCache.hh"
+
+#include <glad/gl.hh>
+
+#include <algorithm>
+
+namespace glr
+{
+  StateCache& stateCache()
+  {
+    //Never destroyed, assets in the asset repository still forget their handles during static destruction
+    static StateCache* cache = new StateCache();
+    return *cache;
+  }
+
+  bool StateCache::changed(const bool same)
+  {
+    if(same)
+    {
+      this->counters.filtered++;
+      return false;
+    }
+    this->counters.issued++;
+    return true;
+  }
+
+  void StateCache::setCapability(uint8_t& current, const uint32_t capability, const bool enabled)
+  {
+    if(!this->changed(current == (uint8_t)enabled))
+    {
+      return;
+    }
+    current = (uint8_t)enabled;
+    enabled ? glEnable(capability) : glDisable(capability);
+  }
+
+  void StateCache::useProgram(const uint32_t program)
+  {
+    if(!this->changed(this->currentProgram == program))
+    {
+      return;
+    }
+    this->currentProgram = program;
+    glUseProgram(program);
+  }
+
+  void StateCache::bindProgramPipeline(const uint32_t pipeline)
+  {
+    if(!this->changed(this->currentProgramPipeline == pipeline))
+    {
+      return;
+    }
+    this->currentProgramPipeline = pipeline;
+    glBindProgramPipeline(pipeline);
+  }
+
+  void StateCache::bindVertexArray(const uint32_t vertexArray)
+  {
+    if(!this->changed(this->currentVertexArray == vertexArray))
+    {
+      return;
+    }
+    this->currentVertexArray = vertexArray;
+    glBindVertexArray(vertexArray);
+  }
+
+  void StateCache::bindFramebuffer(const uint32_t framebuffer)
+  {
+    if(!this->changed(this->currentFramebuffer == framebuffer))
+    {
+      return;
+    }
+    this->currentFramebuffer = framebuffer;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  }
+
+  void StateCache::bindTexture(const uint32_t unit, const uint32_t texture)
+  {
+    if(unit >= this->textureUnits.size())
+    {
+      this->textureUnits.resize(unit + 1, INVALID_HANDLE);
+    }
+    if(!this->changed(this->textureUnits[unit] == texture))
+    {
+      return;
+    }
+    this->textureUnits[unit] = texture;
+    glBindTextureUnit(unit, texture);
+  }
+
+  void StateCache::bindImage(const uint32_t unit, const uint32_t texture, const GLRIOMode mode, const GLRColorFormat format)
+  {
+    if(unit >= this->imageUnits.size())
+    {
+      this->imageUnits.resize(unit + 1);
+    }
+    ImageUnit& image = this->imageUnits[unit];
+    if(!this->changed(image.texture == texture && image.mode == mode && image.format == format))
+    {
+      return;
+    }
+    image = {texture, mode, format};
+    glBindImageTexture(unit, texture, 0, GL_FALSE, 0, (uint32_t)mode, (uint32_t)format);
+  }
+
+  void StateCache::setBlend(const bool enabled)
+  {
+    this->setCapability(this->blend, GL_BLEND, enabled);
+  }
+
+  void StateCache::setBlendFunc(const uint32_t src, const uint32_t dst)
+  {
+    if(!this->changed(this->blendSrc == src && this->blendDst == dst))
+    {
+      return;
+    }
+    this->blendSrc = src;
+    this->blendDst = dst;
+    glBlendFunc(src, dst);
+  }
+
+  void StateCache::setDepthTest(const bool enabled)
+  {
+    this->setCapability(this->depthTest, GL_DEPTH_TEST, enabled);
+  }
+
+  void StateCache::setCullFace(const bool enabled)
+  {
+    this->setCapability(this->cullFace, GL_CULL_FACE, enabled);
+  }
+
+  void StateCache::setScissorTest(const bool enabled)
+  {
+    this->setCapability(this->scissorTest, GL_SCISSOR_TEST, enabled);
+  }
+
+  void StateCache::setScissor(const int32_t x, const int32_t y, const int32_t width, const int32_t height)
+  {
+    const Rect rect{x, y, width, height};
+    if(!this->changed(this->scissor == rect))
+    {
+      return;
+    }
+    this->scissor = rect;
+    glScissor(x, y, width, height);
+  }
+
+  void StateCache::setViewport(const int32_t x, const int32_t y, const int32_t width, const int32_t height)
+  {
+    const Rect rect{x, y, width, height};
+    if(!this->changed(this->viewport == rect))
+    {
+      return;
+    }
+    this->viewport = rect;
+    glViewport(x, y, width, height);
+  }
+
+  uint32_t StateCache::program() const
+  {
+    return this->currentProgram;
+  }
+
+  uint32_t StateCache::vertexArray() const
+  {
+    return this->currentVertexArray;
+  }
+
+  uint32_t StateCache::framebuffer() const
+  {
+    return this->currentFramebuffer;
+  }
+
+  void StateCache::forgetProgram(const uint32_t program)
+  {
+    if(this->currentProgram == program)
+    {
+      this->currentProgram = INVALID_HANDLE;
+    }
+  }
+
+  void StateCache::forgetProgramPipeline(const uint32_t pipeline)
+  {
+    if(this->currentProgramPipeline == pipeline)
+    {
+      this->currentProgramPipeline = INVALID_HANDLE;
+    }
+  }
+
+  void StateCache::forgetVertexArray(const uint32_t vertexArray)
+  {
+    if(this->currentVertexArray == vertexArray)
+    {
+      this->currentVertexArray = INVALID_HANDLE;
+    }
+  }
+
+  void StateCache::forgetFramebuffer(const uint32_t framebuffer)
+  {
+    if(this->currentFramebuffer == framebuffer)
+    {
+      this->currentFramebuffer = INVALID_HANDLE;
+    }
+  }
+
+  void StateCache::forgetTexture(const uint32_t texture)
+  {
+    std::ranges::replace(this->textureUnits, texture, INVALID_HANDLE);
+    for(ImageUnit& image : this->imageUnits)
+    {
+      if(image.texture == texture)
+      {
+        image.texture = INVALID_HANDLE;
+      }
+    }
+  }
+
+  void StateCache::invalidate()
+  {
+    const StateCacheStats counters = this->counters;
+    *this = {};
+    this->counters = counters;
+  }
+
+  StateCacheStats StateCache::stats() const
+  {
+    return this->counters;
+  }
+
+  void StateCache::resetStats()
+  {
+    this->counters = {};
+  }
+}
@@ -0,0 +1,300 @@
+#include "glrender/glrTextBatcher.hh"
+
+#include <glad/gl.hh>
+
+#include "glrender/glrAssetRepository.hh"
+#include "glrender/glrStateCache.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace glr
+{
+  constexpr size_t TEXT_MIN_REGION_VERTICES = 6 * 1024;
+  constexpr uint64_t TEXT_FENCE_TIMEOUT = 1000000; //Nanoseconds
+  constexpr GLbitfield TEXT_BUFFER_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  GlyphVertex makeGlyphVertex(const mat4x4<float>& model, const float x, const float y, const vec2<float>& uv, const uint32_t color)
+  {
+    //Column major, the same layout that's sent to shaders
+    GlyphVertex out;
+    out.x = model.data[0][0] * x + model.data[1][0] * y + model.data[3][0];
+    out.y = model.data[0][1] * x + model.data[1][1] * y + model.data[3][1];
+    out.z = model.data[0][2] * x + model.data[1][2] * y + model.data[3][2];
+    out.u = uv.x();
+    out.v = uv.y();
+    out.color = color;
+    return out;
+  }
+
+  TextBatcher::~TextBatcher()
+  {
+    for(auto& fence : this->fences)
+    {
+      if(fence)
+      {
+        glDeleteSync((GLsync)fence);
+      }
+    }
+    if(this->buffer != INVALID_HANDLE)
+    {
+      glUnmapNamedBuffer(this->buffer);
+      glDeleteBuffers(1, &this->buffer);
+    }
+    if(this->sampler != INVALID_HANDLE)
+    {
+      glDeleteSamplers(1, &this->sampler);
+    }
+    if(this->vao != INVALID_HANDLE)
+    {
+      stateCache().forgetVertexArray(this->vao);
+      glDeleteVertexArrays(1, &this->vao);
+    }
+  }
+
+  void TextBatcher::add(const Renderable& renderable)
+  {
+    if(!renderable.textComp || !renderable.transformComp || !renderable.fragVertShaderComp || (renderable.textComp->text.empty() && renderable.textComp->characterInfo.empty()))
+    {
+      return;
+    }
+
+    const TextComp& textComp = *renderable.textComp;
+    const TransformComp& transform = *renderable.transformComp;
+    auto [it, inserted] = this->cache.try_emplace(&textComp);
+    CachedText& text = it->second;
+    if(inserted || !text.matches(textComp, transform))
+    {
+      this->rebuild(text, textComp, transform);
+    }
+    text.lastUsed = this->frame;
+
+    const ID texture = renderable.textureComp ? renderable.textureComp->texture : INVALID_ID;
+    this->queue.emplace_back(&text, texture, renderable.fragVertShaderComp->shader);
+  }
+
+  bool TextBatcher::CachedText::matches(const TextComp& textComp, const TransformComp& transform) const
+  {
+    if(std::memcmp(&this->transform, &transform, sizeof(TransformComp)) != 0 || this->layout.text != textComp.text)
+    {
+      return false;
+    }
+    if(textComp.text.empty())
+    {
+      return this->characterInfo == textComp.characterInfo;
+    }
+    return this->layout.atlas == textComp.atlas && this->layout.fontSize == textComp.fontSize && this->layout.color == textComp.color;
+  }
+
+  void TextBatcher::rebuild(CachedText& text, const TextComp& textComp, const TransformComp& transform)
+  {
+    text.transform = transform;
+    text.vertices.clear();
+
+    //Glyphs are moved into world space once here instead of per draw
+    const mat4x4<float> model = modelMatrix(transform.pos, transform.rotation, transform.scale);
+    const auto addQuad = [&](const vec2<float>& pos, const vec2<float>& size, const QuadUVs& uvs, const uint32_t color)
+    {
+      const float left = pos.x();
+      const float right = pos.x() + size.x();
+      const float bottom = pos.y();
+      const float top = pos.y() + size.y();
+      text.vertices.emplace_back(makeGlyphVertex(model, left, bottom, uvs.lowerLeft, color));
+      text.vertices.emplace_back(makeGlyphVertex(model, right, bottom, uvs.lowerRight, color));
+      text.vertices.emplace_back(makeGlyphVertex(model, right, top, uvs.upperRight, color));
+      text.vertices.emplace_back(makeGlyphVertex(model, right, top, uvs.upperRight, color));
+      text.vertices.emplace_back(makeGlyphVertex(model, left, top, uvs.upperLeft, color));
+      text.vertices.emplace_back(makeGlyphVertex(model, left, bottom, uvs.lowerLeft, color));
+    };
+
+    if(!textComp.text.empty())
+    {
+      text.layout = {textComp.text, textComp.atlas, textComp.fontSize, textComp.color};
+      text.characterInfo.clear();
+      const GlyphRun& run = this->layouts.get(text.layout, this->frame);
+      text.vertices.reserve(run.glyphs.size() * 6);
+      for(const auto& glyph : run.glyphs)
+      {
+        addQuad(glyph.pos, glyph.size, glyph.uvs, glyph.color);
+      }
+      return;
+    }
+
+    //Individually given characters are laid out left to right one unit apart
+    text.layout = {};
+    text.characterInfo = textComp.characterInfo;
+    text.vertices.reserve(textComp.characterInfo.size() * 6);
+    for(size_t i = 0; i < textComp.characterInfo.size(); i++)
+    {
+      const CharInfo& charInfo = textComp.characterInfo[i];
+      addQuad({(float)i, 0.0f}, {1.0f, 1.0f}, charInfo.atlasUVs, packColor(charInfo.color));
+    }
+  }
+
+  void TextBatcher::flush(const mat4x4<float>& view, const mat4x4<float>& projection)
+  {
+    if(this->queue.empty())
+    {
+      return;
+    }
+
+    //The first flush of a frame reuses the region written three frames ago, make sure the GPU is done reading it
+    if(!this->regionReady)
+    {
+      this->waitForRegion(this->region);
+      this->regionReady = true;
+    }
+
+    size_t vertices = 0;
+    for(const auto& queued : this->queue)
+    {
+      vertices += queued.text->vertices.size();
+    }
+    this->reserve(vertices);
+
+    std::stable_sort(this->queue.begin(), this->queue.end(), [](const QueuedText& a, const QueuedText& b)
+    {
+      return a.shader != b.shader ? a.shader < b.shader : a.texture < b.texture;
+    });
+
+    mat4x4<float> identity{};
+    for(size_t i = 0; i < 4; i++)
+    {
+      identity.data[i][i] = 1.0f;
+    }
+    const mat4x4<float> mvp = modelViewProjectionMatrix(identity, view, projection);
+
+    if(this->sampler == INVALID_HANDLE)
+    {
+      glCreateSamplers(1, &this->sampler);
+      glSamplerParameteri(this->sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glSamplerParameteri(this->sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    stateCache().bindVertexArray(this->vao);
+    size_t i = 0;
+    while(i < this->queue.size())
+    {
+      const ID texture = this->queue[i].texture;
+      const ID shader = this->queue[i].shader;
+      const size_t first = this->region * this->regionCapacity + this->regionUsed;
+      size_t count = 0;
+      for(; i < this->queue.size() && this->queue[i].texture == texture && this->queue[i].shader == shader; i++)
+      {
+        const std::vector<GlyphVertex>& glyphs = this->queue[i].text->vertices;
+        std::memcpy(this->mapped + first + count, glyphs.data(), glyphs.size() * sizeof(GlyphVertex));
+        count += glyphs.size();
+      }
+      this->regionUsed += count;
+
+      asset_repo::textureUse(texture);
+      const uint32_t unit = asset_repo::textureGetBindingTarget(texture);
+      asset_repo::shaderUse(shader);
+      asset_repo::shaderSetUniform(shader, "mvp", mvp);
+      asset_repo::shaderSendUniforms(shader);
+      if(unit != INVALID_HANDLE)
+      {
+        glBindSampler(unit, this->sampler);
+      }
+      glDrawArrays(GL_TRIANGLES, (GLint)first, (GLsizei)count);
+      if(unit != INVALID_HANDLE)
+      {
+        glBindSampler(unit, 0);
+      }
+    }
+
+    this->queue.clear();
+  }
+
+  void TextBatcher::endFrame()
+  {
+    if(this->regionUsed > 0)
+    {
+      this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      this->region = (this->region + 1) % TEXT_RING_REGIONS;
+      this->regionUsed = 0;
+      this->regionReady = false;
+    }
+
+    //The caches are swept once per lifetime instead of every frame, entries go after one to two lifetimes unused
+    this->frame++;
+    if(this->frame % TEXT_CACHE_LIFETIME != 0)
+    {
+      return;
+    }
+    std::erase_if(this->cache, [&](const auto& entry)
+    {
+      return entry.second.lastUsed + TEXT_CACHE_LIFETIME < this->frame;
+    });
+
+    //Layouts are only requested when a string is rebuilt, so the ones still shown are marked used here
+    for(const auto& [textComp, text] : this->cache)
+    {
+      if(!text.layout.text.empty())
+      {
+        this->layouts.touch(text.layout, this->frame);
+      }
+    }
+    this->layouts.trim(this->frame - TEXT_CACHE_LIFETIME);
+  }
+
+  bool TextBatcher::pending() const
+  {
+    return !this->queue.empty();
+  }
+
+  void TextBatcher::reserve(const size_t vertices)
+  {
+    if(this->buffer != INVALID_HANDLE && this->regionUsed + vertices <= this->regionCapacity)
+    {
+      return;
+    }
+
+    //Buffer storage is immutable, so growing means making a new buffer. Draws already submitted keep the old one alive until they finish
+    for(uint32_t i = 0; i < TEXT_RING_REGIONS; i++)
+    {
+      this->waitForRegion(i);
+    }
+    if(this->buffer != INVALID_HANDLE)
+    {
+      glUnmapNamedBuffer(this->buffer);
+      glDeleteBuffers(1, &this->buffer);
+    }
+
+    this->regionCapacity = std::max({vertices, this->regionCapacity * 2, TEXT_MIN_REGION_VERTICES});
+    this->regionUsed = 0;
+    const GLsizeiptr size = (GLsizeiptr)(this->regionCapacity * TEXT_RING_REGIONS * sizeof(GlyphVertex));
+    glCreateBuffers(1, &this->buffer);
+    glNamedBufferStorage(this->buffer, size, nullptr, TEXT_BUFFER_FLAGS);
+    this->mapped = (GlyphVertex*)glMapNamedBufferRange(this->buffer, 0, size, TEXT_BUFFER_FLAGS);
+
+    if(this->vao == INVALID_HANDLE)
+    {
+      glCreateVertexArrays(1, &this->vao);
+      glEnableVertexArrayAttrib(this->vao, 0);
+      glVertexArrayAttribFormat(this->vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(GlyphVertex, x));
+      glVertexArrayAttribBinding(this->vao, 0, 0);
+      glEnableVertexArrayAttrib(this->vao, 1);
+      glVertexArrayAttribFormat(this->vao, 1, 2, GL_FLOAT, GL_FALSE, offsetof(GlyphVertex, u));
+      glVertexArrayAttribBinding(this->vao, 1, 0);
+      glEnableVertexArrayAttrib(this->vao, 3);
+      glVertexArrayAttribFormat(this->vao, 3, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(GlyphVertex, color));
+      glVertexArrayAttribBinding(this->vao, 3, 0);
+    }
+    glVertexArrayVertexBuffer(this->vao, 0, this->buffer, 0, sizeof(GlyphVertex));
+  }
+
+  void TextBatcher::waitForRegion(const uint32_t region)
+  {
+    const GLsync fence = (GLsync)this->fences[region];
+    if(!fence)
+    {
+      return;
+    }
+
+    while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, TEXT_FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED) {}
+    glDeleteSync(fence);
+    this->fences[region] = nullptr;
+  }
+}
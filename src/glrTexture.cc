@@ -1,9 +1,146 @@
 #include "glrender/glrTexture.hh"
+#include "glrender/glrStateCache.hh"
+#include "glrender/glrWorkerPool.hh"
 
 #include <glad/gl.hh>
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <thread>
+
 namespace glr
 {
+  uint32_t mipLevelCount(const uint32_t width, const uint32_t height)
+  {
+    return (uint32_t)std::bit_width(std::max({width, height, 1u}));
+  }
+  
+  size_t compressedLevelSize(const GLRCompressedFormat format, const uint32_t width, const uint32_t height)
+  {
+    //Every supported format stores 4x4 pixel blocks of either 8 or 16 bytes
+    size_t blockSize = 16;
+    switch(format)
+    {
+      case GLRCompressedFormat::BC1_RGB:
+      case GLRCompressedFormat::BC1_RGBA:
+      case GLRCompressedFormat::BC4_R:
+      case GLRCompressedFormat::ETC2_RGB8:
+      case GLRCompressedFormat::ETC2_SRGB8:
+      {
+        blockSize = 8;
+        break;
+      }
+      default: break;
+    }
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+  }
+  
+  GLenum uncompressedInternalFormat(const uint8_t channels, const bool sRGB)
+  {
+    switch(channels)
+    {
+      case 1: return GL_R8;
+      case 2: return GL_RG8;
+      case 3: return sRGB ? GL_SRGB8 : GL_RGB8;
+      default: return sRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    }
+  }
+  
+  GLenum uncompressedColorFormat(const uint8_t channels)
+  {
+    switch(channels)
+    {
+      case 1: return GL_RED;
+      case 2: return GL_RG;
+      case 3: return GL_RGB;
+      default: return GL_RGBA;
+    }
+  }
+  
+  //Average 2x2 blocks of src into rows [firstRow, lastRow) of dst
+  //When a side is odd the last block along it takes in the leftover row or column too, and sides of 1 repeat their pixels
+  void downsampleRows(const uint8_t* src, const uint32_t srcWidth, const uint32_t srcHeight, uint8_t* dst, const uint32_t dstWidth, const uint32_t dstHeight, const uint8_t channels, const uint32_t firstRow, const uint32_t lastRow)
+  {
+    const size_t srcStride = (size_t)srcWidth * channels;
+    const bool oddWidth = srcWidth > 1 && srcWidth % 2 == 1;
+    const bool oddHeight = srcHeight > 1 && srcHeight % 2 == 1;
+    for(uint32_t y = firstRow; y < lastRow; y++)
+    {
+      const std::array<const uint8_t*, 3> rows = {src + std::min(y * 2, srcHeight - 1) * srcStride, src + std::min(y * 2 + 1, srcHeight - 1) * srcStride, src + std::min(y * 2 + 2, srcHeight - 1) * srcStride};
+      const uint32_t rowCount = oddHeight && y == dstHeight - 1 ? 3 : 2;
+      uint8_t* out = dst + (size_t)y * dstWidth * channels;
+      for(uint32_t x = 0; x < dstWidth; x++)
+      {
+        const std::array<size_t, 3> columns = {(size_t)std::min(x * 2, srcWidth - 1) * channels, (size_t)std::min(x * 2 + 1, srcWidth - 1) * channels, (size_t)std::min(x * 2 + 2, srcWidth - 1) * channels};
+        const uint32_t columnCount = oddWidth && x == dstWidth - 1 ? 3 : 2;
+        if(rowCount == 2 && columnCount == 2)
+        {
+          for(uint8_t c = 0; c < channels; c++)
+          {
+            out[(size_t)x * channels + c] = (uint8_t)((rows[0][columns[0] + c] + rows[0][columns[1] + c] + rows[1][columns[0] + c] + rows[1][columns[1] + c] + 2) >> 2);
+          }
+          continue;
+        }
+
+        const uint32_t samples = rowCount * columnCount;
+        for(uint8_t c = 0; c < channels; c++)
+        {
+          uint32_t sum = 0;
+          for(uint32_t row = 0; row < rowCount; row++)
+          {
+            for(uint32_t column = 0; column < columnCount; column++)
+            {
+              sum += rows[row][columns[column] + c];
+            }
+          }
+          out[(size_t)x * channels + c] = (uint8_t)((sum + samples / 2) / samples);
+        }
+      }
+    }
+  }
+  
+  std::vector<std::vector<uint8_t>> downsampleMipChain(const uint8_t* data, const uint32_t width, const uint32_t height, const uint8_t channels, uint32_t threads)
+  {
+    constexpr size_t minRowsPerThread = 64;
+    if(threads == 0)
+    {
+      threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    
+    std::vector<std::vector<uint8_t>> out{};
+    const uint8_t* src = data;
+    uint32_t srcWidth = width;
+    uint32_t srcHeight = height;
+    for(uint32_t level = 1; level < mipLevelCount(width, height); level++)
+    {
+      const uint32_t dstWidth = std::max(srcWidth / 2, 1u);
+      const uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+      std::vector<uint8_t>& dst = out.emplace_back((size_t)dstWidth * dstHeight * channels);
+      
+      //Small levels aren't worth splitting up, big ones are spread over the shared pool
+      const uint32_t workers = (uint32_t)std::min<size_t>(threads, std::max<size_t>(dstHeight / minRowsPerThread, 1));
+      if(workers == 1)
+      {
+        downsampleRows(src, srcWidth, srcHeight, dst.data(), dstWidth, dstHeight, channels, 0, dstHeight);
+      }
+      else
+      {
+        const uint32_t pooled = std::min(workers, workerPool().size());
+        const uint32_t rowsPerWorker = (dstHeight + pooled - 1) / pooled;
+        workerPool().run(pooled, [&](const size_t worker)
+        {
+          downsampleRows(src, srcWidth, srcHeight, dst.data(), dstWidth, dstHeight, channels, (uint32_t)worker * rowsPerWorker, std::min(((uint32_t)worker + 1) * rowsPerWorker, dstHeight));
+        });
+      }
+      
+      src = dst.data();
+      srcWidth = dstWidth;
+      srcHeight = dstHeight;
+    }
+    return out;
+  }
+  
   //Used with subImage(), ie for atlases
   Texture::Texture(const std::string& name, const uint32_t width, const uint32_t height, const uint8_t channels, const GLRFilterMode min, const GLRFilterMode mag, const bool sRGB)
   {
@@ -20,6 +157,11 @@ namespace glr
         internalFormat = GL_R8;
         break;
       }
+      case 2:
+      {
+        internalFormat = GL_RG8;
+        break;
+      }
       case 3: //TODO It's more efficient to use an extra 8 bits of VRAM per pixel
       {
         if(sRGB)
@@ -47,8 +189,9 @@ namespace glr
       default: break;
     }
     
+    this->levels = min == GLRFilterMode::TRILINEAR ? mipLevelCount(width, height) : 1;
     glCreateTextures(GL_TEXTURE_2D, 1, &this->handle);
-    glTextureStorage2D(this->handle, 1, internalFormat, (int32_t)width, (int32_t)height);
+    glTextureStorage2D(this->handle, (GLsizei)this->levels, internalFormat, (int32_t)width, (int32_t)height);
     
     this->clear();
     this->setFilterMode(min, mag);
@@ -73,6 +216,12 @@ namespace glr
         colorFormat = GL_RED;
         break;
       }
+      case 2:
+      {
+        internalFormat = GL_RG8;
+        colorFormat = GL_RG;
+        break;
+      }
       case 3: //TODO It's more efficient to use an extra 8 bits of VRAM per pixel
       {
         if(sRGB)
@@ -102,15 +251,66 @@ namespace glr
       default: break;
     }
     
+    this->levels = min == GLRFilterMode::TRILINEAR ? mipLevelCount(width, height) : 1;
     glCreateTextures(GL_TEXTURE_2D, 1, &this->handle);
-    glTextureStorage2D(this->handle, 1, internalFormat, (int32_t)width, (int32_t)height);
+    glTextureStorage2D(this->handle, (GLsizei)this->levels, internalFormat, (int32_t)width, (int32_t)height);
     glTextureSubImage2D(this->handle, 0, 0, 0, (int32_t)this->width, (int32_t)this->height, colorFormat, GL_UNSIGNED_BYTE, data);
+    this->generateMipmaps();
     
     this->setFilterMode(min, mag);
     this->setAnisotropyLevel(1);
     this->init = true;
   }
   
+  Texture::Texture(const std::string& name, const GLRCompressedFormat format, const uint8_t* data, const size_t dataSize, const uint32_t width, const uint32_t height, const uint32_t levels, const GLRFilterMode min, const GLRFilterMode mag)
+  {
+    this->name = name;
+    this->width = width;
+    this->height = height;
+    this->levels = std::clamp(levels, 1u, mipLevelCount(width, height));
+    this->compressed = true;
+    
+    glCreateTextures(GL_TEXTURE_2D, 1, &this->handle);
+    glTextureStorage2D(this->handle, (GLsizei)this->levels, (GLenum)format, (int32_t)width, (int32_t)height);
+    glTextureParameteri(this->handle, GL_TEXTURE_MAX_LEVEL, (GLint)this->levels - 1);
+    
+    size_t offset = 0;
+    for(uint32_t level = 0; level < this->levels; level++)
+    {
+      const uint32_t levelWidth = std::max(width >> level, 1u);
+      const uint32_t levelHeight = std::max(height >> level, 1u);
+      const size_t levelSize = compressedLevelSize(format, levelWidth, levelHeight);
+      if(offset + levelSize > dataSize)
+      {
+        break;
+      }
+      glCompressedTextureSubImage2D(this->handle, (GLint)level, 0, 0, (GLsizei)levelWidth, (GLsizei)levelHeight, (GLenum)format, (GLsizei)levelSize, data + offset);
+      offset += levelSize;
+    }
+    
+    this->setFilterMode(min, mag);
+    this->setAnisotropyLevel(1);
+    this->init = true;
+  }
+  
+  Texture::Texture(const std::string& name, const uint32_t width, const uint32_t height, const uint8_t channels, const uint32_t layers, const GLRFilterMode min, const GLRFilterMode mag, const bool sRGB)
+  {
+    this->name = name;
+    this->channels = channels;
+    this->width = width;
+    this->height = height;
+    this->layers = std::max(layers, 1u);
+    this->levels = min == GLRFilterMode::TRILINEAR ? mipLevelCount(width, height) : 1;
+    
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &this->handle);
+    glTextureStorage3D(this->handle, (GLsizei)this->levels, uncompressedInternalFormat(channels, sRGB), (GLsizei)width, (GLsizei)height, (GLsizei)this->layers);
+    
+    this->clear();
+    this->setFilterMode(min, mag);
+    this->setAnisotropyLevel(1);
+    this->init = true;
+  }
+  
   Texture::Texture(const std::string& name, const uint8_t red, const uint8_t green, const uint8_t blue, const uint8_t alpha, const bool sRGB)
   {
     this->name = name;
@@ -136,6 +336,11 @@ namespace glr
   
   Texture::~Texture()
   {
+    if(this->bindless != 0)
+    {
+      glMakeTextureHandleNonResidentARB(this->bindless);
+    }
+    stateCache().forgetTexture(this->handle);
     glDeleteTextures(1, &this->handle);
   }
   
@@ -152,6 +357,21 @@ namespace glr
     
     this->channels = moveFrom.channels;
     moveFrom.channels = {};
+    
+    this->levels = moveFrom.levels;
+    moveFrom.levels = 1;
+    
+    this->layers = moveFrom.layers;
+    moveFrom.layers = 0;
+    
+    this->layersUsed = moveFrom.layersUsed;
+    moveFrom.layersUsed = 0;
+    
+    this->bindless = moveFrom.bindless;
+    moveFrom.bindless = 0;
+    
+    this->compressed = moveFrom.compressed;
+    moveFrom.compressed = false;
 
     this->bindingIndex = moveFrom.bindingIndex;
     moveFrom.bindingIndex = 0;
@@ -184,6 +404,21 @@ namespace glr
     
     this->channels = moveFrom.channels;
     moveFrom.channels = {};
+    
+    this->levels = moveFrom.levels;
+    moveFrom.levels = 1;
+    
+    this->layers = moveFrom.layers;
+    moveFrom.layers = 0;
+    
+    this->layersUsed = moveFrom.layersUsed;
+    moveFrom.layersUsed = 0;
+    
+    this->bindless = moveFrom.bindless;
+    moveFrom.bindless = 0;
+    
+    this->compressed = moveFrom.compressed;
+    moveFrom.compressed = false;
 
     this->bindingIndex = moveFrom.bindingIndex;
     moveFrom.bindingIndex = 0;
@@ -212,11 +447,21 @@ namespace glr
   
   void Texture::reset()
   {
+    if(this->bindless != 0)
+    {
+      glMakeTextureHandleNonResidentARB(this->bindless);
+      this->bindless = 0;
+    }
+    stateCache().forgetTexture(this->handle);
     glDeleteTextures(1, &this->handle);
     this->handle = INVALID_HANDLE;
     this->width = 0;
     this->height = 0;
     this->channels = {};
+    this->levels = 1;
+    this->layers = 0;
+    this->layersUsed = 0;
+    this->compressed = false;
     this->name = "";
     this->path = "";
     this->init = false;
@@ -224,30 +469,30 @@ namespace glr
   
   void Texture::use() const
   {
-    int32_t curTex;
-    glGetIntegerv(GL_TEXTURE_BINDING_2D, &curTex);
-    if(curTex != (int32_t)this->bindingIndex)
+    switch(this->bindingType)
     {
-      switch(this->bindingType)
+      case GLRShaderType::FRAG_VERT:
       {
-        case GLRShaderType::FRAG_VERT:
-        {
-          glBindTextureUnit(this->bindingIndex, this->handle);
-          break;
-        }
-        case GLRShaderType::COMPUTE:
-        {
-          glBindImageTexture(this->bindingIndex, this->handle, 0, GL_FALSE, 0, (uint32_t)this->bindingIOMode, (uint32_t)this->bindingColorFormat);
-          break;
-        }
-        default: break;
+        stateCache().bindTexture(this->bindingIndex, this->handle);
+        break;
       }
-      
+      case GLRShaderType::COMPUTE:
+      {
+        stateCache().bindImage(this->bindingIndex, this->handle, this->bindingIOMode, this->bindingColorFormat);
+        break;
+      }
+      default: break;
     }
   }
   
   void Texture::setFilterMode(const GLRFilterMode min, const GLRFilterMode mag) const
   {
+    //A resident texture's sampler state is fixed
+    if(this->bindless != 0)
+    {
+      return;
+    }
+    
     GLenum glMin = GL_NEAREST, glMag = GL_NEAREST;
     switch(min)
     {
@@ -281,9 +526,9 @@ namespace glr
         glMag = GL_LINEAR;
         break;
       }
-      case GLRFilterMode::TRILINEAR:
+      case GLRFilterMode::TRILINEAR: //Mipmaps only apply when minifying
       {
-        glMag = GL_LINEAR_MIPMAP_LINEAR;
+        glMag = GL_LINEAR;
         break;
       }
       default: break;
@@ -294,11 +539,20 @@ namespace glr
   
   void Texture::setAnisotropyLevel(const uint32_t level) const
   {
+    if(this->bindless != 0)
+    {
+      return;
+    }
     glTextureParameterf(this->handle, GL_TEXTURE_MAX_ANISOTROPY, (GLfloat)level);
   }
   
-  void Texture::subImage(const uint8_t* data, const uint32_t w, const uint32_t h, const uint32_t xPos, const uint32_t yPos, const uint8_t channels) const
+  void Texture::subImage(const uint8_t* data, const uint32_t w, const uint32_t h, const uint32_t xPos, const uint32_t yPos, const uint8_t channels, const uint32_t level) const
   {
+    if(this->compressed || this->layers > 0 || level >= this->levels)
+    {
+      return;
+    }
+    
     int32_t format = 0;
     switch(channels)
     {
@@ -317,13 +571,23 @@ namespace glr
         format = GL_RED;
         break;
       }
+      case 2:
+      {
+        format = GL_RG;
+        break;
+      }
       default: break;
     }
-    glTextureSubImage2D(this->handle, 0, (GLint)xPos, (GLint)yPos, (GLint)w, (GLint)h, format, GL_UNSIGNED_BYTE, data);
+    glTextureSubImage2D(this->handle, (GLint)level, (GLint)xPos, (GLint)yPos, (GLint)w, (GLint)h, format, GL_UNSIGNED_BYTE, data);
   }
   
   void Texture::clear() const
   {
+    if(this->compressed)
+    {
+      return;
+    }
+    
     int32_t format = 0;
     switch(this->channels)
     {
@@ -342,16 +606,85 @@ namespace glr
         format = GL_RED;
         break;
       }
+      case 2:
+      {
+        format = GL_RG;
+        break;
+      }
       default: break;
     }
-    glClearTexImage(this->handle, 0, format, GL_UNSIGNED_BYTE, "\0\0\0\0");
+    for(uint32_t level = 0; level < this->levels; level++)
+    {
+      glClearTexImage(this->handle, (GLint)level, format, GL_UNSIGNED_BYTE, "\0\0\0\0");
+    }
+  }
+  
+  void Texture::generateMipmaps() const
+  {
+    if(this->levels > 1 && !this->compressed)
+    {
+      glGenerateTextureMipmap(this->handle);
+    }
+  }
+  
+  void Texture::uploadMipChain(const std::vector<std::vector<uint8_t>>& mips) const
+  {
+    for(uint32_t level = 1; level < this->levels && level <= mips.size(); level++)
+    {
+      this->subImage(mips[level - 1].data(), std::max(this->width >> level, 1u), std::max(this->height >> level, 1u), 0, 0, this->channels, level);
+    }
+  }
+  
+  uint32_t Texture::addLayer(const uint8_t* data)
+  {
+    if(this->layersUsed >= this->layers)
+    {
+      return INVALID_HANDLE;
+    }
+    this->setLayer(this->layersUsed, data);
+    return this->layersUsed++;
+  }
+  
+  uint32_t Texture::addLayer(const Texture& source)
+  {
+    if(this->layersUsed >= this->layers || source.layers > 0 || source.compressed || source.width != this->width || source.height != this->height || source.channels != this->channels)
+    {
+      return INVALID_HANDLE;
+    }
+    
+    //sRGB and linear formats with the same channel count are copy compatible
+    for(uint32_t level = 0; level < std::min(this->levels, source.levels); level++)
+    {
+      glCopyImageSubData(source.handle, GL_TEXTURE_2D, (GLint)level, 0, 0, 0, this->handle, GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, (GLint)this->layersUsed, (GLsizei)std::max(this->width >> level, 1u), (GLsizei)std::max(this->height >> level, 1u), 1);
+    }
+    return this->layersUsed++;
+  }
+  
+  void Texture::setLayer(const uint32_t layer, const uint8_t* data) const
+  {
+    if(layer >= this->layers)
+    {
+      return;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTextureSubImage3D(this->handle, 0, 0, 0, (GLint)layer, (GLsizei)this->width, (GLsizei)this->height, 1, uncompressedColorFormat(this->channels), GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  }
+  
+  uint64_t Texture::bindlessHandle() const
+  {
+    if(this->bindless == 0 && GLAD_GL_ARB_bindless_texture && this->handle != INVALID_HANDLE)
+    {
+      this->bindless = glGetTextureHandleARB(this->handle);
+      glMakeTextureHandleResidentARB(this->bindless);
+    }
+    return this->bindless;
   }
   
   DownloadedImageData Texture::downloadTexture(const uint8_t channels) const
   {
     DownloadedImageData out;
     out.textureName = this->name;
-    int32_t currentTexture = 0;
     int32_t format = 0;
     int32_t channelsPerPixel = 0;
     switch(channels)
@@ -374,16 +707,22 @@ namespace glr
         channelsPerPixel = 1;
         break;
       }
+      case 2:
+      {
+        format = GL_RG;
+        channelsPerPixel = 2;
+        break;
+      }
       default: break;
     }
     
-    glGetIntegerv(GL_TEXTURE_BINDING_2D, &currentTexture);
-    glBindTextureUnit(0, this->handle);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &out.width);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &out.height);
+    //Still waits for the GPU, use a PixelReader to read back without stalling
+    glGetTextureLevelParameteriv(this->handle, 0, GL_TEXTURE_WIDTH, &out.width);
+    glGetTextureLevelParameteriv(this->handle, 0, GL_TEXTURE_HEIGHT, &out.height);
     out.imageData.resize(out.width * out.height * channelsPerPixel);
-    glGetTexImage(GL_TEXTURE_2D, 0, (GLenum)format, GL_UNSIGNED_BYTE, out.imageData.data());
-    glBindTextureUnit(0, currentTexture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTextureImage(this->handle, 0, (GLenum)format, GL_UNSIGNED_BYTE, (GLsizei)out.imageData.size(), out.imageData.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
     return out;
   }
 }
@@ -0,0 +1,246 @@
+#include "glrender/glrTextureStreamer.hh"
+
+#include <glad/gl.hh>
+
+#include "glrender/glrAssetRepository.hh"
+
+#include <cstring>
+
+namespace glr
+{
+  constexpr size_t STREAM_ALIGNMENT = 16;
+  constexpr GLbitfield STREAM_BUFFER_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  GLenum streamFormat(const uint8_t channels)
+  {
+    switch(channels)
+    {
+      case 1: return GL_RED;
+      case 2: return GL_RG;
+      case 3: return GL_RGB;
+      default: return GL_RGBA;
+    }
+  }
+
+  TextureStreamer::~TextureStreamer()
+  {
+    for(const Batch& batch : this->inFlight)
+    {
+      glDeleteSync((GLsync)batch.fence);
+    }
+    if(this->buffer != INVALID_HANDLE)
+    {
+      glUnmapNamedBuffer(this->buffer);
+      glDeleteBuffers(1, &this->buffer);
+    }
+  }
+
+  void TextureStreamer::allocate(const size_t bytes)
+  {
+    if(this->buffer != INVALID_HANDLE)
+    {
+      return;
+    }
+
+    glCreateBuffers(1, &this->buffer);
+    glNamedBufferStorage(this->buffer, (GLsizeiptr)bytes, nullptr, STREAM_BUFFER_FLAGS);
+    this->mapped = (uint8_t*)glMapNamedBufferRange(this->buffer, 0, (GLsizeiptr)bytes, STREAM_BUFFER_FLAGS);
+
+    std::lock_guard lock(this->mutex);
+    this->capacity = bytes;
+  }
+
+  StreamTicket TextureStreamer::upload(const ID texture, const uint8_t* data, const uint32_t width, const uint32_t height, const uint32_t xPos, const uint32_t yPos, const uint8_t channels, StreamCallback callback)
+  {
+    std::unique_ptr<Upload> upload = std::make_unique<Upload>();
+    upload->texture = texture;
+    upload->width = width;
+    upload->height = height;
+    upload->xPos = xPos;
+    upload->yPos = yPos;
+    upload->channels = channels;
+    upload->size = (size_t)width * height * channels;
+    upload->callback = std::move(callback);
+
+    //The upload isn't marked ready until its pixels are written, so the copy can happen outside the lock without update() picking it up early
+    Upload* target = upload.get();
+    StreamTicket out = 0;
+    {
+      std::lock_guard lock(this->mutex);
+      out = this->nextTicket++;
+      upload->ticket = out;
+
+      //Ring space is recycled in queue order, so once one upload is waiting for room everything queued after it has to wait too
+      if(this->overflowed > 0 || !this->claim(*upload))
+      {
+        this->overflowed++;
+      }
+      this->queued.emplace_back(std::move(upload));
+    }
+
+    if(target->reserved > 0)
+    {
+      std::memcpy(this->mapped + target->offset, data, target->size);
+    }
+    else
+    {
+      target->overflow.assign(data, data + target->size);
+    }
+
+    std::lock_guard lock(this->mutex);
+    target->ready = true;
+    return out;
+  }
+
+  void TextureStreamer::update()
+  {
+    //Batches finish in the order they were issued, so stop at the first one the GPU is still reading from
+    while(!this->inFlight.empty())
+    {
+      const GLsync fence = (GLsync)this->inFlight.front().fence;
+      if(glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+      {
+        break;
+      }
+      glDeleteSync(fence);
+      this->retire(this->inFlight.front());
+      this->inFlight.pop_front();
+    }
+
+    Batch batch{};
+    size_t issued = 0;
+    while(true)
+    {
+      std::unique_ptr<Upload> upload = nullptr;
+      {
+        std::lock_guard lock(this->mutex);
+        if(this->queued.empty() || !this->queued.front()->ready || (!batch.uploads.empty() && issued >= this->bytesPerUpdate))
+        {
+          break;
+        }
+
+        //Uploads to textures that are still queued for creation wait for them, ring space is recycled in order so everything else waits too
+        Upload& front = *this->queued.front();
+        if(asset_repo::textureIsQueued(front.texture))
+        {
+          break;
+        }
+
+        //Overflowed uploads that fit in the ring wait for room, ones that never will go straight from client memory
+        if(front.reserved == 0)
+        {
+          if(front.size > 0 && front.size <= this->capacity && !this->claim(front))
+          {
+            break;
+          }
+          this->overflowed--;
+        }
+        upload = std::move(this->queued.front());
+        this->queued.pop_front();
+      }
+
+      if(upload->reserved > 0 && !upload->overflow.empty())
+      {
+        std::memcpy(this->mapped + upload->offset, upload->overflow.data(), upload->size);
+        upload->overflow = {};
+      }
+
+      this->submit(*upload);
+      issued += upload->size;
+      batch.uploads.emplace_back(std::move(upload));
+    }
+
+    if(!batch.uploads.empty())
+    {
+      batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      this->inFlight.emplace_back(std::move(batch));
+    }
+  }
+
+  bool TextureStreamer::isDone(const StreamTicket ticket) const
+  {
+    return ticket <= this->retired.load(std::memory_order_acquire);
+  }
+
+  bool TextureStreamer::claim(Upload& upload)
+  {
+    const size_t size = (upload.size + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1);
+    if(size == 0 || size > this->capacity)
+    {
+      return false;
+    }
+
+    //Allocations never wrap around the end of the ring, the space skipped to start over at 0 is held until this upload retires
+    size_t start = this->head;
+    size_t padding = 0;
+    if(start + size > this->capacity)
+    {
+      padding = this->capacity - start;
+      start = 0;
+    }
+    if(this->used + padding + size > this->capacity)
+    {
+      return false;
+    }
+
+    upload.offset = start;
+    upload.reserved = padding + size;
+    this->head = (start + size) % this->capacity;
+    this->used += upload.reserved;
+    return true;
+  }
+
+  void TextureStreamer::submit(Upload& upload)
+  {
+    const uint32_t handle = asset_repo::textureGetHandle(upload.texture);
+    if(handle == INVALID_HANDLE)
+    {
+      return;
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if(upload.reserved > 0)
+    {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffer);
+      glTextureSubImage2D(handle, 0, (GLint)upload.xPos, (GLint)upload.yPos, (GLsizei)upload.width, (GLsizei)upload.height, streamFormat(upload.channels), GL_UNSIGNED_BYTE, (const void*)upload.offset);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else
+    {
+      glTextureSubImage2D(handle, 0, (GLint)upload.xPos, (GLint)upload.yPos, (GLsizei)upload.width, (GLsizei)upload.height, streamFormat(upload.channels), GL_UNSIGNED_BYTE, upload.overflow.data());
+      upload.overflow = {};
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    //Writes only reach level 0, the rest of the chain is rebuilt from it
+    if(asset_repo::textureGetLevels(upload.texture) > 1)
+    {
+      glGenerateTextureMipmap(handle);
+    }
+    upload.success = true;
+  }
+
+  void TextureStreamer::retire(Batch& batch)
+  {
+    {
+      std::lock_guard lock(this->mutex);
+      for(const std::unique_ptr<Upload>& upload : batch.uploads)
+      {
+        this->used -= upload->reserved;
+      }
+      if(this->used == 0)
+      {
+        this->head = 0;
+      }
+    }
+
+    for(const std::unique_ptr<Upload>& upload : batch.uploads)
+    {
+      this->retired.store(upload->ticket, std::memory_order_release);
+      if(upload->callback)
+      {
+        upload->callback(upload->success);
+      }
+    }
+  }
+}
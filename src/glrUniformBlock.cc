@@ -0,0 +1,234 @@
+#include "glrender/glrUniformBlock.hh"
+
+#include <glad/gl.hh>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace glr
+{
+  constexpr uint32_t STD140_MATRIX_STRIDE = 16;
+
+  struct MemberLayout
+  {
+    uint32_t size = 0;
+    uint32_t alignment = 0;
+    uint32_t matrixStride = 0;
+  };
+
+  MemberLayout std140Layout(const UniformValue& value)
+  {
+    return std::visit([](const auto& val) -> MemberLayout
+    {
+      using T = std::decay_t<decltype(val)>;
+      if constexpr(std::is_same_v<T, mat3x3<float>>)
+      {
+        return {3 * STD140_MATRIX_STRIDE, STD140_MATRIX_STRIDE, STD140_MATRIX_STRIDE};
+      }
+      else if constexpr(std::is_same_v<T, mat4x4<float>>)
+      {
+        return {4 * STD140_MATRIX_STRIDE, STD140_MATRIX_STRIDE, STD140_MATRIX_STRIDE};
+      }
+      else
+      {
+        //Scalars and vectors align to their size, except 3 component vectors which align like 4 component ones
+        constexpr uint32_t size = sizeof(T);
+        return {size, size == 12 ? 16u : size, 0};
+      }
+    }, value);
+  }
+
+  UniformBlock::UniformBlock(const GLRBlockType type)
+  {
+    this->type = type;
+  }
+
+  UniformBlock::~UniformBlock()
+  {
+    if(this->buffer != INVALID_HANDLE)
+    {
+      glDeleteBuffers(1, &this->buffer);
+    }
+  }
+
+  UniformBlock::UniformBlock(UniformBlock&& moveFrom) noexcept
+  {
+    *this = std::move(moveFrom);
+  }
+
+  UniformBlock& UniformBlock::operator=(UniformBlock&& moveFrom) noexcept
+  {
+    if(this == &moveFrom)
+    {
+      return *this;
+    }
+
+    if(this->buffer != INVALID_HANDLE)
+    {
+      glDeleteBuffers(1, &this->buffer);
+    }
+    this->buffer = moveFrom.buffer;
+    moveFrom.buffer = INVALID_HANDLE;
+
+    this->bufferSize = moveFrom.bufferSize;
+    moveFrom.bufferSize = 0;
+
+    this->type = moveFrom.type;
+    this->data = std::move(moveFrom.data);
+    this->members = std::move(moveFrom.members);
+    this->memberIndices = std::move(moveFrom.memberIndices);
+    this->dirtyBegin = moveFrom.dirtyBegin;
+    this->dirtyEnd = moveFrom.dirtyEnd;
+    moveFrom.data = {};
+    moveFrom.members = {};
+    moveFrom.memberIndices = {};
+    moveFrom.dirtyBegin = std::numeric_limits<size_t>::max();
+    moveFrom.dirtyEnd = 0;
+
+    return *this;
+  }
+
+  uint32_t UniformBlock::addMember(const std::string& name, const UniformValue& value)
+  {
+    const MemberLayout layout = std140Layout(value);
+    const size_t offset = (this->data.size() + layout.alignment - 1) / layout.alignment * layout.alignment;
+    this->resize(offset + layout.size);
+    const uint32_t member = this->addMember(name, (uint32_t)offset, layout.matrixStride);
+    this->set(member, value);
+    return member;
+  }
+
+  uint32_t UniformBlock::addMember(const std::string& name, const uint32_t offset, const uint32_t matrixStride)
+  {
+    const auto [it, inserted] = this->memberIndices.try_emplace(name, (uint32_t)this->members.size());
+    if(inserted)
+    {
+      this->members.emplace_back(offset, matrixStride);
+    }
+    else
+    {
+      this->members[it->second] = {offset, matrixStride};
+    }
+    return it->second;
+  }
+
+  void UniformBlock::resize(const size_t size)
+  {
+    if(size > this->data.size())
+    {
+      this->data.resize(size, 0);
+    }
+  }
+
+  int32_t UniformBlock::memberIndex(const std::string& name) const
+  {
+    if(!this->memberIndices.contains(name))
+    {
+      return -1;
+    }
+    return (int32_t)this->memberIndices.at(name);
+  }
+
+  void UniformBlock::set(const std::string& name, const UniformValue& value)
+  {
+    const int32_t member = this->memberIndex(name);
+    if(member < 0)
+    {
+      return;
+    }
+    this->set((uint32_t)member, value);
+  }
+
+  void UniformBlock::set(const uint32_t member, const UniformValue& value)
+  {
+    if(member >= this->members.size())
+    {
+      return;
+    }
+
+    const auto& [offset, matrixStride] = this->members[member];
+    std::visit([&](const auto& val)
+    {
+      using T = std::decay_t<decltype(val)>;
+      if constexpr(std::is_same_v<T, mat3x3<float>> || std::is_same_v<T, mat4x4<float>>)
+      {
+        //Columns are padded out to the matrix stride
+        constexpr size_t columns = sizeof(val.data) / sizeof(val.data[0]);
+        const size_t stride = matrixStride ? matrixStride : STD140_MATRIX_STRIDE;
+        for(size_t column = 0; column < columns; column++)
+        {
+          this->write(offset + column * stride, val.data[column], sizeof(val.data[column]));
+        }
+      }
+      else
+      {
+        this->write(offset, &val, sizeof(T));
+      }
+    }, value);
+  }
+
+  void UniformBlock::write(const size_t offset, const void* bytes, const size_t size)
+  {
+    if(offset + size > this->data.size())
+    {
+      return;
+    }
+    if(std::memcmp(this->data.data() + offset, bytes, size) == 0)
+    {
+      return;
+    }
+    std::memcpy(this->data.data() + offset, bytes, size);
+    this->dirtyBegin = std::min(this->dirtyBegin, offset);
+    this->dirtyEnd = std::max(this->dirtyEnd, offset + size);
+  }
+
+  void UniformBlock::upload()
+  {
+    if(this->data.empty())
+    {
+      return;
+    }
+
+    //Storage is immutable, so the buffer is only replaced when the block outgrows it
+    if(this->buffer == INVALID_HANDLE || this->bufferSize < this->data.size())
+    {
+      if(this->buffer != INVALID_HANDLE)
+      {
+        glDeleteBuffers(1, &this->buffer);
+      }
+      glCreateBuffers(1, &this->buffer);
+      this->bufferSize = this->data.size();
+      glNamedBufferStorage(this->buffer, (GLsizeiptr)this->bufferSize, this->data.data(), GL_DYNAMIC_STORAGE_BIT);
+    }
+    else if(this->isDirty())
+    {
+      glNamedBufferSubData(this->buffer, (GLintptr)this->dirtyBegin, (GLsizeiptr)(this->dirtyEnd - this->dirtyBegin), this->data.data() + this->dirtyBegin);
+    }
+    this->dirtyBegin = std::numeric_limits<size_t>::max();
+    this->dirtyEnd = 0;
+  }
+
+  void UniformBlock::bind(const uint32_t binding) const
+  {
+    if(this->buffer == INVALID_HANDLE)
+    {
+      return;
+    }
+    glBindBufferBase((GLenum)this->type, binding, this->buffer);
+  }
+
+  size_t UniformBlock::size() const
+  {
+    return this->data.size();
+  }
+
+  bool UniformBlock::empty() const
+  {
+    return this->members.empty();
+  }
+
+  bool UniformBlock::isDirty() const
+  {
+    return this->dirtyBegin < this->dirtyEnd;
+  }
+}
@@ -0,0 +1,124 @@
+#include "glrender/glrWorkerPool.hh"
+
+#include <algorithm>
+
+namespace glr
+{
+  WorkerPool& workerPool()
+  {
+    static WorkerPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+    return pool;
+  }
+
+  WorkerPool::WorkerPool(const uint32_t threads)
+  {
+    //The thread calling run() does a share of the work too
+    for(uint32_t i = 1; i < threads; i++)
+    {
+      this->threads.emplace_back(&WorkerPool::loop, this);
+    }
+  }
+
+  WorkerPool::~WorkerPool()
+  {
+    {
+      std::lock_guard lock(this->mutex);
+      this->stopping = true;
+    }
+    this->wake.notify_all();
+    for(auto& thread : this->threads)
+    {
+      thread.join();
+    }
+  }
+
+  uint32_t WorkerPool::size() const
+  {
+    return (uint32_t)this->threads.size() + 1;
+  }
+
+  void WorkerPool::run(const size_t count, const std::function<void(size_t)>& job)
+  {
+    if(this->threads.empty() || count <= 1)
+    {
+      for(size_t i = 0; i < count; i++)
+      {
+        job(i);
+      }
+      return;
+    }
+
+    std::lock_guard runLock(this->runMutex);
+    {
+      std::lock_guard lock(this->mutex);
+      this->job = &job;
+      this->count = count;
+      this->next = 0;
+      this->done = 0;
+      this->generation++;
+    }
+    this->wake.notify_all();
+    this->work(&job, count);
+
+    //Pool threads that picked up this job have to leave it before the job can go out of scope
+    std::unique_lock lock(this->mutex);
+    this->finished.wait(lock, [this]
+    {
+      return this->done == this->count && this->active == 0;
+    });
+    this->job = nullptr;
+    this->count = 0;
+  }
+
+  void WorkerPool::loop()
+  {
+    uint64_t seen = 0;
+    while(true)
+    {
+      const std::function<void(size_t)>* job = nullptr;
+      size_t count = 0;
+      {
+        std::unique_lock lock(this->mutex);
+        this->wake.wait(lock, [&]
+        {
+          return this->stopping || this->generation != seen;
+        });
+        if(this->stopping)
+        {
+          return;
+        }
+        seen = this->generation;
+        if(!this->job) //Woke after the job it was started for had already finished
+        {
+          continue;
+        }
+        job = this->job;
+        count = this->count;
+        this->active++;
+      }
+
+      this->work(job, count);
+
+      {
+        std::lock_guard lock(this->mutex);
+        this->active--;
+      }
+      this->finished.notify_all();
+    }
+  }
+
+  void WorkerPool::work(const std::function<void(size_t)>* job, const size_t count)
+  {
+    size_t completed = 0;
+    for(size_t i = this->next.fetch_add(1); i < count; i = this->next.fetch_add(1))
+    {
+      (*job)(i);
+      completed++;
+    }
+    if(completed > 0)
+    {
+      std::lock_guard lock(this->mutex);
+      this->done += completed;
+    }
+  }
+}
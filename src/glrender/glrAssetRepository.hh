@@ -11,7 +11,9 @@
 #include "glrFramebuffer.hh"
 #include "glrShaderPipeline.hh"
 
+#include <chrono>
 #include <string>
+#include <vector>
 
 namespace glr::asset_repo
 {
@@ -19,6 +21,8 @@ namespace glr::asset_repo
   GLRENDER_API ID newShader(const std::string& shaderName, const std::string& vertSrc, const std::string& fragSrc);
   GLRENDER_API ID newShader(const std::string& shaderName, const std::string& compSrc);
   GLRENDER_API ID newTexture(const std::string& textureName, const uint8_t* data, uint32_t width, uint32_t height, uint8_t channels, GLRFilterMode min = GLRFilterMode::NEAREST, GLRFilterMode mag = GLRFilterMode::NEAREST, bool sRGB = false);
+  GLRENDER_API ID newTexture(const std::string& textureName, GLRCompressedFormat format, const uint8_t* data, size_t dataSize, uint32_t width, uint32_t height, uint32_t levels = 1, GLRFilterMode min = GLRFilterMode::BILINEAR, GLRFilterMode mag = GLRFilterMode::BILINEAR);
+  GLRENDER_API ID newTextureArray(const std::string& textureName, uint32_t width, uint32_t height, uint8_t channels, uint32_t layers, GLRFilterMode min = GLRFilterMode::NEAREST, GLRFilterMode mag = GLRFilterMode::NEAREST, bool sRGB = false);
   GLRENDER_API ID newMesh();
   GLRENDER_API ID newFBO();
   GLRENDER_API ID newAtlas();
@@ -46,11 +50,27 @@ namespace glr::asset_repo
   GLRENDER_API void deleteShaderPipelines();
   GLRENDER_API void deleteAll();
 
+  //Deferred creation
+  //The queue functions are safe to call from any thread, they return the asset's ID immediately and copy what they need to build it later
+  //The asset is created on the GL thread by createQueued(), until then the matching exists function returns false
+  //Deleting a queued asset before it's created has no effect, deleting every asset of its type cancels it
+  GLRENDER_API ID queueShader(const std::string& shaderName, std::string vertSrc, std::string fragSrc);
+  GLRENDER_API ID queueShader(const std::string& shaderName, std::string compSrc);
+  GLRENDER_API ID queueTexture(const std::string& textureName, uint32_t width, uint32_t height, uint8_t channels, GLRFilterMode min = GLRFilterMode::NEAREST, GLRFilterMode mag = GLRFilterMode::NEAREST, bool sRGB = false); //Storage only, fill it with a TextureStreamer
+  GLRENDER_API ID queueTexture(const std::string& textureName, std::vector<uint8_t> data, uint32_t width, uint32_t height, uint8_t channels, GLRFilterMode min = GLRFilterMode::NEAREST, GLRFilterMode mag = GLRFilterMode::NEAREST, bool sRGB = false);
+  GLRENDER_API bool textureIsQueued(ID texture); //True while a queued texture waits for createQueued(), GL thread only
+
+  /// Create queued assets in the order they were queued until the time budget runs out, at least one is always created
+  /// Must be called on the GL thread, Renderer::render() and PipelineRenderer::render() call it once per frame with their assetCreationBudget
+  /// @return The number of assets still waiting to be created
+  GLRENDER_API size_t createQueued(std::chrono::microseconds budget);
+
   //Method forwarding
   //Shaders
   GLRENDER_API void shaderUse(ID shader);
   GLRENDER_API void shaderSetUniform(ID shader, const std::string& name, const Shader::UniformValue& val);
   GLRENDER_API void shaderSendUniforms(ID shader);
+  GLRENDER_API Shader* shaderGet(ID shader); //For hot paths that resolve a shader once, the pointer is invalidated when shaderRevision() changes
   
   //Texture
   GLRENDER_API void textureUse(ID texture);
@@ -60,8 +80,14 @@ namespace glr::asset_repo
   GLRENDER_API void textureSetAnisotropyLevel(ID texture, uint32_t level);
   GLRENDER_API void textureSubImage(ID texture, const uint8_t* data, uint32_t width, uint32_t height, uint32_t xPos, uint32_t yPos, uint8_t channels);
   GLRENDER_API void textureClear(ID texture);
+  GLRENDER_API void textureGenerateMipmaps(ID texture);
+  GLRENDER_API uint32_t textureAddLayer(ID textureArray, const uint8_t* data); //Returns the new layer, or INVALID_HANDLE
+  GLRENDER_API uint32_t textureAddLayer(ID textureArray, ID source); //Copies a whole texture into a new layer on the GPU, returns the new layer, or INVALID_HANDLE
+  GLRENDER_API uint64_t textureGetBindlessHandle(ID texture); //0 if the texture doesn't exist or bindless textures aren't supported
   GLRENDER_API DownloadedImageData textureDownload(ID texture, uint8_t channels);
   GLRENDER_API uint32_t textureGetHandle(ID texture);
+  GLRENDER_API uint32_t textureGetLevels(ID texture); //0 if the texture doesn't exist
+  GLRENDER_API uint32_t textureGetBindingTarget(ID texture); //The texture unit textureUse() binds to, INVALID_HANDLE if the texture doesn't exist
   
   //Mesh
   GLRENDER_API void meshUse(ID mesh);
@@ -79,6 +105,11 @@ namespace glr::asset_repo
   GLRENDER_API GLRBufferType meshGetBufferType(ID mesh);
   GLRENDER_API GLRDrawMode meshGetDrawMode(ID mesh);
   GLRENDER_API GLRDrawType meshGetDrawType(ID mesh);
+  GLRENDER_API GLRIndexBufferType meshGetIndexType(ID mesh);
+  GLRENDER_API uint32_t meshGetVertexArray(ID mesh);
+  GLRENDER_API uint32_t meshGetBaseVertex(ID mesh);
+  GLRENDER_API uint32_t meshGetFirstIndex(ID mesh);
+  GLRENDER_API float meshGetBoundingRadius(ID mesh);
 
   //Framebuffer
   GLRENDER_API void fboUse(ID fbo);
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "glrAssetID.hh"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace glr
+{
+  /// Dense storage for one kind of asset, addressed by generational IDs
+  /// The low 32 bits of an ID are a slot index and the high 32 bits are the slot's generation, which changes every time the slot is freed,
+  /// so IDs of deleted assets stay invalid even after their slot is reused
+  /// Assets are stored in fixed size pages, so pointers to them stay valid until the asset is erased
+  /// reserve() is safe to call from any thread, everything else must happen on the thread that owns the table
+  template <typename T> struct AssetTable
+  {
+    static constexpr uint32_t PAGE_SIZE = 256;
+
+    /// Construct a new asset in place
+    /// @return The new asset's ID
+    template <typename... Args> ID emplace(Args&&... args)
+    {
+      uint32_t index = 0;
+      if(!this->freeSlots.empty())
+      {
+        index = this->freeSlots.back();
+        this->freeSlots.pop_back();
+      }
+      else
+      {
+        index = this->nextSlot.fetch_add(1, std::memory_order_relaxed);
+      }
+      return this->construct(index, std::forward<Args>(args)...);
+    }
+
+    /// Claim an ID for an asset that will be constructed later with emplaceAt(), lock-free and safe to call from any thread
+    /// The ID isn't valid for at() or contains() until then
+    [[nodiscard]] ID reserve()
+    {
+      //Fresh slots always start at generation 1, so the ID is known without touching the pages
+      return (ID)1 << 32 | this->nextSlot.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Construct an asset in a slot claimed by reserve()
+    /// @return False if the ID wasn't reserved or has since been invalidated by clear()
+    template <typename... Args> bool emplaceAt(const ID id, Args&&... args)
+    {
+      const uint32_t index = (uint32_t)id;
+      if(index >= this->nextSlot.load(std::memory_order_relaxed))
+      {
+        return false;
+      }
+      this->grow(index);
+      const Slot& slot = this->slot(index);
+      if(slot.value || slot.generation != (uint32_t)(id >> 32))
+      {
+        return false;
+      }
+      this->construct(index, std::forward<Args>(args)...);
+      return true;
+    }
+
+    /// Get an asset, or nullptr if the ID was never valid or its asset has been erased
+    [[nodiscard]] T* at(const ID id)
+    {
+      const uint32_t index = (uint32_t)id;
+      if(index >= this->pages.size() * PAGE_SIZE)
+      {
+        return nullptr;
+      }
+      Slot& slot = this->slot(index);
+      if(slot.generation != (uint32_t)(id >> 32) || !slot.value)
+      {
+        return nullptr;
+      }
+      return &*slot.value;
+    }
+
+    [[nodiscard]] bool contains(const ID id)
+    {
+      return this->at(id) != nullptr;
+    }
+
+    /// True for an ID claimed by reserve() whose asset hasn't been constructed yet, false once it exists or has been invalidated
+    [[nodiscard]] bool pending(const ID id)
+    {
+      const uint32_t index = (uint32_t)id;
+      if(index >= this->nextSlot.load(std::memory_order_relaxed))
+      {
+        return false;
+      }
+
+      //Pages past the end haven't been touched, so their slots are still empty and at generation 1
+      if(index >= this->pages.size() * PAGE_SIZE)
+      {
+        return (uint32_t)(id >> 32) == 1;
+      }
+      const Slot& slot = this->slot(index);
+      return !slot.value && slot.generation == (uint32_t)(id >> 32);
+    }
+
+    /// Destroy an asset and free its slot, stale IDs are ignored
+    void erase(const ID id)
+    {
+      if(!this->contains(id))
+      {
+        return;
+      }
+      this->release((uint32_t)id);
+    }
+
+    /// Destroy every asset, all existing IDs become invalid, including reserved ones that haven't been constructed yet
+    void clear()
+    {
+      const uint32_t slots = this->nextSlot.load(std::memory_order_relaxed);
+      if(slots == 0)
+      {
+        return;
+      }
+      this->grow(slots - 1);
+      this->freeSlots.clear();
+      for(uint32_t index = slots; index > 0; index--)
+      {
+        Slot& slot = this->slot(index - 1);
+        slot.value.reset();
+        slot.generation = slot.generation == UINT32_MAX ? 1 : slot.generation + 1;
+        this->freeSlots.emplace_back(index - 1);
+      }
+      this->live = 0;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+      return this->live;
+    }
+
+    private:
+    struct Slot
+    {
+      std::optional<T> value{};
+      uint32_t generation = 1; //Starts at 1 so a zeroed ID is never valid
+    };
+
+    using Page = std::array<Slot, PAGE_SIZE>;
+
+    template <typename... Args> ID construct(const uint32_t index, Args&&... args)
+    {
+      this->grow(index);
+      Slot& slot = this->slot(index);
+      slot.value.emplace(std::forward<Args>(args)...);
+      this->live++;
+      return (ID)slot.generation << 32 | index;
+    }
+
+    void grow(const uint32_t index)
+    {
+      while(index >= this->pages.size() * PAGE_SIZE)
+      {
+        this->pages.emplace_back(std::make_unique<Page>());
+      }
+    }
+
+    Slot& slot(const uint32_t index)
+    {
+      return (*this->pages[index / PAGE_SIZE])[index % PAGE_SIZE];
+    }
+
+    void release(const uint32_t index)
+    {
+      Slot& slot = this->slot(index);
+      slot.value.reset();
+      slot.generation = slot.generation == UINT32_MAX ? 1 : slot.generation + 1;
+      this->freeSlots.emplace_back(index);
+      this->live--;
+    }
+
+    std::vector<std::unique_ptr<Page>> pages{};
+    std::vector<uint32_t> freeSlots{};
+    std::atomic<uint32_t> nextSlot = 0; //Slots below this have been handed out by emplace() or reserve()
+    size_t live = 0;
+  };
+}
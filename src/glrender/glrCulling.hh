@@ -0,0 +1,126 @@
+#pragma once
+
+#include "export.hh"
+#include "glrUtil.hh"
+#include "glrShader.hh"
+#include "glrSpatialIndex.hh"
+
+#include <commons/math/mat4.hh>
+#include <commons/math/vec3.hh>
+#include <commons/math/vec4.hh>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace glr
+{
+  //Shader storage binding points used by GpuCuller's compute pass, they're clear of the instance buffer bindings
+  inline constexpr uint32_t CULL_INPUT_BINDING = 3;
+  inline constexpr uint32_t CULL_ELEMENT_COMMAND_BINDING = 4;
+  inline constexpr uint32_t CULL_ARRAY_COMMAND_BINDING = 5;
+  inline constexpr uint32_t CULL_CULLED_ELEMENT_COMMAND_BINDING = 6;
+  inline constexpr uint32_t CULL_CULLED_ARRAY_COMMAND_BINDING = 7;
+  inline constexpr uint32_t CULL_COUNT_BINDING = 8;
+
+  /// The six planes of a view volume, normalized and pointing inwards, as ax + by + cz + d
+  struct Frustum
+  {
+    std::array<vec4<float>, 6> planes{};
+  };
+
+  /// How many objects the last culling pass looked at, and how many of them were kept
+  struct CullStats
+  {
+    size_t tested = 0;
+    size_t visible = 0;
+  };
+
+  /// Extract the frustum from a combined view and projection matrix, works for both perspective and orthographic projections
+  [[nodiscard]] GLRENDER_API Frustum frustumFromMatrix(const mat4x4<float>& viewProjection);
+
+  /// The box around a frustum's corners, for querying a SpatialIndex
+  /// Frustums without all eight corners, such as ones with an infinite far plane, give unbounded boxes
+  [[nodiscard]] GLRENDER_API Bounds frustumBounds(const Frustum& frustum);
+
+  /// True when a sphere is at least partly inside the frustum
+  [[nodiscard]] GLRENDER_API bool sphereVisible(const Frustum& frustum, const vec3<float>& center, float radius);
+
+  /// Test many bounding spheres at once, each one given as x, y, z and radius in its own array
+  /// The arrays are walked one plane at a time so the compiler can vectorize the tests
+  /// @param visible Set to 1 for spheres at least partly inside the frustum and 0 for the rest
+  /// @param threads How many threads of workerPool() to split the spheres between, small counts always run on the calling thread
+  /// @return The number of visible spheres
+  GLRENDER_API size_t cullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius, uint8_t* visible, size_t count, uint32_t threads = 1);
+
+  /// One draw command for GpuCuller to test, laid out to match std430
+  struct GpuCullInput
+  {
+    vec4<float> sphere{}; //World space center and radius
+    uint32_t multiDraw = 0; //Which count the command is added to
+    uint32_t outputBase = 0; //Where the multi-draw's commands start in the culled buffer
+    uint32_t source = 0; //The command's index in its source buffer
+    uint32_t indexed = 0; //Whether the command is in the element or array buffer
+  };
+
+  /// Culls draw commands on the GPU with a compute shader, visible commands are compacted into the front of their multi-draw's range,
+  /// and the number kept per multi-draw is written to a buffer that glMultiDraw*IndirectCount can read
+  /// Commands within a multi-draw may come out in any order
+  /// All functions must be called on the GL thread, drawing the results with glMultiDraw*IndirectCount needs OpenGL 4.6, see supported()
+  struct GpuCuller
+  {
+    GLRENDER_API GpuCuller();
+    GLRENDER_API ~GpuCuller();
+
+    GpuCuller(GpuCuller const &copyFrom) = delete;
+    GpuCuller& operator=(GpuCuller const &copyFrom) = delete;
+
+    [[nodiscard]] GLRENDER_API static bool supported();
+
+    /// Cull commands read from two buffers of DrawElementsIndirectCommand and DrawArraysIndirectCommand
+    /// @param elementCommands Buffer holding elementCount element commands
+    /// @param arrayCommands Buffer holding arrayCount array commands
+    /// @param multiDraws The number of counts to produce
+    GLRENDER_API void cull(const Frustum& frustum, const std::vector<GpuCullInput>& inputs, uint32_t elementCommands, size_t elementCount, uint32_t arrayCommands, size_t arrayCount, uint32_t multiDraws);
+
+    /// Buffers written by cull(), valid until the next call
+    [[nodiscard]] GLRENDER_API uint32_t culledElementCommands() const;
+    [[nodiscard]] GLRENDER_API uint32_t culledArrayCommands() const;
+    [[nodiscard]] GLRENDER_API uint32_t counts() const;
+
+    /// Fence the passes made since the last call so their counts can be read back together, call once per frame after the last cull()
+    GLRENDER_API void endFrame();
+
+    /// Results of every pass in the most recent frame the GPU has finished, usually a frame or two behind, never blocks
+    [[nodiscard]] GLRENDER_API CullStats stats();
+
+    private:
+    struct Buffer
+    {
+      uint32_t handle = INVALID_HANDLE;
+      size_t capacity = 0;
+    };
+
+    static void reserve(Buffer& buffer, size_t size);
+    void reserveReadback(size_t size);
+
+    std::unique_ptr<Shader> shader{};
+    int32_t planesLocation = -1;
+    int32_t inputCountLocation = -1;
+
+    Buffer inputBuffer{};
+    Buffer culledElements{};
+    Buffer culledArrays{};
+    Buffer countBuffer{};
+
+    //Counts are copied here after each pass and summed once the GPU is done with the frame
+    Buffer readback{};
+    uint32_t* mapped = nullptr;
+    void* fence = nullptr; //GLsync
+    size_t frameDraws = 0; //Counts copied so far this frame
+    size_t frameTested = 0;
+    size_t pendingDraws = 0;
+    size_t pendingTested = 0;
+    CullStats lastStats{};
+  };
+}
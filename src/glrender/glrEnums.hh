@@ -47,6 +47,23 @@ enum class GLRColorFormat : unsigned short
   DEPTH32F = 0x8CAC,
 };
 
+//Block compressed internal formats, BCn needs EXT_texture_compression_s3tc and ARB_texture_compression_bptc, ETC2 is core
+enum class GLRCompressedFormat : unsigned short
+{
+  BC1_RGB = 0x83F0,
+  BC1_RGBA = 0x83F1,
+  BC3_RGBA = 0x83F3,
+  BC4_R = 0x8DBB,
+  BC5_RG = 0x8DBD,
+  BC6H_RGB_UFLOAT = 0x8E8F,
+  BC7_RGBA = 0x8E8C,
+  BC7_SRGB_ALPHA = 0x8E8D,
+  ETC2_RGB8 = 0x9274,
+  ETC2_SRGB8 = 0x9275,
+  ETC2_RGBA8 = 0x9278,
+  ETC2_SRGB8_ALPHA8 = 0x9279,
+};
+
 enum class GLRDrawType : unsigned short
 {
   STREAM_COPY = 0x88E2, STREAM_DRAW = 0x88E0, STREAM_READ = 0x88E1,
@@ -82,7 +99,13 @@ enum struct GLRShaderType
 
 enum struct GLRIndexBufferType : unsigned short
 {
-  UINT = 0x1405, INT = 0x1404,
+  UINT = 0x1405, INT = 0x1404, USHORT = 0x1403,
+};
+
+//Storage format of a vertex attribute, see Mesh
+enum struct GLRAttribFormat
+{
+  FLOAT, HALF_FLOAT, UNORM8, UNORM16, SNORM_2_10_10_10,
 };
 
 enum struct GLRBlendMode : unsigned short
@@ -97,3 +120,8 @@ enum struct GLRClearType : unsigned int
   NONE = 0,
   COLOR = 0x00004000, DEPTH = 0x00000100, STENCIL = 0x00000400,
 };
+
+enum struct GLRBlockType : unsigned short
+{
+  UNIFORM = 0x8A11, STORAGE = 0x90D2,
+};
@@ -9,5 +9,5 @@ namespace glr
 {
   GLRENDER_API void pixelStoreiPack(int i);
   GLRENDER_API void pixelStoreiUnpack(int i);
-  GLRENDER_API std::vector<uint8_t> getPixels(uint32_t width, uint32_t height);
+  GLRENDER_API std::vector<uint8_t> getPixels(uint32_t width, uint32_t height); //Stalls until the GPU has finished rendering, see PixelReader for capturing every frame
 }
@@ -7,9 +7,14 @@
 #include "glrTexture.hh"
 #include "glrRenderable.hh"
 #include "glrRenderList.hh"
+#include "glrTextBatcher.hh"
+#include "glrTextureStreamer.hh"
+#include "glrCulling.hh"
+#include "glrStateCache.hh"
 #include "glrEnums.hh"
 
 #include <commons/math/mat4.hh>
+#include <chrono>
 #include <numeric>
 
 //A fixed function pipeline rendering engine
@@ -28,6 +33,24 @@ namespace glr
     bool alt = true;
   };
 
+  //Shader storage binding point that per-instance data is bound to when instanced batching is enabled
+  inline constexpr uint32_t INSTANCE_BUFFER_BINDING = 0;
+
+  //Shader storage binding point of each instance's array texture layer when instanced batching is enabled
+  inline constexpr uint32_t INSTANCE_LAYER_BUFFER_BINDING = 1;
+
+  //Shader storage binding point of each instance's bindless texture handle when bindless textures are enabled
+  inline constexpr uint32_t INSTANCE_TEXTURE_BUFFER_BINDING = 2;
+
+  //Uniform buffer binding point of the per-frame values shared by every shader, see Renderer::render()
+  inline constexpr uint32_t FRAME_UNIFORM_BINDING = 0;
+
+  /// Per-instance data streamed to shaders when instanced batching is enabled, laid out to match std430
+  struct InstanceData
+  {
+    mat4x4<float> mvp{};
+  };
+
   //TODO support shader pipelines
   /// OpenGL 4.5+ fixed function forward rendering engine
   struct Renderer
@@ -41,11 +64,25 @@ namespace glr
     
     GLRENDER_API ~Renderer();
 
-    /// Render a list of objects
+    /// Render a list of objects, the list is only read from and isn't copied
+    /// The view and projection matrices and the seconds since the renderer was created are uploaded once per call to a block any shader can read:
+    /// layout(std140, binding = 0) uniform Frame { mat4 view; mat4 projection; float time; };
     /// @param renderList A list of data that can be used to render something
     /// @param viewMat The view matrix
     /// @param projectionMat The projection matrix
-    GLRENDER_API void render(RenderList renderList, const mat4x4<float>& viewMat, const mat4x4<float>& projectionMat);
+    GLRENDER_API void render(const RenderList& renderList, const mat4x4<float>& viewMat, const mat4x4<float>& projectionMat);
+
+    /// Render the retained list that this renderer keeps across frames
+    /// @param viewMat The view matrix
+    /// @param projectionMat The projection matrix
+    GLRENDER_API void renderRetained(const mat4x4<float>& viewMat, const mat4x4<float>& projectionMat);
+
+    /// Hand a list over to the renderer to be kept across frames, replacing the current retained list
+    GLRENDER_API void setRetainedList(RenderList&& renderList);
+
+    /// The list kept by the renderer between frames, add, remove and update objects in it by handle instead of rebuilding it every frame
+    /// Objects are sorted again before drawing whenever their order changed, see ObjectStore::orderChanged(), call sort() after changing list entries
+    GLRENDER_API RenderList& retainedList();
 
     /// Call this when the OpenGL context has changed size
     /// @param width The new width
@@ -76,49 +113,225 @@ namespace glr
     /// Render the currently bound OpenGL objects, called by Renderer::render()
     /// @param mode The format the geometry is in
     /// @param numVerticies The number of vertices to render
-    GLRENDER_API void draw(GLRDrawMode mode, size_t numVerticies) const;
+    /// @param firstVertex The vertex to start from, see Mesh::baseVertex()
+    GLRENDER_API void draw(GLRDrawMode mode, size_t numVerticies, uint32_t firstVertex = 0) const;
 
     /// Render the currently bound OpenGL objects, called by Renderer::render()
     /// @param mode The format the geometry is in
     /// @param numIndices The number of indices to render
-    GLRENDER_API void drawIndexed(GLRDrawMode mode, size_t numIndices) const;
+    /// @param indexType The type of the bound index buffer
+    /// @param firstIndex The index to start from, see Mesh::firstIndex()
+    /// @param baseVertex Added to every index, see Mesh::baseVertex()
+    GLRENDER_API void drawIndexed(GLRDrawMode mode, size_t numIndices, GLRIndexBufferType indexType = GLRIndexBufferType::UINT, uint32_t firstIndex = 0, uint32_t baseVertex = 0) const;
+    
+    /// Render several instances of the currently bound OpenGL objects
+    /// @param mode The format the geometry is in
+    /// @param numVerticies The number of vertices to render per instance
+    /// @param instances The number of instances to render
+    /// @param baseInstance The index of the first instance's data in the instance buffer
+    /// @param firstVertex The vertex to start from, see Mesh::baseVertex()
+    GLRENDER_API void drawInstanced(GLRDrawMode mode, size_t numVerticies, size_t instances, uint32_t baseInstance, uint32_t firstVertex = 0) const;
+
+    /// Render several instances of the currently bound OpenGL objects
+    /// @param mode The format the geometry is in
+    /// @param numIndices The number of indices to render per instance
+    /// @param instances The number of instances to render
+    /// @param baseInstance The index of the first instance's data in the instance buffer
+    /// @param indexType The type of the bound index buffer
+    /// @param firstIndex The index to start from, see Mesh::firstIndex()
+    /// @param baseVertex Added to every index, see Mesh::baseVertex()
+    GLRENDER_API void drawIndexedInstanced(GLRDrawMode mode, size_t numIndices, size_t instances, uint32_t baseInstance, GLRIndexBufferType indexType = GLRIndexBufferType::UINT, uint32_t firstIndex = 0, uint32_t baseVertex = 0) const;
     
     /// Run the currently bound compute shader
     GLRENDER_API void startComputeShader(const vec2<uint32_t>& contextSize) const;
     
     uint32_t workSizeX = 40;
     uint32_t workSizeY = 20;
+
+    /// Collapse consecutive objects that share a mesh, shader and texture into one instanced draw, sort the RenderList first to get long runs
+    /// Shaders used by objects must then read their MVP from the instance buffer instead of the mvp uniform:
+    /// layout(std430, binding = 0) readonly buffer Instances { mat4 instanceMVP[]; };
+    /// gl_Position = instanceMVP[gl_BaseInstance + gl_InstanceID] * vec4(pos_in, 1.0);
+    /// Only used when no per-layer postprocessing is set
+    /// Objects using different layers of one array texture share a batch, their layers are streamed alongside the MVPs:
+    /// layout(std430, binding = 1) readonly buffer InstanceLayers { uint instanceLayer[]; };
+    bool instancedBatching = false;
+
+    /// With instanced batching, stop splitting batches by texture and stream each instance's ARB_bindless_texture handle instead:
+    /// layout(std430, binding = 2) readonly buffer InstanceTextures { sampler2D instanceTexture[]; };
+    /// Objects without a texture get the handle of a 1x1 white texture
+    /// Ignored when the driver doesn't support bindless textures
+    bool bindlessTextures = false;
+
+    /// Like instanced batching, but each run of batches that share a shader, texture and vertex array is submitted with one glMultiDraw*Indirect call,
+    /// the commands are written to a buffer and point at the same instance data, so shaders are written the same way as for instanced batching
+    /// Only meshes in the same geometry arena pool share a vertex array, see Mesh::arena, combine this with bindless textures for the longest runs
+    bool multiDrawIndirect = false;
+
+    /// Skip objects whose bounding sphere is entirely outside the view, see Mesh::boundingRadius()
+    /// Plain objects are tested together over the ObjectStore's transforms, other object renderables one at a time
+    /// When the ObjectStore has a spatial index only the objects it returns for the view volume are tested
+    bool frustumCulling = false;
+
+    /// Threads to split the ObjectStore's culling tests between
+    uint32_t cullingThreads = 1;
+
+    /// With frustum culling and multi-draw indirect, test instances in a compute shader and let the GPU compact the visible ones, needs OpenGL 4.6
+    /// Instances in a multi-draw may then be drawn in any order, so leave this off where overlapping objects rely on draw order
+    bool gpuCulling = false;
+
+    /// How many objects the CPU tested and kept during the last render()
+    [[nodiscard]] GLRENDER_API CullStats cullStats() const;
+
+    /// How many instances the GPU tested and kept, from the latest frame it has finished, usually a frame or two behind
+    [[nodiscard]] GLRENDER_API CullStats gpuCullStats() const;
+
+    /// GL state changes made during the last render(), and how many of them the state cache filtered out, see StateCache
+    [[nodiscard]] GLRENDER_API StateCacheStats stateStats() const;
+
+    /// Time render() may spend each frame creating assets queued from other threads, see asset_repo::createQueued()
+    std::chrono::microseconds assetCreationBudget{2000};
+
+    /// Streams texture uploads queued from any thread, render() issues them after creating queued assets
+    TextureStreamer textureStreamer{};
     
     private:
     void pingPong();
+    void useTexture(ID texture, ID& currentTexture) const;
     void renderWithoutLayerPost(const RenderList& rl, ID& currentTexture);
-    void renderWithLayerPost(RenderList& rl, ID& currentTexture);
+    void renderWithLayerPost(const RenderList& rl, ID& currentTexture);
     void postProcessGlobal();
     void postProcessLayer(uint64_t layer);
     void drawToScratch() const;
     void drawToBackBuffer() const;
     void scratchToPingPong();
     void drawRenderable(const Renderable& entry);
+    void drawObject(const TransformComp& transform, ID mesh, ID shader, uint32_t textureLayer);
+    void addInstance(const TransformComp& transform, ID mesh, ID shader, ID texture, uint32_t textureLayer);
+    void drawInstances(ID& currentTexture);
+    void drawInstancesIndirect(ID& currentTexture);
+    bool gpuCullingActive() const;
+    void cullObjects(const ObjectStore& objects);
+    bool objectCulled(size_t object) const;
+    bool entryCulled(const Renderable& entry);
+    void flushText(ID& currentTexture);
+    void uploadFrameUniforms();
+
+    struct StreamedBuffer
+    {
+      uint32_t handle = INVALID_HANDLE;
+      size_t capacity = 0;
+    };
+
+    static void streamData(StreamedBuffer& buffer, const void* data, size_t size);
+    static void streamInstanceData(StreamedBuffer& buffer, const void* data, size_t size, uint32_t binding);
+
+    struct InstanceBatch
+    {
+      ID mesh = INVALID_ID;
+      ID shader = INVALID_ID;
+      ID texture = INVALID_ID;
+      uint32_t first = 0;
+      uint32_t count = 0;
+    };
 
     vec2<uint32_t> contextSize{};
+    int32_t backBufferSamples = 0;
     
     GLRFilterMode filterModeMin{};
     GLRFilterMode filterModeMag{};
     
+    RenderList retained{};
+    
     std::shared_ptr<PostStack> globalPostStack = nullptr;
     std::unordered_map<uint64_t, std::shared_ptr<PostStack>> layerPostStack{};
+
+    //Object shaders and the slots of the uniforms set per draw, looked up again when shaderRevision() changes
+    struct ObjectShader
+    {
+      Shader* shader = nullptr;
+      uint32_t mvp = 0;
+      uint32_t textureLayer = 0;
+    };
+    const ObjectShader* resolveObjectShader(ID shader);
+    std::unordered_map<ID, ObjectShader> objectShaders{};
+    uint64_t objectShaderRevision = 0;
     
     mat4x4<float> model{};
     mat4x4<float> view{};
     mat4x4<float> projection{};
     mat4x4<float> mvp{};
+    
+    UniformBlock frameUniforms{GLRBlockType::UNIFORM};
+    std::chrono::steady_clock::time_point startTime{};
 
     Alternator curFBO{};
     Framebuffer fboA{};
     Framebuffer fboB{};
     Framebuffer scratch{};
     
+    //Laid out as glMultiDraw*Indirect reads them
+    struct DrawElementsIndirectCommand
+    {
+      uint32_t count = 0;
+      uint32_t instanceCount = 0;
+      uint32_t firstIndex = 0;
+      int32_t baseVertex = 0;
+      uint32_t baseInstance = 0;
+    };
+
+    struct DrawArraysIndirectCommand
+    {
+      uint32_t count = 0;
+      uint32_t instanceCount = 0;
+      uint32_t first = 0;
+      uint32_t baseInstance = 0;
+    };
+
+    struct MultiDraw
+    {
+      ID mesh = INVALID_ID; //Any mesh in the run, used to bind the shared vertex array
+      ID shader = INVALID_ID;
+      ID texture = INVALID_ID;
+      uint32_t vertexArray = INVALID_HANDLE;
+      GLRDrawMode mode = GLRDrawMode::TRIS;
+      GLRIndexBufferType indexType = GLRIndexBufferType::UINT;
+      bool indexed = false;
+      uint32_t firstCommand = 0;
+      uint32_t count = 0;
+    };
+
+    std::vector<InstanceBatch> instanceBatches{};
+    std::vector<InstanceData> instances{};
+    std::vector<uint32_t> instanceLayers{};
+    std::vector<uint64_t> instanceTextures{};
+    StreamedBuffer instanceBuffer{};
+    StreamedBuffer instanceLayerBuffer{};
+    StreamedBuffer instanceTextureBuffer{};
+    
+    std::vector<MultiDraw> multiDraws{};
+    std::vector<DrawElementsIndirectCommand> elementCommands{};
+    std::vector<DrawArraysIndirectCommand> arrayCommands{};
+    StreamedBuffer elementCommandBuffer{};
+    StreamedBuffer arrayCommandBuffer{};
+    
+    Frustum frustum{};
+    CullStats cpuCullStats{};
+    StateCacheStats frameStateStats{};
+    std::vector<uint8_t> objectVisible{}; //Empty when objects aren't culled on the CPU
+    std::vector<float> cullX{};
+    std::vector<float> cullY{};
+    std::vector<float> cullZ{};
+    std::vector<float> cullRadius{};
+    std::vector<ID> cullCandidates{}; //Objects returned by the store's spatial index
+    std::vector<vec4<float>> instanceSpheres{};
+    std::vector<GpuCullInput> cullInputs{};
+    std::unique_ptr<GpuCuller> gpuCuller{};
+    
+    TextBatcher textBatcher{};
+    
     std::unique_ptr<Mesh> fullscreenQuad{};
     std::unique_ptr<Shader> shaderTransfer{};
+    std::unique_ptr<Texture> fallbackTexture{}; //Sampled by bindless instances without a texture, shaders can't sample a handle of 0
   };
 }
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "export.hh"
+#include "glrUtil.hh"
+#include "glrEnums.hh"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace glr
+{
+  //Starting sizes of a pool's shared buffers, they double whenever an allocation doesn't fit
+  inline constexpr uint32_t GEOMETRY_ARENA_INITIAL_VERTICES = 64 * 1024;
+  inline constexpr uint32_t GEOMETRY_ARENA_INITIAL_INDICES = 192 * 1024;
+
+  /// One attribute of an interleaved vertex, see Mesh
+  struct ArenaAttribute
+  {
+    int32_t location = 0;
+    int32_t elements = 0;
+    GLRAttribFormat format = GLRAttribFormat::FLOAT;
+    uint32_t offset = 0;
+
+    bool operator==(const ArenaAttribute& other) const = default;
+  };
+
+  /// The vertex layout of a pool, meshes with equal layouts share its buffers and vertex array
+  struct ArenaLayout
+  {
+    std::vector<ArenaAttribute> attributes{};
+    uint32_t stride = 0;
+
+    bool operator==(const ArenaLayout& other) const = default;
+  };
+
+  /// Where a mesh's data lives inside a pool, draw it with baseVertex and firstIndex after binding the pool's vertex array
+  struct ArenaAllocation
+  {
+    uint32_t pool = UINT32_MAX;
+    uint32_t baseVertex = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+
+    [[nodiscard]] bool valid() const
+    {
+      return this->pool != UINT32_MAX;
+    }
+  };
+
+  /// Suballocates the vertices and 32 bit indices of many meshes out of a few large buffers, one vertex buffer and one index buffer per vertex layout
+  /// Meshes in the same pool share a vertex array, so switching between them needs no rebinding, only a different base vertex and first index
+  /// Free space is kept in a first fit free list per buffer, neighbouring free ranges are merged when an allocation is freed
+  /// All functions must be called on the GL thread
+  struct GeometryArena
+  {
+    GLRENDER_API GeometryArena() = default;
+    GLRENDER_API ~GeometryArena();
+
+    GeometryArena(GeometryArena const &copyFrom) = delete;
+    GeometryArena& operator=(GeometryArena const &copyFrom) = delete;
+
+    /// Copy a mesh's vertices and indices into the pool for its layout, creating or growing the pool as needed
+    /// @param vertices vertexCount interleaved vertices laid out as described by layout
+    /// @param indices Nullable, relative to the mesh's first vertex
+    GLRENDER_API ArenaAllocation allocate(const ArenaLayout& layout, const uint8_t* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+
+    /// Hand an allocation's space back to its pool
+    GLRENDER_API void free(const ArenaAllocation& allocation);
+
+    /// The vertex array shared by every mesh in a pool, its attribute formats are set by the meshes themselves
+    [[nodiscard]] GLRENDER_API uint32_t vertexArray(uint32_t pool) const;
+
+    /// Delete every pool, meshes allocated from them must be deleted first
+    GLRENDER_API void clear();
+
+    /// The free space of one of a pool's buffers, in vertices or indices
+    struct FreeList
+    {
+      /// Take count elements from the first free range big enough to hold them
+      /// @return False if no range is big enough
+      GLRENDER_API bool take(uint32_t count, uint32_t& offset);
+
+      /// Hand elements back, merging them with the free ranges they touch
+      GLRENDER_API void give(uint32_t offset, uint32_t count);
+
+      /// Add the space between the old and new capacity to the end of the list
+      GLRENDER_API void grow(uint32_t newCapacity);
+
+      std::map<uint32_t, uint32_t> ranges{}; //Offset to count
+      uint32_t capacity = 0;
+    };
+
+    private:
+    struct Pool
+    {
+      ArenaLayout layout{};
+      uint32_t vertexArray = INVALID_HANDLE;
+      uint32_t vertexBuffer = INVALID_HANDLE;
+      uint32_t indexBuffer = INVALID_HANDLE;
+      FreeList vertices{};
+      FreeList indices{};
+    };
+
+    uint32_t findPool(const ArenaLayout& layout);
+    static void growBuffer(uint32_t& buffer, size_t oldSize, size_t newSize);
+    void growVertices(Pool& pool, uint32_t needed);
+    void growIndices(Pool& pool, uint32_t needed);
+
+    std::vector<Pool> pools{};
+  };
+
+  /// The arena meshes with Mesh::arena set are finalized into
+  GLRENDER_API GeometryArena& geometryArena();
+}
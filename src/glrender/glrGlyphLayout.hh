@@ -0,0 +1,82 @@
+#pragma once
+
+#include "export.hh"
+#include "glrAssetID.hh"
+#include "glrAtlas.hh"
+#include "glrColor.hh"
+
+#include <commons/math/vec2.hh>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace glr
+{
+  /// Pack a color as RGBA8 with red in the lowest byte, the layout normalized GL_UNSIGNED_BYTE vertex attributes expect
+  [[nodiscard]] GLRENDER_API uint32_t packColor(const Color& color);
+
+  /// One glyph of a laid out string, the string starts at the origin and each new line is fontSize further down
+  struct LaidOutGlyph
+  {
+    vec2<float> pos{}; //Lower left corner
+    vec2<float> size{};
+    QuadUVs uvs{};
+    uint32_t color = 0; //See packColor()
+  };
+
+  /// A string laid out against an atlas, ready to be turned into quads
+  struct GlyphRun
+  {
+    std::vector<LaidOutGlyph> glyphs{};
+    vec2<float> extent{}; //Width of the longest line and total height
+  };
+
+  struct GlyphLayoutKey
+  {
+    std::string text{};
+    ID atlas = INVALID_ID;
+    float fontSize = 1.0f;
+    Color color{};
+
+    GLRENDER_API bool operator==(const GlyphLayoutKey& other) const;
+  };
+
+  /// Laid out strings keyed on their content, atlas, font size and color
+  /// A string is laid out once and shared by everything that shows it until it stops being used
+  struct GlyphLayoutCache
+  {
+    /// Get the layout of a string, laying it out first if it isn't cached
+    /// Every character is looked up as the atlas tile named after it, missing characters leave a half width gap
+    /// Glyphs are fontSize tall and keep the aspect ratio of their tile
+    /// @param frame The current frame, used by trim() to find layouts that are no longer used
+    /// @return A reference that stays valid until the layout is trimmed or the cache is cleared
+    GLRENDER_API const GlyphRun& get(const GlyphLayoutKey& key, uint64_t frame);
+
+    /// Mark a cached layout as used on the given frame without laying it out, does nothing if it isn't cached
+    GLRENDER_API void touch(const GlyphLayoutKey& key, uint64_t frame);
+
+    /// Drop layouts that haven't been requested or touched since the given frame
+    GLRENDER_API void trim(uint64_t oldestFrame);
+
+    GLRENDER_API void clear();
+    [[nodiscard]] GLRENDER_API size_t size() const;
+
+    private:
+    struct Entry
+    {
+      GlyphRun run{};
+      uint64_t lastUsed = 0;
+    };
+
+    struct KeyHash
+    {
+      size_t operator()(const GlyphLayoutKey& key) const;
+    };
+
+    std::unordered_map<GlyphLayoutKey, Entry, KeyHash> layouts{};
+  };
+
+  /// Lay out a string without caching it, see GlyphLayoutCache::get()
+  GLRENDER_API GlyphRun layoutGlyphs(const GlyphLayoutKey& key);
+}
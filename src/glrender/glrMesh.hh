@@ -4,15 +4,20 @@
 #include "glrUtil.hh"
 #include "glrEnums.hh"
 #include "glrLogging.hh"
+#include "glrGeometryArena.hh"
 
 #include <commons/math/vec2.hh>
+#include <array>
 #include <cstdint>
+#include <vector>
 
 namespace glr
 {
-  //TODO instanced rendering?
-  //TODO interleaved buffer option
-  //TODO dynamic changing of buffer data
+  //Number of copies of a dynamic mesh's buffers, so updates never write to one the GPU may still be drawing from
+  inline constexpr uint32_t MESH_DYNAMIC_REGIONS = 3;
+
+  struct VertexAttribute;
+
   struct Mesh
   {
     GLRENDER_API Mesh() = default;
@@ -56,17 +61,55 @@ namespace glr
     /// @param callback The error/warning/info handling callback, this called when something goes wrong.  Nullable.
     GLRENDER_API Mesh* addColors(const float* colors, size_t colorsSize, const LoggingCallback& callback = nullptr);
 
-    /// Interleave all the vertex data upload it to the GPU, and lock the Mesh
+    /// Overwrite or extend vertex positions starting at an element offset, growing the mesh if they run past the end
+    /// Works on dynamic meshes after they've been finalized, the change reaches the GPU the next time the mesh is used
+    /// @param firstElement The index of the first float to overwrite
+    GLRENDER_API Mesh* setPositions(const float* positions, size_t positionsSize, size_t firstElement = 0, const LoggingCallback& callback = nullptr);
+    GLRENDER_API Mesh* setUVs(const float* uvs, size_t uvsSize, size_t firstElement = 0, const LoggingCallback& callback = nullptr);
+    GLRENDER_API Mesh* setNormals(const float* normals, size_t normalsSize, size_t firstElement = 0, const LoggingCallback& callback = nullptr);
+    GLRENDER_API Mesh* setColors(const float* colors, size_t colorsSize, size_t firstElement = 0, const LoggingCallback& callback = nullptr);
+    GLRENDER_API Mesh* setIndices(const uint32_t* indices, size_t indicesSize, size_t firstIndex = 0, const LoggingCallback& callback = nullptr);
+
+    /// Change the number of vertices and indices drawn, new vertices and indices are zeroed
+    GLRENDER_API Mesh* resize(size_t vertices, size_t indices, const LoggingCallback& callback = nullptr);
+
+    /// Upload all the vertex data to the GPU and lock the Mesh, unless it's dynamic
+    /// With an INTERLEAVED buffer type every attribute of a vertex is packed together in one buffer, in the order position, UV, normal, color,
+    /// vertices missing an attribute that others have get zeroes. SEPARATE gives every attribute its own buffer
     /// @param callback The error/warning/info handling callback, this is given information about what occured when something goes wrong
     GLRENDER_API void finalize(const LoggingCallback& callback = nullptr);
 
-    /// Bind the mesh's vertex array for use after it's been finalized
+    /// Bind the mesh's vertex array for use after it's been finalized, sending any changes made to a dynamic mesh first
     GLRENDER_API void use() const;
 
     GLRENDER_API bool isFinalized() const;
     GLRENDER_API bool isIndexed() const;
 
-    GLRBufferType bufferType = GLRBufferType::SEPARATE;
+    /// The vertex array use() binds, shared by every mesh in the same geometry arena pool
+    [[nodiscard]] GLRENDER_API uint32_t vertexArray() const;
+
+    /// Distance from the mesh's origin to its furthest vertex, used for culling
+    [[nodiscard]] GLRENDER_API float boundingRadius() const;
+
+    /// Where the mesh's vertices start in its vertex buffer, only non-zero for arena meshes
+    [[nodiscard]] GLRENDER_API uint32_t baseVertex() const;
+
+    /// Where the mesh's indices start in its index buffer, only non-zero for arena meshes
+    [[nodiscard]] GLRENDER_API uint32_t firstIndex() const;
+
+    GLRBufferType bufferType = GLRBufferType::INTERLEAVED;
+    
+    //How each attribute is stored on the GPU, data is always given as floats and converted by finalize()
+    //UNORM8 and UNORM16 suit colors and UVs in the 0-1 range, SNORM_2_10_10_10 suits normals, formats shaders still read as floats
+    //Colors have four elements, so SNORM_2_10_10_10 colors are stored as UNORM8
+    GLRAttribFormat positionFormat = GLRAttribFormat::FLOAT;
+    GLRAttribFormat uvFormat = GLRAttribFormat::FLOAT;
+    GLRAttribFormat normalFormat = GLRAttribFormat::FLOAT;
+    GLRAttribFormat colorFormat = GLRAttribFormat::FLOAT;
+    
+    //Store indices as 16 bit when every index fits, check indexType after finalizing to see which was used
+    bool compactIndices = true;
+    GLRIndexBufferType indexType = GLRIndexBufferType::UINT;
     GLRDrawType drawType = GLRDrawType::STATIC_DRAW;
     GLRDrawMode drawMode = GLRDrawMode::TRIS;
 
@@ -81,9 +124,56 @@ namespace glr
     //Whether to clear the buffer data from RAM after the Mesh is finalized
     bool retainBufferData = false;
     
+    //Set before finalizing to keep the mesh editable through the set functions and resize()
+    //Dynamic meshes are always interleaved with 32 bit indices and keep their data in RAM, the GPU copy lives in persistently mapped buffers
+    //that are cycled through and fenced, only the ranges that changed are written, and they grow by doubling when the mesh outgrows them
+    bool dynamic = false;
+    
+    //Set before finalizing to put the mesh's data in geometryArena() instead of buffers of its own
+    //Arena meshes are always interleaved with 32 bit indices, meshes with the same attributes and formats share a vertex array and draw with a base vertex and first index
+    //Ignored for dynamic meshes
+    bool arena = false;
+    
     private:
+    struct DynamicRegion
+    {
+      uint32_t vertexBuffer = INVALID_HANDLE;
+      uint32_t indexBuffer = INVALID_HANDLE;
+      uint8_t* vertices = nullptr;
+      uint32_t* indices = nullptr;
+      void* fence = nullptr; //GLsync
+      
+      //Ranges changed since this region was last written, empty when begin == end
+      size_t vertexBegin = 0;
+      size_t vertexEnd = 0;
+      size_t indexBegin = 0;
+      size_t indexEnd = 0;
+    };
+    
+    std::vector<VertexAttribute> attributes() const;
+    Mesh* setElements(std::vector<float>& target, bool& present, int32_t elements, const float* data, size_t size, size_t firstElement, const char* name, const LoggingCallback& callback);
+    void markDirty(size_t firstVertex, size_t lastVertex, size_t firstIndex, size_t lastIndex);
+    void growDynamic() const;
+    void commitDynamic() const;
+    void deleteDynamic() const;
+    bool finalizeInArena(const std::vector<VertexAttribute>& attributes); //False if the arena couldn't take the mesh
+    void releaseBufferData();
+    void growRadius(const float* positions, size_t size);
+    
+    //The GPU copy of a dynamic mesh, brought up to date by use()
+    mutable std::array<DynamicRegion, MESH_DYNAMIC_REGIONS> regions{};
+    mutable uint32_t region = 0;
+    mutable size_t vertexCapacity = 0;
+    mutable size_t indexCapacity = 0;
+    size_t vertexStride = 0;
+    mutable bool dynamicDirty = false;
+    
+    ArenaAllocation arenaAllocation{};
+    float radius = 0.0f;
+    
     uint32_t vertexArrayHandle = INVALID_HANDLE;
     uint32_t indexBufferHandle = INVALID_HANDLE;
+    uint32_t vertexBufferHandle = INVALID_HANDLE; //Interleaved
     uint32_t positionBufferHandle = INVALID_HANDLE;
     uint32_t normalBufferHandle = INVALID_HANDLE;
     uint32_t uvBufferHandle = INVALID_HANDLE;
@@ -112,4 +202,15 @@ namespace glr
     constexpr static int32_t UV_STRIDE = UV_ELEMENTS * sizeof(float);
     constexpr static int32_t COLOR_STRIDE = COLOR_ELEMENTS * sizeof(float);
   };
+
+  /// Incremented whenever any mesh's bounding radius grows or a mesh is moved
+  /// Anything that stores bounds built from boundingRadius() should rebuild them when this changes
+  [[nodiscard]] GLRENDER_API uint64_t meshBoundsRevision();
+
+  /// Convert to a 16 bit float as stored for GLRAttribFormat::HALF_FLOAT, rounding to nearest
+  /// Values outside the half range become infinity and values too small for a normal half become zero
+  [[nodiscard]] GLRENDER_API uint16_t floatToHalf(float value);
+
+  /// Pack three values in [-1, 1] into one word as stored for GLRAttribFormat::SNORM_2_10_10_10, x in the lowest bits and w left at 0
+  [[nodiscard]] GLRENDER_API uint32_t packSnorm10(const float* value);
 }
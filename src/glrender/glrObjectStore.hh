@@ -0,0 +1,113 @@
+#pragma once
+
+#include "export.hh"
+#include "glrAssetID.hh"
+#include "glrRenderable.hh"
+#include "glrSpatialIndex.hh"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace glr
+{
+  /// Structure-of-arrays storage for plain object renderables (transform, layer, texture, mesh and shader)
+  /// Each component lives in its own contiguous array, entities are addressed through a handle that stays valid across removals
+  struct ObjectStore
+  {
+    ObjectStore() = default;
+    GLRENDER_API ObjectStore(const ObjectStore& copyFrom);
+    GLRENDER_API ObjectStore& operator=(const ObjectStore& copyFrom);
+    ObjectStore(ObjectStore&& moveFrom) noexcept = default;
+    ObjectStore& operator=(ObjectStore&& moveFrom) noexcept = default;
+
+    /// Add an object to the store
+    /// With a spatial index set this reads the mesh's bounding radius from asset_repo, so call it on the thread that uses asset_repo
+    /// @return A handle that can be used to modify or remove the object later
+    GLRENDER_API ID add(const TransformComp& transform, const LayerComp& layer, ID texture, ID mesh, ID shader, uint32_t textureLayer = 0);
+
+    /// Remove an object, the last object in the store is moved into its place
+    GLRENDER_API void remove(ID handle);
+
+    /// Append copies of all objects in another store, the copies are given new handles
+    GLRENDER_API void append(const ObjectStore& other);
+
+    /// Pre-allocate space for the given number of objects
+    GLRENDER_API void reserve(size_t amount);
+
+    /// Remove all objects and invalidate all handles, allocated memory and handle slots are kept for reuse
+    GLRENDER_API void clear();
+
+    [[nodiscard]] GLRENDER_API bool contains(ID handle) const;
+    [[nodiscard]] GLRENDER_API bool empty() const;
+    [[nodiscard]] GLRENDER_API size_t size() const;
+
+    /// Get the position of an object in the component arrays, this changes when objects are removed or sorted
+    /// @return size() or more when the handle doesn't refer to an object in this store
+    [[nodiscard]] GLRENDER_API size_t indexOf(ID handle) const;
+
+    /// Nullptr when the handle doesn't refer to an object in this store
+    /// Call refit() after moving an object through the returned pointer when a spatial index is set
+    /// Handing out an object's layer marks the store as out of order, see orderChanged()
+    [[nodiscard]] GLRENDER_API TransformComp* transform(ID handle);
+    [[nodiscard]] GLRENDER_API LayerComp* layer(ID handle);
+    GLRENDER_API void setTexture(ID handle, ID texture);
+    GLRENDER_API void setMesh(ID handle, ID mesh);
+    GLRENDER_API void setShader(ID handle, ID shader);
+    GLRENDER_API void setTextureLayer(ID handle, uint32_t textureLayer);
+
+    /// Move an object, keeping the spatial index up to date
+    GLRENDER_API void setTransform(ID handle, const TransformComp& transform);
+
+    /// Update an object's entry in the spatial index after its transform was changed directly
+    GLRENDER_API void refit(ID handle);
+
+    /// Keep the objects in a spatial index so culling and picking don't have to test every object, objects already in the store are added to it
+    /// @param spatialIndex Nullable, removes the current index
+    GLRENDER_API void setSpatialIndex(std::unique_ptr<SpatialIndex> spatialIndex);
+
+    /// Nullptr when no index is set, query the store rather than the index so bounds are brought up to date first
+    [[nodiscard]] GLRENDER_API const SpatialIndex* spatialIndex() const;
+
+    /// Append the handles of objects whose bounds may overlap the given bounds, every object is tested when no spatial index is set
+    /// Objects are refit first whenever a mesh's bounds changed since the last query, see meshBoundsRevision()
+    GLRENDER_API void query(const Bounds& bounds, std::vector<ID>& out) const;
+
+    /// Reorder the component arrays, order[i] is the current index of the object that should end up at index i
+    GLRENDER_API void permute(const std::vector<uint32_t>& order);
+
+    /// True when objects were added or removed or had their layer handed out since the arrays were last reordered by permute()
+    /// The objects may no longer be in layer order until they're sorted again
+    [[nodiscard]] GLRENDER_API bool orderChanged() const;
+
+    //Component arrays, these are all the same length and are indexed together
+    //Read them freely, but add and remove objects through the functions above so handles stay valid
+    std::vector<TransformComp> transforms{};
+    std::vector<LayerComp> layers{};
+    std::vector<ID> textures{};
+    std::vector<ID> meshes{};
+    std::vector<ID> shaders{};
+    std::vector<ID> handles{};
+    std::vector<uint32_t> textureLayers{}; //Layer of each object's texture when it's an array texture
+
+    private:
+    static constexpr uint32_t FREE_SLOT = std::numeric_limits<uint32_t>::max();
+
+    [[nodiscard]] size_t slotOf(ID handle) const;
+    void refreshBounds() const;
+
+    std::vector<uint32_t> slots{}; //Handle slot -> array index
+    std::vector<uint32_t> generations{}; //Handle slot -> generation, used to detect stale handles
+    std::vector<uint32_t> freeSlots{};
+    std::unique_ptr<SpatialIndex> objectIndex{};
+    mutable uint64_t boundsRevision = 0; //meshBoundsRevision() when the index was last refit
+    bool reordered = false; //See orderChanged()
+
+    //Reused between calls to permute()
+    std::vector<TransformComp> scratchTransforms{};
+    std::vector<LayerComp> scratchLayers{};
+    std::vector<ID> scratchIDs{};
+    std::vector<uint32_t> scratchTextureLayers{};
+  };
+}
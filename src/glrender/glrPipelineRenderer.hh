@@ -4,11 +4,18 @@
 #include "glrAssetID.hh"
 #include "glrEnums.hh"
 #include "glrLogging.hh"
+#include "glrStateCache.hh"
 
 #include <commons/math/vec4.hh>
 #include <commons/math/mat3.hh>
 #include <commons/math/mat4.hh>
+#include <chrono>
 #include <functional>
+#include <limits>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace glr
 {
@@ -17,6 +24,7 @@ namespace glr
   //typedef void (*GLLoadFunc)(const char* name);
   
   struct PipelineRenderer;
+  struct Shader;
   
   /// A list of instructions to execute in order to render things
   struct Pipeline
@@ -25,7 +33,7 @@ namespace glr
 
     using MatrixCallback = std::function<mat4x4<float>()>;
     
-    GLRENDER_API Pipeline();
+    GLRENDER_API Pipeline() = default;
 
     //Instruction recording
     GLRENDER_API void setModelMatrix(const MatrixCallback& callback);
@@ -77,6 +85,11 @@ namespace glr
     GLRENDER_API void draw(GLRDrawMode a, uint64_t numVertices);
     GLRENDER_API void drawIndexed(GLRDrawMode a, uint64_t numIndices, GLRIndexBufferType b);
     
+    /// Lower the recorded instructions into the compact stream that's executed when rendering
+    /// Called when the pipeline is added to a renderer, instructions recorded afterwards need another compile
+    GLRENDER_API void compile();
+    [[nodiscard]] GLRENDER_API bool isCompiled() const;
+    
     //Settings
     uint32_t workSizeX = 40;
     uint32_t workSizeY = 20;
@@ -139,14 +152,48 @@ namespace glr
       } data;
     };
 
-    std::vector<Instruction> instructions{};
+    /// An Instruction after compile(), what each operand means depends on the opcode
+    struct CompiledInstruction
+    {
+      OpCode op = OpCode::INVALID;
+      uint16_t enumA = 0;
+      uint16_t enumB = 0;
+      uint16_t enumC = 0;
+      uint32_t target = 0; //Binding target, or index into uniformBindings for uniform opcodes
+      uint32_t id = 0; //Index into ids
+      uint32_t operand = 0; //Byte offset into dataArena, or index into matrixCallbacks for matrix opcodes
+    };
+    static_assert(sizeof(CompiledInstruction) == 20);
+    
+    /// Append an instruction, the pipeline then needs compiling again
+    template <typename... Args> void record(Args&&... args);
+    uint32_t compileID(ID id, std::unordered_map<ID, uint32_t>& lookup);
+    uint32_t compileUniform(uint32_t shader, const std::string& name, std::map<std::pair<uint32_t, std::string>, uint32_t>& lookup);
+    template <typename T> uint32_t compileData(const T& value);
+    template <typename T> [[nodiscard]] T readData(uint32_t offset) const;
+
+    std::vector<Instruction> instructions{}; //As recorded
+    bool compiled = false; //False once an instruction is recorded after the last compile()
     
-    std::vector<ID> currentTexture{}; //Bound texture array, size is set to OpenGL's max textures per shader stage
-    ID currentShader = INVALID_ID;
-    ID currentMesh = INVALID_ID;
-    ID currentFramebuffer = INVALID_ID;
-    ID currentAttachment = INVALID_ID;
-    ID currentShaderPipeline = INVALID_ID;
+    //Compiled
+    std::vector<CompiledInstruction> program{};
+    std::vector<ID> ids{};
+    /// A shader uniform written by the pipeline, resolved to a slot in the shader ahead of time
+    struct UniformBinding
+    {
+      uint32_t shader = 0; //Index into ids
+      std::string name{};
+      Shader* resolved = nullptr;
+      uint32_t slot = 0;
+    };
+    
+    /// Look up every uniform's shader and slot again, done when compiled and whenever shaderRevision() changes
+    void resolveUniforms();
+    
+    std::vector<UniformBinding> uniformBindings{};
+    uint64_t resolvedRevision = std::numeric_limits<uint64_t>::max();
+    std::vector<MatrixCallback> matrixCallbacks{};
+    std::vector<uint8_t> dataArena{};
   };
   
   /// OpenGL 4.5+ modular forward rendering engine
@@ -157,6 +204,12 @@ namespace glr
     GLRENDER_API void usePipeline(ID pipeline);
     GLRENDER_API void render();
 
+    /// GL state changes made during the last render(), and how many of them the state cache filtered out, see StateCache
+    [[nodiscard]] GLRENDER_API StateCacheStats stateStats() const;
+
+    /// Time render() may spend each frame creating assets queued from other threads, see asset_repo::createQueued()
+    std::chrono::microseconds assetCreationBudget{2000};
+
     uint32_t contextSizeX = 800;
     uint32_t contextSizeY = 600;
     int32_t maxTextureUnitsPerStage = 0;
@@ -171,6 +224,7 @@ namespace glr
     
     private:
     ID currentPipeline = INVALID_ID;
+    StateCacheStats frameStateStats{};
 
     ID lastPipeline = 0;
     std::unordered_map<ID, Pipeline> pipelines{};
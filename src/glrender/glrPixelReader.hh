@@ -0,0 +1,85 @@
+#pragma once
+
+#include "export.hh"
+#include "glrAssetID.hh"
+#include "glrUtil.hh"
+
+#include <cstdint>
+#include <vector>
+
+namespace glr
+{
+  /// Refers to one readback started by a PixelReader, 0 is never valid
+  using ReadbackHandle = uint64_t;
+
+  /// Pixels of a finished readback, read straight from the mapped buffer they were copied into
+  /// data stays valid until the readback is released, rows are tightly packed from the bottom of the image up
+  struct ReadbackView
+  {
+    const uint8_t* data = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t channels = 0;
+  };
+
+  /// Reads pixels back from the GPU without stalling, through a set of persistently mapped pixel pack buffers
+  /// Starting a readback only queues a copy into one of the buffers, the pixels can be looked at once the GPU gets to it,
+  /// usually a frame or two later, and the buffer is reused once the readback is released
+  /// All functions must be called on the GL thread
+  struct PixelReader
+  {
+    /// @param framesInFlight The number of readbacks that can be held at once
+    GLRENDER_API explicit PixelReader(uint32_t framesInFlight = 3);
+    GLRENDER_API ~PixelReader();
+
+    PixelReader(PixelReader const &copyFrom) = delete;
+    PixelReader& operator=(PixelReader const &copyFrom) = delete;
+
+    /// Start reading a region of the framebuffer bound for reading
+    /// @param channels 1, 2, 3 or 4
+    /// @return 0 if every buffer is still held by an unreleased readback, or the region is empty
+    [[nodiscard]] GLRENDER_API ReadbackHandle readFramebuffer(uint32_t xPos, uint32_t yPos, uint32_t width, uint32_t height, uint8_t channels);
+
+    /// Start reading the whole of a texture's first mip level
+    /// @param channels 1, 2, 3 or 4
+    /// @return 0 if every buffer is still held by an unreleased readback, or the texture doesn't exist or is empty
+    [[nodiscard]] GLRENDER_API ReadbackHandle readTexture(ID texture, uint8_t channels);
+
+    /// True once the GPU has finished copying a readback's pixels, never blocks
+    [[nodiscard]] GLRENDER_API bool isReady(ReadbackHandle readback);
+
+    /// Get a readback's pixels
+    /// @param wait Block until the copy has finished instead of returning an empty view
+    /// @return An empty view if the readback isn't ready or the handle is stale
+    [[nodiscard]] GLRENDER_API ReadbackView get(ReadbackHandle readback, bool wait = false);
+
+    /// Hand a readback's buffer back to be reused, the handle and any view of it become invalid
+    GLRENDER_API void release(ReadbackHandle readback);
+
+    private:
+    enum struct SlotState
+    {
+      FREE, PENDING, READY
+    };
+
+    struct Slot
+    {
+      uint32_t buffer = INVALID_HANDLE;
+      uint8_t* mapped = nullptr;
+      size_t capacity = 0;
+      void* fence = nullptr; //GLsync
+      uint32_t generation = 1;
+      SlotState state = SlotState::FREE;
+      uint32_t width = 0;
+      uint32_t height = 0;
+      uint8_t channels = 0;
+    };
+
+    Slot* begin(uint32_t width, uint32_t height, uint8_t channels, uint32_t& index);
+    ReadbackHandle finish(Slot& slot, uint32_t index);
+    Slot* find(ReadbackHandle readback);
+    bool poll(Slot& slot, bool wait);
+
+    std::vector<Slot> slots{};
+  };
+}
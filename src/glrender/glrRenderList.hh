@@ -2,6 +2,7 @@
 
 #include "export.hh"
 #include "glrRenderable.hh"
+#include "glrObjectStore.hh"
 #include "glrShaderPipeline.hh"
 
 #include <functional>
@@ -10,6 +11,7 @@
 namespace glr
 {
   /// A sortable container for Renderables
+  /// Plain objects can also be stored in objects, which keeps their components in contiguous arrays instead of individually allocated Renderables
   struct RenderList
   {
     GLRENDER_API RenderList() = default;
@@ -34,14 +36,25 @@ namespace glr
     GLRENDER_API void add(Renderable renderable);
     GLRENDER_API void add(std::initializer_list<Renderable> renderables);
     
-    /// Clear the render list
+    /// Clear the render list, including objects, allocated memory is kept for reuse
     GLRENDER_API void clear();
     
     /// Clear the render list and delete the pipeline
     GLRENDER_API void reset();
     
-    GLRENDER_API void sort(const Comparator& cmp = renderableComparator);
+    /// Sort Renderables and objects by their packed sort keys (layer, sublayer, shader, texture, mesh) using a radix sort
+    /// Keys are built from asset IDs, so the asset repository isn't consulted while sorting
+    /// Lists with layers too large for a key, see sortKeyLayerFits(), are sorted by their full layers with a comparison sort instead
+    GLRENDER_API void sort();
+    
+    /// Sort Renderables with a custom comparator, objects are sorted by key
+    GLRENDER_API void sort(const Comparator& cmp);
+
+    /// Sort only the objects, by key like sort() does
+    GLRENDER_API void sortObjects();
     [[nodiscard]] GLRENDER_API bool empty() const;
+    
+    /// The number of Renderables plus the number of objects
     [[nodiscard]] GLRENDER_API size_t size() const;
     
     /// Optional.  If used, then all Renderables in this list will use this pipeline instead of their individual shaders
@@ -49,5 +62,12 @@ namespace glr
     std::optional<ShaderPipeline> shaderPipeline{};
     
     std::vector<Renderable> list{};
+    ObjectStore objects{};
+    
+    private:
+    //Reused between sorts
+    std::vector<uint64_t> sortKeys{};
+    std::vector<uint32_t> sortOrder{};
+    std::vector<Renderable> sortScratch{};
   };
 }
@@ -39,6 +39,7 @@ namespace glr
   struct TextureComp
   {
     ID texture = INVALID_ID;
+    uint32_t layer = 0; //Layer of an array texture, read by instanced shaders from the instance layer buffer, see Renderer::instancedBatching
     //std::shared_ptr<Texture> texture = nullptr;
   };
   
@@ -63,8 +64,15 @@ namespace glr
     GLRColorFormat glColorFormat{};
   };
 
+  /// Text is either laid out from a string using an atlas whose tiles are named after the characters they hold,
+  /// or, when text is empty, given one character at a time through characterInfo
   struct TextComp
   {
+    std::string text{};
+    ID atlas = INVALID_ID;
+    float fontSize = 1.0f;
+    Color color = {};
+    
     std::vector<CharInfo> characterInfo{};
   };
 
@@ -2,6 +2,7 @@
 
 #include "export.hh"
 #include "glrUtil.hh"
+#include "glrUniformBlock.hh"
 
 #include <commons/math/vec2.hh>
 #include <commons/math/vec3.hh>
@@ -12,6 +13,7 @@
 #include <variant>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "glrEnums.hh"
 
@@ -20,12 +22,21 @@ namespace glr
   /// An OpenGL frag/vert, or compute shader
   struct Shader
   {
-    using UniformValue = std::variant<float, int32_t, uint32_t, vec2<uint32_t>, vec2<int32_t>, vec2<float>, vec3<uint32_t>, vec3<int32_t>, vec3<float>, vec4<uint32_t>, vec4<int32_t>, vec4<float>, mat3x3<float>, mat4x4<float>>;
+    using UniformValue = glr::UniformValue;
     
     struct Uniform
     {
       int32_t handle = std::numeric_limits<int32_t>::max();
       UniformValue val{};
+      int32_t blockMember = -1; //Index in the shader's uniform block, or -1 if the uniform is set on its own
+      mutable bool dirty = false; //Changed since it was last sent
+    };
+    
+    /// How many uniform uploads sendUniforms() issued, and how many it skipped because the value hadn't changed
+    struct UniformStats
+    {
+      uint64_t sent = 0;
+      uint64_t skipped = 0;
     };
     
     Shader() = default;
@@ -44,14 +55,42 @@ namespace glr
     GLRENDER_API void reset();
     GLRENDER_API void use() const;
     GLRENDER_API void setUniform(const std::string& name, UniformValue val);
+    
+    /// Get the slot a uniform's value is stored in, adding the uniform if it hasn't been used yet
+    /// Slots stay the same for the life of this shader, see shaderRevision()
+    GLRENDER_API uint32_t uniformSlot(const std::string& name);
+    
+    /// Set a uniform by the slot returned from uniformSlot(), skipping the name lookup
+    GLRENDER_API void setUniform(uint32_t slot, UniformValue val);
+    
+    /// Send uniforms that changed since the last call, a uniform set to the value it already has isn't sent again
     GLRENDER_API void sendUniforms() const;
     
+    [[nodiscard]] GLRENDER_API const UniformStats& uniformStats() const;
+    GLRENDER_API void resetUniformStats();
+    
+    /// Store this shader's uniforms in one of its uniform or shader storage blocks instead of setting them one at a time
+    /// The layout is read from the linked program, uniforms in the block are still set through setUniform(),
+    /// sendUniforms() then uploads whatever changed in one call and binds the block
+    /// @param blockName The block's name in the shader source
+    /// @param binding The binding point to attach the block to
+    /// @return False if the program has no active block with that name
+    GLRENDER_API bool useUniformBlock(const std::string& blockName, uint32_t binding, GLRBlockType type = GLRBlockType::UNIFORM);
+    
     uint32_t handle = INVALID_HANDLE;
     
     GLRShaderType type = GLRShaderType::INVALID;
     
     private:
-    std::unordered_map<std::string, Uniform> uniforms = {};
+    std::vector<Uniform> uniforms = {};
+    std::unordered_map<std::string, uint32_t> uniformSlots = {};
+    mutable UniformBlock block{}; //Uploaded lazily from sendUniforms()
+    uint32_t blockBinding = INVALID_HANDLE;
+    mutable UniformStats stats{};
     bool init = false;
   };
+  
+  /// Incremented whenever any shader is created, destroyed, moved or reset
+  /// Anything holding Shader pointers or uniform slots should look them up again when this changes
+  [[nodiscard]] GLRENDER_API uint64_t shaderRevision();
 }
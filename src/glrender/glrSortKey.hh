@@ -0,0 +1,36 @@
+#pragma once
+
+#include "export.hh"
+#include "glrAssetID.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace glr
+{
+  //Bit layout of a render sort key, from most to least significant: layer, sublayer, shader, texture, mesh
+  //Shader, texture and mesh only group draws within a sublayer, so most of the key goes to the layers
+  inline constexpr uint32_t SORT_KEY_LAYER_BITS = 24;
+  inline constexpr uint32_t SORT_KEY_SUBLAYER_BITS = 16;
+  inline constexpr uint32_t SORT_KEY_SHADER_BITS = 8;
+  inline constexpr uint32_t SORT_KEY_TEXTURE_BITS = 8;
+  inline constexpr uint32_t SORT_KEY_MESH_BITS = 8;
+
+  //Lists at least this long are sorted on multiple threads
+  inline constexpr size_t PARALLEL_SORT_THRESHOLD = 65536;
+
+  /// Pack everything that decides draw order into one integer, sorting keys in ascending order draws higher layers and sublayers first
+  /// and groups objects that share a shader, texture and mesh
+  /// Layers past the end of their bit range are clamped, see sortKeyLayerFits(), asset IDs are reduced to their low bits
+  GLRENDER_API uint64_t makeSortKey(uint64_t layer, uint64_t sublayer, ID shader, ID texture, ID mesh);
+
+  /// True when a layer and sublayer are stored in a sort key as they are, larger ones are clamped and would share a key
+  [[nodiscard]] GLRENDER_API bool sortKeyLayerFits(uint64_t layer, uint64_t sublayer);
+
+  /// Stable least significant digit radix sort
+  /// @param keys The keys to sort, these are not modified
+  /// @param order Receives the sorted order, order[i] is the index into keys of the i-th smallest key
+  /// @param parallel Split the work across workerPool()
+  GLRENDER_API void radixSort(const std::vector<uint64_t>& keys, std::vector<uint32_t>& order, bool parallel = false);
+}
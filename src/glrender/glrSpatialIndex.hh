@@ -0,0 +1,144 @@
+#pragma once
+
+#include "export.hh"
+#include "glrAssetID.hh"
+#include "glrRenderable.hh"
+
+#include <commons/math/vec3.hh>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace glr
+{
+  /// An axis aligned box
+  struct Bounds
+  {
+    vec3<float> min{};
+    vec3<float> max{};
+  };
+
+  [[nodiscard]] GLRENDER_API bool boundsOverlap(const Bounds& a, const Bounds& b);
+
+  /// Radius of the sphere around an object's origin that holds its mesh however it's rotated, see Mesh::boundingRadius()
+  [[nodiscard]] GLRENDER_API float objectRadius(const TransformComp& transform, ID mesh);
+
+  /// The box around an object's bounding sphere
+  [[nodiscard]] GLRENDER_API Bounds objectBounds(const TransformComp& transform, ID mesh);
+
+  /// Finds objects by where they are without looking at every one of them, objects are identified by their ObjectStore handle
+  /// Queries return candidates, everything overlapping the query is included but some objects near it may be too
+  struct SpatialIndex
+  {
+    GLRENDER_API virtual ~SpatialIndex() = default;
+
+    GLRENDER_API virtual void insert(ID handle, const Bounds& bounds) = 0;
+
+    /// Called when an object moves or changes size
+    GLRENDER_API virtual void update(ID handle, const Bounds& bounds) = 0;
+
+    GLRENDER_API virtual void remove(ID handle) = 0;
+    GLRENDER_API virtual void clear() = 0;
+
+    /// Append the handles of objects that may overlap bounds to out
+    GLRENDER_API virtual void query(const Bounds& bounds, std::vector<ID>& out) const = 0;
+
+    [[nodiscard]] GLRENDER_API virtual std::unique_ptr<SpatialIndex> clone() const = 0;
+  };
+
+  /// Buckets objects into square cells on the x/y plane, z is ignored, suited to 2D layers where objects are of similar size
+  /// Moving an object only touches the cells it enters and leaves, a query visits the cells it covers
+  /// Objects covering more than MAX_OBJECT_CELLS cells are kept in a list every query checks instead
+  struct UniformGrid : SpatialIndex
+  {
+    /// @param cellSize The width and height of a cell, a few times the size of a typical object works well
+    GLRENDER_API explicit UniformGrid(float cellSize);
+
+    static constexpr uint64_t MAX_OBJECT_CELLS = 256;
+
+    GLRENDER_API void insert(ID handle, const Bounds& bounds) override;
+    GLRENDER_API void update(ID handle, const Bounds& bounds) override;
+    GLRENDER_API void remove(ID handle) override;
+    GLRENDER_API void clear() override;
+    GLRENDER_API void query(const Bounds& bounds, std::vector<ID>& out) const override;
+    [[nodiscard]] GLRENDER_API std::unique_ptr<SpatialIndex> clone() const override;
+
+    private:
+    struct CellRange //Empty for objects too big to be put in cells
+    {
+      int32_t minX = 0;
+      int32_t minY = 0;
+      int32_t maxX = -1;
+      int32_t maxY = -1;
+
+      bool operator==(const CellRange& other) const = default;
+    };
+
+    struct Entry
+    {
+      Bounds bounds{};
+      CellRange cells{};
+      mutable uint32_t stamp = 0; //The last query that returned this entry, so objects covering several cells are only returned once
+    };
+
+    [[nodiscard]] CellRange cellsOf(const Bounds& bounds) const;
+    [[nodiscard]] CellRange placementOf(const Bounds& bounds) const;
+    void addToCells(ID handle, const CellRange& cells);
+    void removeFromCells(ID handle, const CellRange& cells);
+
+    float cellSize = 1.0f;
+    std::unordered_map<uint64_t, std::vector<ID>> cells{};
+    std::vector<ID> oversized{};
+    std::unordered_map<ID, Entry> entries{};
+    mutable uint32_t queryStamp = 0;
+  };
+
+  /// A dynamic tree of boxes for 3D scenes, kept balanced with rotations as objects are added and removed
+  /// Leaves are stored with a margin around the object's bounds, so an object only has to be moved in the tree once it leaves its margin
+  struct BoundingVolumeHierarchy : SpatialIndex
+  {
+    /// @param margin How far past its bounds an object can move before it's moved in the tree
+    GLRENDER_API explicit BoundingVolumeHierarchy(float margin = 0.1f);
+
+    GLRENDER_API void insert(ID handle, const Bounds& bounds) override;
+    GLRENDER_API void update(ID handle, const Bounds& bounds) override;
+    GLRENDER_API void remove(ID handle) override;
+    GLRENDER_API void clear() override;
+    GLRENDER_API void query(const Bounds& bounds, std::vector<ID>& out) const override;
+    [[nodiscard]] GLRENDER_API std::unique_ptr<SpatialIndex> clone() const override;
+
+    private:
+    static constexpr int32_t NONE = -1;
+
+    struct Node
+    {
+      Bounds bounds{};
+      ID handle = INVALID_ID;
+      int32_t parent = NONE; //Next free node while the node is unused
+      int32_t left = NONE;
+      int32_t right = NONE;
+      int32_t height = 0; //0 for leaves, -1 for unused nodes
+
+      [[nodiscard]] bool isLeaf() const
+      {
+        return this->left == NONE;
+      }
+    };
+
+    int32_t allocateNode();
+    void freeNode(int32_t node);
+    void insertLeaf(int32_t leaf);
+    void removeLeaf(int32_t leaf);
+    void refitFrom(int32_t node);
+    int32_t balance(int32_t node);
+    void replaceChild(int32_t parent, int32_t oldChild, int32_t newChild);
+
+    float margin = 0.1f;
+    std::vector<Node> nodes{};
+    int32_t root = NONE;
+    int32_t freeList = NONE;
+    std::unordered_map<ID, int32_t> leaves{};
+    mutable std::vector<int32_t> stack{};
+  };
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "export.hh"
+#include "glrUtil.hh"
+#include "glrEnums.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace glr
+{
+  /// State changes asked of the StateCache, and how many of them were dropped because they wouldn't have changed anything
+  struct StateCacheStats
+  {
+    size_t issued = 0;
+    size_t filtered = 0;
+  };
+
+  /// Shadow of the OpenGL state glrender changes most often: the bound program, program pipeline, vertex array, framebuffer,
+  /// texture and image units, blend, depth, cull and scissor state and the viewport
+  /// Calls that would leave the state as it is never reach the driver, everything starts out unknown so the first call always does
+  /// There's one shared by every renderer, see stateCache(), so switching renderers or pipelines can't leave it out of date
+  /// Call invalidate() after changing any of this state through OpenGL directly
+  /// All functions must be called on the GL thread
+  struct StateCache
+  {
+    GLRENDER_API void useProgram(uint32_t program);
+    GLRENDER_API void bindProgramPipeline(uint32_t pipeline);
+    GLRENDER_API void bindVertexArray(uint32_t vertexArray);
+
+    /// Binds to both the draw and read framebuffer targets
+    GLRENDER_API void bindFramebuffer(uint32_t framebuffer);
+
+    GLRENDER_API void bindTexture(uint32_t unit, uint32_t texture);
+
+    /// Binds level 0 of a texture, and layer 0 of array textures
+    GLRENDER_API void bindImage(uint32_t unit, uint32_t texture, GLRIOMode mode, GLRColorFormat format);
+
+    GLRENDER_API void setBlend(bool enabled);
+    GLRENDER_API void setBlendFunc(uint32_t src, uint32_t dst);
+    GLRENDER_API void setDepthTest(bool enabled);
+    GLRENDER_API void setCullFace(bool enabled);
+    GLRENDER_API void setScissorTest(bool enabled);
+    GLRENDER_API void setScissor(int32_t x, int32_t y, int32_t width, int32_t height);
+    GLRENDER_API void setViewport(int32_t x, int32_t y, int32_t width, int32_t height);
+
+    /// INVALID_HANDLE when unknown
+    [[nodiscard]] GLRENDER_API uint32_t program() const;
+    [[nodiscard]] GLRENDER_API uint32_t vertexArray() const;
+    [[nodiscard]] GLRENDER_API uint32_t framebuffer() const;
+
+    /// Called before an object is deleted, OpenGL may hand its name to a new object which then has to be bound for real
+    GLRENDER_API void forgetProgram(uint32_t program);
+    GLRENDER_API void forgetProgramPipeline(uint32_t pipeline);
+    GLRENDER_API void forgetVertexArray(uint32_t vertexArray);
+    GLRENDER_API void forgetFramebuffer(uint32_t framebuffer);
+    GLRENDER_API void forgetTexture(uint32_t texture);
+
+    /// Treat all state as unknown, for a new context or after OpenGL was used directly
+    GLRENDER_API void invalidate();
+
+    [[nodiscard]] GLRENDER_API StateCacheStats stats() const;
+    GLRENDER_API void resetStats();
+
+    private:
+    static constexpr uint8_t UNKNOWN = 2;
+
+    struct Rect
+    {
+      int32_t x = -1;
+      int32_t y = -1;
+      int32_t width = -1; //Negative when unknown
+      int32_t height = -1;
+
+      bool operator==(const Rect& other) const = default;
+    };
+
+    struct ImageUnit
+    {
+      uint32_t texture = INVALID_HANDLE;
+      GLRIOMode mode = GLRIOMode::READ;
+      GLRColorFormat format = GLRColorFormat::RGBA8;
+    };
+
+    /// True when the call has to be made, counts it either way
+    bool changed(bool same);
+    void setCapability(uint8_t& current, uint32_t capability, bool enabled);
+
+    uint32_t currentProgram = INVALID_HANDLE;
+    uint32_t currentProgramPipeline = INVALID_HANDLE;
+    uint32_t currentVertexArray = INVALID_HANDLE;
+    uint32_t currentFramebuffer = INVALID_HANDLE;
+    std::vector<uint32_t> textureUnits{};
+    std::vector<ImageUnit> imageUnits{};
+
+    uint8_t blend = UNKNOWN;
+    uint8_t depthTest = UNKNOWN;
+    uint8_t cullFace = UNKNOWN;
+    uint8_t scissorTest = UNKNOWN;
+    uint32_t blendSrc = INVALID_HANDLE;
+    uint32_t blendDst = INVALID_HANDLE;
+    Rect scissor{};
+    Rect viewport{};
+
+    StateCacheStats counters{};
+  };
+
+  /// The state cache all of glrender binds through
+  GLRENDER_API StateCache& stateCache();
+}
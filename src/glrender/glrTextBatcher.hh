@@ -0,0 +1,100 @@
+#pragma once
+
+#include "export.hh"
+#include "glrAssetID.hh"
+#include "glrGlyphLayout.hh"
+#include "glrRenderable.hh"
+#include "glrUtil.hh"
+
+#include <commons/math/mat4.hh>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace glr
+{
+  //Number of frames the text ring buffer can have in flight on the GPU at once
+  inline constexpr uint32_t TEXT_RING_REGIONS = 3;
+
+  //Cached glyph quads of a string are dropped after this many frames without being drawn, checked once every this many frames
+  inline constexpr uint64_t TEXT_CACHE_LIFETIME = 60;
+
+  /// Vertex layout of batched glyph quads, position is already in world space
+  /// Attribute locations: 0 position (vec3), 1 UV (vec2), 3 color (normalized RGBA8 as vec4)
+  struct GlyphVertex
+  {
+    float x = 0;
+    float y = 0;
+    float z = 0;
+    float u = 0;
+    float v = 0;
+    uint32_t color = 0;
+  };
+
+  /// Collects the glyph quads of text renderables and draws all text sharing a texture and shader in one call
+  /// Quads are built once per string and only rebuilt when its content or transform change, strings are laid out through a GlyphLayoutCache,
+  /// each frame they're copied into a persistently mapped ring buffer so nothing is allocated on the GPU per frame
+  struct TextBatcher
+  {
+    GLRENDER_API TextBatcher() = default;
+    GLRENDER_API ~TextBatcher();
+
+    TextBatcher(TextBatcher const &copyFrom) = delete;
+    TextBatcher& operator=(TextBatcher const &copyFrom) = delete;
+
+    /// Queue a text renderable to be drawn on the next call to flush()
+    /// The renderable's components must stay alive until then
+    GLRENDER_API void add(const Renderable& renderable);
+
+    /// Draw all queued text, one draw call per texture and shader, and clear the queue
+    /// Can be called several times per frame, the text shader's mvp uniform is set to view * projection
+    /// @param view The view matrix
+    /// @param projection The projection matrix
+    GLRENDER_API void flush(const mat4x4<float>& view, const mat4x4<float>& projection);
+
+    /// Fence this frame's part of the ring buffer and move on to the next one, call once per frame after the last flush()
+    GLRENDER_API void endFrame();
+
+    /// True if there's text waiting to be drawn
+    [[nodiscard]] GLRENDER_API bool pending() const;
+
+    private:
+    struct CachedText
+    {
+      [[nodiscard]] bool matches(const TextComp& textComp, const TransformComp& transform) const;
+
+      GlyphLayoutKey layout{};
+      std::vector<CharInfo> characterInfo{};
+      TransformComp transform{};
+      std::vector<GlyphVertex> vertices{};
+      uint64_t lastUsed = 0;
+    };
+
+    struct QueuedText
+    {
+      const CachedText* text = nullptr;
+      ID texture = INVALID_ID;
+      ID shader = INVALID_ID;
+    };
+
+    void rebuild(CachedText& text, const TextComp& textComp, const TransformComp& transform);
+    void reserve(size_t vertices);
+    void waitForRegion(uint32_t region);
+
+    std::unordered_map<const TextComp*, CachedText> cache{};
+    GlyphLayoutCache layouts{};
+    std::vector<QueuedText> queue{};
+
+    uint32_t vao = INVALID_HANDLE;
+    uint32_t buffer = INVALID_HANDLE;
+    uint32_t sampler = INVALID_HANDLE; //Bilinear, bound over the atlas while drawing so the texture's own filter mode is left alone
+    GlyphVertex* mapped = nullptr;
+    size_t regionCapacity = 0; //In vertices
+    size_t regionUsed = 0; //Vertices written to the current region this frame
+    uint32_t region = 0;
+    bool regionReady = false;
+    std::array<void*, TEXT_RING_REGIONS> fences{}; //GLsync
+    uint64_t frame = 0;
+  };
+}
@@ -18,7 +18,21 @@ namespace glr
     std::string textureName;
   };
   
+  /// The number of mip levels in a full chain down to 1x1
+  [[nodiscard]] GLRENDER_API uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+  /// The size in bytes of one level of a block compressed texture
+  [[nodiscard]] GLRENDER_API size_t compressedLevelSize(GLRCompressedFormat format, uint32_t width, uint32_t height);
+
+  /// Build mip levels 1 and up on the CPU with a 2x2 box filter, the work for each level is split across workerPool()
+  /// The last row or column of an odd sized level is folded into its neighbours, so every pixel contributes to the next level
+  /// @param data Tightly packed 8 bit per channel pixels of level 0
+  /// @param threads The most threads to use, 0 uses one per hardware thread
+  /// @return Each level's pixels, smallest last, ready to pass to Texture::uploadMipChain()
+  [[nodiscard]] GLRENDER_API std::vector<std::vector<uint8_t>> downsampleMipChain(const uint8_t* data, uint32_t width, uint32_t height, uint8_t channels, uint32_t threads = 0);
+
   /// An on-VRAM OpenGL texture
+  /// Textures made with a TRILINEAR min filter get a full mip chain, filled in on the GPU when created from data
   struct Texture
   {
     Texture() = default;
@@ -29,6 +43,16 @@ namespace glr
     /// Create a texture from a flat array
     GLRENDER_API Texture(const std::string& name, const uint8_t* data, uint32_t width, uint32_t height, uint8_t channels, GLRFilterMode min = GLRFilterMode::NEAREST, GLRFilterMode mag = GLRFilterMode::NEAREST, bool sRGB = false);
     
+    /// Create a texture from block compressed data, no mips are generated so data must hold every level, largest first
+    /// @param levels The number of mip levels in data, use mipLevelCount() for a full chain
+    /// @param dataSize The size of data in bytes, levels past the end of data are left unset
+    GLRENDER_API Texture(const std::string& name, GLRCompressedFormat format, const uint8_t* data, size_t dataSize, uint32_t width, uint32_t height, uint32_t levels = 1, GLRFilterMode min = GLRFilterMode::BILINEAR, GLRFilterMode mag = GLRFilterMode::BILINEAR);
+    
+    /// Allocate an array texture whose layers all share one size and format, filled with addLayer()
+    /// Shaders sample it as a sampler2DArray, with the layer given by the renderable's TextureComp or ObjectStore entry
+    /// @param layers The number of layers to allocate, this can't change later
+    GLRENDER_API Texture(const std::string& name, uint32_t width, uint32_t height, uint8_t channels, uint32_t layers, GLRFilterMode min = GLRFilterMode::NEAREST, GLRFilterMode mag = GLRFilterMode::NEAREST, bool sRGB = false);
+    
     /// Generates a single color 1x1 texture
     GLRENDER_API explicit Texture(const std::string& name, uint8_t red = 255, uint8_t green = 255, uint8_t blue = 255, uint8_t alpha = 255, bool sRGB = false);
     
@@ -43,11 +67,34 @@ namespace glr
     GLRENDER_API bool exists() const;
     GLRENDER_API void reset();
     GLRENDER_API void use() const;
+    /// Filter mode and anisotropy are left as they are once bindlessHandle() was called
     GLRENDER_API void setFilterMode(GLRFilterMode min, GLRFilterMode mag) const;
     GLRENDER_API void setAnisotropyLevel(uint32_t level) const;
-    GLRENDER_API void subImage(const uint8_t* data, uint32_t w, uint32_t h, uint32_t xPos, uint32_t yPos, uint8_t channels) const;
+    GLRENDER_API void subImage(const uint8_t* data, uint32_t w, uint32_t h, uint32_t xPos, uint32_t yPos, uint8_t channels, uint32_t level = 0) const;
     GLRENDER_API void clear() const;
     
+    /// Fill levels 1 and up from level 0 on the GPU, call after changing level 0 with subImage()
+    GLRENDER_API void generateMipmaps() const;
+    
+    /// Fill levels 1 and up from pixels made by downsampleMipChain()
+    GLRENDER_API void uploadMipChain(const std::vector<std::vector<uint8_t>>& mips) const;
+    
+    /// Fill the next free layer of an array texture, call generateMipmaps() after adding layers if it has mips
+    /// @param data Pixels the size of a layer with the texture's channel count
+    /// @return The layer's index, or INVALID_HANDLE if this isn't an array texture or it's full
+    GLRENDER_API uint32_t addLayer(const uint8_t* data);
+    
+    /// Copy a texture of the same size and channel count into the next free layer of an array texture, on the GPU
+    /// @return The layer's index, or INVALID_HANDLE if the texture doesn't fit or the array is full
+    GLRENDER_API uint32_t addLayer(const Texture& source);
+    
+    /// Replace the contents of a layer of an array texture
+    GLRENDER_API void setLayer(uint32_t layer, const uint8_t* data) const;
+    
+    /// Get the ARB_bindless_texture handle of this texture and make it resident, the texture's filter modes can't be changed after this
+    /// @return 0 if bindless textures aren't supported
+    [[nodiscard]] GLRENDER_API uint64_t bindlessHandle() const;
+    
     [[nodiscard]] GLRENDER_API DownloadedImageData downloadTexture(uint8_t channels) const;
 
     //Instructions for how to bind this texture
@@ -60,10 +107,15 @@ namespace glr
     uint32_t width = 0;
     uint32_t height = 0;
     uint8_t channels = 4;
+    uint32_t levels = 1;
+    uint32_t layers = 0; //0 for a plain 2D texture, otherwise the layer count of an array texture
+    uint32_t layersUsed = 0;
+    bool compressed = false;
     std::string name;
     std::string path;
     
     private:
+    mutable uint64_t bindless = 0;
     bool init = false;
   };
 }
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "export.hh"
+#include "glrAssetID.hh"
+#include "glrUtil.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace glr
+{
+  //Default size of the staging ring textures are streamed through, see Renderer::Renderer()
+  inline constexpr size_t TEXTURE_STREAM_RING_SIZE = 16 * 1024 * 1024;
+
+  /// Identifies an upload queued on a TextureStreamer, tickets are handed out in increasing order starting at 1
+  using StreamTicket = uint64_t;
+
+  /// Called on the GL thread once an upload has landed in its texture, or with false if the texture no longer existed
+  using StreamCallback = std::function<void(bool success)>;
+
+  /// Streams pixel data into textures through a persistently mapped pixel unpack buffer used as a ring
+  /// Any thread can queue an upload, which copies the pixels into the ring and returns straight away,
+  /// the GL thread then issues the copies into the textures from update() and recycles ring space once the GPU is done with it
+  /// Uploads that don't fit in the ring right now wait in CPU memory until there's room, uploads bigger than the whole ring go through client memory
+  struct TextureStreamer
+  {
+    GLRENDER_API TextureStreamer() = default;
+    GLRENDER_API ~TextureStreamer();
+
+    TextureStreamer(TextureStreamer const &copyFrom) = delete;
+    TextureStreamer& operator=(TextureStreamer const &copyFrom) = delete;
+
+    /// Create the staging ring, must be called on the GL thread before anything is queued
+    /// @param bytes The size of the ring
+    GLRENDER_API void allocate(size_t bytes);
+
+    /// Queue pixels to be copied into part of a texture, safe to call from any thread
+    /// The texture can be one queued with asset_repo::queueTexture(), the upload and everything queued after it wait until it's created
+    /// Textures with mip levels have them regenerated after the upload
+    /// @param texture The texture to write to
+    /// @param data Tightly packed 8 bit per channel pixels, copied before this returns
+    /// @param width The width of the region to write
+    /// @param height The height of the region to write
+    /// @param xPos The left edge of the region to write
+    /// @param yPos The bottom edge of the region to write
+    /// @param channels The number of channels in data, 1, 2, 3 or 4
+    /// @param callback Optional, called on the GL thread when the upload is done
+    /// @return A ticket to check the upload's progress with
+    GLRENDER_API StreamTicket upload(ID texture, const uint8_t* data, uint32_t width, uint32_t height, uint32_t xPos, uint32_t yPos, uint8_t channels, StreamCallback callback = nullptr);
+
+    /// Issue queued uploads to the GPU and retire the ones it has finished, call once per frame on the GL thread
+    /// Renderer::render() does this for Renderer::textureStreamer
+    GLRENDER_API void update();
+
+    /// True once an upload has landed in its texture or failed, safe to call from any thread
+    [[nodiscard]] GLRENDER_API bool isDone(StreamTicket ticket) const;
+
+    /// Limits how many bytes update() hands to the GPU per call, at least one upload is always issued
+    size_t bytesPerUpdate = 8 * 1024 * 1024;
+
+    private:
+    struct Upload
+    {
+      StreamTicket ticket = 0;
+      ID texture = INVALID_ID;
+      uint32_t width = 0;
+      uint32_t height = 0;
+      uint32_t xPos = 0;
+      uint32_t yPos = 0;
+      uint8_t channels = 4;
+      size_t size = 0;
+      size_t offset = 0; //Into the ring
+      size_t reserved = 0; //Ring bytes held by this upload including padding, 0 if it isn't in the ring
+      std::vector<uint8_t> overflow{}; //Pixels waiting for ring space
+      bool ready = false; //Pixels have been fully written
+      bool success = false;
+      StreamCallback callback = nullptr;
+    };
+
+    struct Batch
+    {
+      void* fence = nullptr; //GLsync
+      std::vector<std::unique_ptr<Upload>> uploads{};
+    };
+
+    bool claim(Upload& upload);
+    void submit(Upload& upload);
+    void retire(Batch& batch);
+
+    std::mutex mutex{};
+    std::deque<std::unique_ptr<Upload>> queued{}; //Guarded by mutex
+    std::deque<Batch> inFlight{}; //GL thread only
+    StreamTicket nextTicket = 1; //Guarded by mutex
+    std::atomic<StreamTicket> retired = 0;
+
+    uint32_t buffer = INVALID_HANDLE;
+    uint8_t* mapped = nullptr;
+    size_t capacity = 0;
+    size_t head = 0; //Guarded by mutex
+    size_t used = 0; //Guarded by mutex
+    size_t overflowed = 0; //Queued uploads without ring space, guarded by mutex
+  };
+}
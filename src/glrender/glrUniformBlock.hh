@@ -0,0 +1,86 @@
+#pragma once
+
+#include "export.hh"
+#include "glrEnums.hh"
+#include "glrUtil.hh"
+
+#include <commons/math/vec2.hh>
+#include <commons/math/vec3.hh>
+#include <commons/math/vec4.hh>
+#include <commons/math/mat3.hh>
+#include <commons/math/mat4.hh>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace glr
+{
+  using UniformValue = std::variant<float, int32_t, uint32_t, vec2<uint32_t>, vec2<int32_t>, vec2<float>, vec3<uint32_t>, vec3<int32_t>, vec3<float>, vec4<uint32_t>, vec4<int32_t>, vec4<float>, mat3x3<float>, mat4x4<float>>;
+
+  /// CPU-side copy of a uniform (std140) or shader storage (std430) block
+  /// Values are written into the copy, upload() then sends everything that changed since the last upload in one call
+  struct UniformBlock
+  {
+    GLRENDER_API UniformBlock() = default;
+    GLRENDER_API explicit UniformBlock(GLRBlockType type);
+    GLRENDER_API ~UniformBlock();
+
+    UniformBlock(const UniformBlock& copyFrom) = delete;
+    UniformBlock& operator=(const UniformBlock& copyFrom) = delete;
+    GLRENDER_API UniformBlock(UniformBlock&& moveFrom) noexcept;
+    GLRENDER_API UniformBlock& operator=(UniformBlock&& moveFrom) noexcept;
+
+    /// Append a member after the existing ones, placed by std140 rules which std430 shares for non-array members
+    /// @param value Decides the member's type and is its initial value
+    /// @return The member's index
+    GLRENDER_API uint32_t addMember(const std::string& name, const UniformValue& value);
+
+    /// Add a member at a known offset, used for layouts read back from a linked program
+    /// @param matrixStride Distance in bytes between matrix columns, 0 for anything that isn't a matrix
+    /// @return The member's index
+    GLRENDER_API uint32_t addMember(const std::string& name, uint32_t offset, uint32_t matrixStride);
+
+    /// Grow the block to at least the given size in bytes
+    GLRENDER_API void resize(size_t size);
+
+    /// Get a member's index, or -1 if the block has no member with that name
+    [[nodiscard]] GLRENDER_API int32_t memberIndex(const std::string& name) const;
+
+    /// Write a member's value, names that aren't in the block are ignored
+    GLRENDER_API void set(const std::string& name, const UniformValue& value);
+    GLRENDER_API void set(uint32_t member, const UniformValue& value);
+
+    /// Write raw bytes into the block
+    GLRENDER_API void write(size_t offset, const void* bytes, size_t size);
+
+    /// Send the changed part of the block to the GPU, the buffer is created on first use
+    GLRENDER_API void upload();
+
+    /// Bind the block's buffer to a uniform or shader storage binding point, depending on the block's type
+    GLRENDER_API void bind(uint32_t binding) const;
+
+    [[nodiscard]] GLRENDER_API size_t size() const;
+    [[nodiscard]] GLRENDER_API bool empty() const;
+    [[nodiscard]] GLRENDER_API bool isDirty() const;
+
+    private:
+    struct Member
+    {
+      uint32_t offset = 0;
+      uint32_t matrixStride = 0;
+    };
+
+    GLRBlockType type = GLRBlockType::UNIFORM;
+    std::vector<uint8_t> data{};
+    std::vector<Member> members{};
+    std::unordered_map<std::string, uint32_t> memberIndices{};
+    size_t dirtyBegin = std::numeric_limits<size_t>::max();
+    size_t dirtyEnd = 0;
+    uint32_t buffer = INVALID_HANDLE;
+    size_t bufferSize = 0;
+  };
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "export.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace glr
+{
+  /// A fixed set of threads started once and reused, so splitting short jobs between threads doesn't cost starting new ones every time
+  /// One call to run() uses the pool at a time, others wait for it to finish
+  struct WorkerPool
+  {
+    /// @param threads How many threads run() splits work between, including the calling thread
+    GLRENDER_API explicit WorkerPool(uint32_t threads);
+    GLRENDER_API ~WorkerPool();
+
+    WorkerPool(WorkerPool const &copyFrom) = delete;
+    WorkerPool& operator=(WorkerPool const &copyFrom) = delete;
+
+    /// Call job(i) for every i in [0, count) on the pool's threads and the calling thread, returns once every call has finished
+    /// Jobs must not call run() on the same pool
+    GLRENDER_API void run(size_t count, const std::function<void(size_t)>& job);
+
+    /// The number of threads run() splits work between, including the calling thread
+    [[nodiscard]] GLRENDER_API uint32_t size() const;
+
+    private:
+    void loop();
+    void work(const std::function<void(size_t)>* job, size_t count);
+
+    std::vector<std::thread> threads{};
+    std::mutex runMutex{};
+    std::mutex mutex{};
+    std::condition_variable wake{};
+    std::condition_variable finished{};
+    const std::function<void(size_t)>* job = nullptr;
+    size_t count = 0;
+    std::atomic<size_t> next = 0;
+    size_t done = 0;
+    uint32_t active = 0; //Pool threads inside the current job
+    uint64_t generation = 0;
+    bool stopping = false;
+  };
+
+  /// The pool glrender's CPU work is split across, one thread per hardware thread, started on first use
+  GLRENDER_API WorkerPool& workerPool();
+}
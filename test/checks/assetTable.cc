@@ -0,0 +1,81 @@
+#include "check.hh"
+
+#include <glrender/glrAssetTable.hh>
+
+#include <string>
+
+using namespace glr;
+
+void checkGenerations()
+{
+  AssetTable<std::string> table{};
+  const ID first = table.emplace("first");
+  CHECK(table.contains(first));
+  CHECK(*table.at(first) == "first");
+  CHECK(table.size() == 1);
+
+  //A reused slot gets a new generation, so the old ID stays invalid
+  table.erase(first);
+  CHECK(!table.contains(first));
+  const ID second = table.emplace("second");
+  CHECK((uint32_t)second == (uint32_t)first);
+  CHECK(second != first);
+  CHECK(table.at(first) == nullptr);
+  CHECK(*table.at(second) == "second");
+
+  //Erasing through a stale ID leaves the new asset alone
+  table.erase(first);
+  CHECK(table.contains(second));
+  CHECK(table.size() == 1);
+
+  CHECK(!table.contains(INVALID_ID));
+  CHECK(!table.contains(0));
+  CHECK(!table.contains((ID)1 << 32 | 12345));
+}
+
+void checkReserved()
+{
+  AssetTable<int> table{};
+  const ID reserved = table.reserve();
+  CHECK(table.pending(reserved));
+  CHECK(!table.contains(reserved));
+  CHECK(table.emplaceAt(reserved, 7));
+  CHECK(!table.pending(reserved));
+  CHECK(*table.at(reserved) == 7);
+  CHECK(!table.emplaceAt(reserved, 8));
+
+  //Slots handed out by reserve() past the first page start out pending without the page existing
+  ID far = INVALID_ID;
+  for(uint32_t i = 0; i < AssetTable<int>::PAGE_SIZE * 2; i++)
+  {
+    far = table.reserve();
+  }
+  CHECK(table.pending(far));
+  CHECK(table.emplaceAt(far, 9));
+  CHECK(*table.at(far) == 9);
+}
+
+void checkClear()
+{
+  AssetTable<int> table{};
+  const ID live = table.emplace(1);
+  const ID reserved = table.reserve();
+  table.clear();
+  CHECK(table.size() == 0);
+  CHECK(!table.contains(live));
+  CHECK(!table.pending(reserved));
+  CHECK(!table.emplaceAt(reserved, 2));
+
+  //Slots are reused after a clear, with IDs that don't match any from before it
+  const ID fresh = table.emplace(3);
+  CHECK(fresh != live && fresh != reserved);
+  CHECK(*table.at(fresh) == 3);
+}
+
+int main()
+{
+  checkGenerations();
+  checkReserved();
+  checkClear();
+  return checkResult();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdio>
+
+//Checks for the parts of glrender that run without an OpenGL context, each file is its own executable run by ctest
+//A failed CHECK prints where it failed and carries on, main() returns checkResult() so any failure fails the test
+inline int checkFailures = 0;
+
+#define CHECK(condition) \
+  do \
+  { \
+    if(!(condition)) \
+    { \
+      std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      checkFailures++; \
+    } \
+  } while(false)
+
+inline int checkResult()
+{
+  return checkFailures == 0 ? 0 : 1;
+}
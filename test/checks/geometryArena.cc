@@ -0,0 +1,98 @@
+#include "check.hh"
+
+#include <glrender/glrGeometryArena.hh>
+
+using namespace glr;
+
+using FreeList = GeometryArena::FreeList;
+
+bool hasRanges(const FreeList& list, const std::map<uint32_t, uint32_t>& expected)
+{
+  return list.ranges == expected;
+}
+
+void checkTakeFirstFit()
+{
+  FreeList list{};
+  list.grow(100);
+  CHECK(hasRanges(list, {{0, 100}}));
+
+  uint32_t a = 0;
+  uint32_t b = 0;
+  uint32_t c = 0;
+  CHECK(list.take(10, a));
+  CHECK(list.take(20, b));
+  CHECK(list.take(30, c));
+  CHECK(a == 0 && b == 10 && c == 30);
+  CHECK(hasRanges(list, {{60, 40}}));
+
+  uint32_t tooBig = 0;
+  CHECK(!list.take(41, tooBig));
+
+  //The hole left by b is the first range big enough for a small allocation
+  list.give(b, 20);
+  uint32_t small = 0;
+  CHECK(list.take(5, small));
+  CHECK(small == 10);
+  CHECK(hasRanges(list, {{15, 15}, {60, 40}}));
+}
+
+void checkMerging()
+{
+  FreeList list{};
+  list.grow(100);
+  uint32_t offsets[4]{};
+  for(uint32_t& offset : offsets)
+  {
+    CHECK(list.take(25, offset));
+  }
+  CHECK(list.ranges.empty());
+
+  //Neither neighbour is free
+  list.give(offsets[1], 25);
+  CHECK(hasRanges(list, {{25, 25}}));
+
+  //Merges with the range before it
+  list.give(offsets[2], 25);
+  CHECK(hasRanges(list, {{25, 50}}));
+
+  //Merges with the range after it
+  list.give(offsets[0], 25);
+  CHECK(hasRanges(list, {{0, 75}}));
+
+  //Growing adds to the end and merges with a free range touching the old end
+  list.give(offsets[3], 25);
+  CHECK(hasRanges(list, {{0, 100}}));
+  list.grow(150);
+  CHECK(hasRanges(list, {{0, 150}}));
+  CHECK(list.capacity == 150);
+}
+
+void checkMergingBothSides()
+{
+  FreeList list{};
+  list.grow(30);
+  uint32_t a = 0;
+  uint32_t b = 0;
+  uint32_t c = 0;
+  CHECK(list.take(10, a));
+  CHECK(list.take(10, b));
+  CHECK(list.take(10, c));
+  list.give(a, 10);
+  list.give(c, 10);
+  CHECK(hasRanges(list, {{0, 10}, {20, 10}}));
+  list.give(b, 10);
+  CHECK(hasRanges(list, {{0, 30}}));
+
+  //Giving nothing back changes nothing
+  list.give(5, 0);
+  CHECK(hasRanges(list, {{0, 30}}));
+}
+
+int main()
+{
+  checkTakeFirstFit();
+  checkMerging();
+  checkMergingBothSides();
+  return checkResult();
+}
@@ -0,0 +1,56 @@
+#include "check.hh"
+
+#include <glrender/glrMesh.hh>
+
+#include <limits>
+
+using namespace glr;
+
+void checkFloatToHalf()
+{
+  CHECK(floatToHalf(0.0f) == 0x0000);
+  CHECK(floatToHalf(-0.0f) == 0x8000);
+  CHECK(floatToHalf(1.0f) == 0x3C00);
+  CHECK(floatToHalf(0.5f) == 0x3800);
+  CHECK(floatToHalf(-2.0f) == 0xC000);
+  CHECK(floatToHalf(1.0f / 3.0f) == 0x3555);
+
+  //Largest half, then values that round or overflow past it
+  CHECK(floatToHalf(65504.0f) == 0x7BFF);
+  CHECK(floatToHalf(65520.0f) == 0x7C00);
+  CHECK(floatToHalf(1.0e6f) == 0x7C00);
+  CHECK(floatToHalf(-1.0e6f) == 0xFC00);
+  CHECK(floatToHalf(std::numeric_limits<float>::infinity()) == 0x7C00);
+  const uint16_t nan = floatToHalf(std::numeric_limits<float>::quiet_NaN());
+  CHECK((nan & 0x7C00) == 0x7C00 && (nan & 0x03FF) != 0);
+
+  //Smallest normal half, anything below it flushes to zero
+  CHECK(floatToHalf(6.103515625e-05f) == 0x0400);
+  CHECK(floatToHalf(1.0e-8f) == 0x0000);
+  CHECK(floatToHalf(-1.0e-8f) == 0x8000);
+
+  //Rounds to nearest rather than truncating
+  CHECK(floatToHalf(1.0f + 1.0f / 1024.0f * 0.75f) == 0x3C01);
+  CHECK(floatToHalf(1.0f + 1.0f / 1024.0f * 0.25f) == 0x3C00);
+}
+
+void checkPackSnorm10()
+{
+  const float zero[3]{0.0f, 0.0f, 0.0f};
+  CHECK(packSnorm10(zero) == 0);
+
+  //-1 is stored as -511 in two's complement, w stays 0
+  const float axes[3]{1.0f, 0.0f, -1.0f};
+  CHECK(packSnorm10(axes) == (0x1FFu | 0x201u << 20));
+
+  //Out of range values are clamped, in between values round to nearest
+  const float clamped[3]{2.0f, -2.0f, 0.5f};
+  CHECK(packSnorm10(clamped) == (0x1FFu | 0x201u << 10 | 256u << 20));
+}
+
+int main()
+{
+  checkFloatToHalf();
+  checkPackSnorm10();
+  return checkResult();
+}
@@ -0,0 +1,111 @@
+#include "check.hh"
+
+#include <glrender/glrTexture.hh>
+
+#include <algorithm>
+#include <random>
+
+using namespace glr;
+
+//Straightforward box filter to compare against, each pixel of the next level averages a 2x2 block of the one before
+//The last block along an odd side also takes in the row or column that would otherwise be left over
+std::vector<uint8_t> referenceLevel(const std::vector<uint8_t>& src, const uint32_t srcWidth, const uint32_t srcHeight, const uint8_t channels)
+{
+  const uint32_t dstWidth = std::max(srcWidth / 2, 1u);
+  const uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+  const auto span = [](const uint32_t dst, const uint32_t dstSize, const uint32_t srcSize, uint32_t& first, uint32_t& last)
+  {
+    first = std::min(dst * 2, srcSize - 1);
+    last = std::min(dst * 2 + 1, srcSize - 1);
+    if(srcSize > 1 && srcSize % 2 == 1 && dst == dstSize - 1)
+    {
+      last = srcSize - 1;
+    }
+  };
+
+  std::vector<uint8_t> dst((size_t)dstWidth * dstHeight * channels);
+  for(uint32_t y = 0; y < dstHeight; y++)
+  {
+    uint32_t firstRow = 0;
+    uint32_t lastRow = 0;
+    span(y, dstHeight, srcHeight, firstRow, lastRow);
+    for(uint32_t x = 0; x < dstWidth; x++)
+    {
+      uint32_t firstColumn = 0;
+      uint32_t lastColumn = 0;
+      span(x, dstWidth, srcWidth, firstColumn, lastColumn);
+      //Sides of 1 are sampled twice, like the 2x2 filter does
+      const uint32_t rows = srcHeight == 1 ? 2 : lastRow - firstRow + 1;
+      const uint32_t columns = srcWidth == 1 ? 2 : lastColumn - firstColumn + 1;
+      for(uint8_t c = 0; c < channels; c++)
+      {
+        uint32_t sum = 0;
+        for(uint32_t row = 0; row < rows; row++)
+        {
+          for(uint32_t column = 0; column < columns; column++)
+          {
+            const uint32_t sy = std::min(firstRow + row, srcHeight - 1);
+            const uint32_t sx = std::min(firstColumn + column, srcWidth - 1);
+            sum += src[((size_t)sy * srcWidth + sx) * channels + c];
+          }
+        }
+        const uint32_t samples = rows * columns;
+        dst[((size_t)y * dstWidth + x) * channels + c] = (uint8_t)((sum + samples / 2) / samples);
+      }
+    }
+  }
+  return dst;
+}
+
+void checkChain(const uint32_t width, const uint32_t height, const uint8_t channels, const uint32_t threads)
+{
+  std::mt19937 random(width * 131 + height * 7 + channels);
+  std::vector<uint8_t> pixels((size_t)width * height * channels);
+  for(uint8_t& value : pixels)
+  {
+    value = (uint8_t)random();
+  }
+
+  const std::vector<std::vector<uint8_t>> chain = downsampleMipChain(pixels.data(), width, height, channels, threads);
+  CHECK(chain.size() == mipLevelCount(width, height) - 1);
+
+  std::vector<uint8_t> expected = pixels;
+  uint32_t levelWidth = width;
+  uint32_t levelHeight = height;
+  for(const std::vector<uint8_t>& level : chain)
+  {
+    expected = referenceLevel(expected, levelWidth, levelHeight, channels);
+    levelWidth = std::max(levelWidth / 2, 1u);
+    levelHeight = std::max(levelHeight / 2, 1u);
+    CHECK(level == expected);
+  }
+  CHECK(levelWidth == 1 && levelHeight == 1);
+}
+
+//A pixel in the last row or column of an odd level must still reach the next level
+void checkOddEdge()
+{
+  const std::vector<uint8_t> pixels{0, 0, 90,
+                                    0, 0, 90,
+                                    0, 0, 90};
+  const std::vector<std::vector<uint8_t>> chain = downsampleMipChain(pixels.data(), 3, 3, 1, 1);
+  CHECK(chain.size() == 1);
+  CHECK(chain[0] == std::vector<uint8_t>{30});
+}
+
+int main()
+{
+  checkOddEdge();
+  for(uint32_t width = 1; width <= 9; width++)
+  {
+    for(uint32_t height = 1; height <= 9; height++)
+    {
+      checkChain(width, height, (uint8_t)(1 + (width + height) % 4), 1);
+    }
+  }
+
+  //Big enough for each level to be split across the worker pool
+  checkChain(301, 517, 4, 0);
+  checkChain(1024, 255, 3, 0);
+  return checkResult();
+}
@@ -0,0 +1,84 @@
+#include "check.hh"
+
+#include <glrender/glrRenderList.hh>
+#include <glrender/glrSortKey.hh>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+using namespace glr;
+
+//The radix sort has to give the same order as a stable comparison sort, equal keys keep their original order
+void checkAgainstStableSort(const size_t count, const uint64_t keyRange, const bool parallel)
+{
+  std::mt19937_64 random(count);
+  std::vector<uint64_t> keys(count);
+  for(uint64_t& key : keys)
+  {
+    //Few distinct values so there are plenty of ties, spread over the high and low digits
+    key = random() % keyRange << 40 | random() % keyRange;
+  }
+
+  std::vector<uint32_t> expected(count);
+  std::iota(expected.begin(), expected.end(), 0u);
+  std::ranges::stable_sort(expected, [&](const uint32_t a, const uint32_t b)
+  {
+    return keys[a] < keys[b];
+  });
+
+  std::vector<uint32_t> order{};
+  radixSort(keys, order, parallel);
+  CHECK(order == expected);
+}
+
+void checkSortKeyOrder()
+{
+  //Higher layers and sublayers come first, then keys group by shader, texture and mesh
+  CHECK(makeSortKey(5, 0, 0, 0, 0) < makeSortKey(1, 0, 0, 0, 0));
+  CHECK(makeSortKey(1, 7, 0, 0, 0) < makeSortKey(1, 2, 0, 0, 0));
+  CHECK(makeSortKey(1, 2, 1, 9, 9) < makeSortKey(1, 2, 2, 0, 0));
+  CHECK(makeSortKey(1, 2, 1, 1, 9) < makeSortKey(1, 2, 1, 2, 0));
+  CHECK(makeSortKey(1, 2, 1, 1, 1) < makeSortKey(1, 2, 1, 1, 2));
+
+  CHECK(sortKeyLayerFits(4095, 4095));
+  CHECK(sortKeyLayerFits((1ull << SORT_KEY_LAYER_BITS) - 1, (1ull << SORT_KEY_SUBLAYER_BITS) - 1));
+  CHECK(!sortKeyLayerFits(1ull << SORT_KEY_LAYER_BITS, 0));
+  CHECK(!sortKeyLayerFits(0, 1ull << SORT_KEY_SUBLAYER_BITS));
+}
+
+//Layers too large for a key must still come out in order instead of being clamped together
+void checkLargeLayers()
+{
+  const std::vector<uint64_t> layers{5000, 1ull << 40, 1, (1ull << 40) + 1, 70000, 5000};
+  RenderList list{};
+  for(const uint64_t layer : layers)
+  {
+    list.objects.add({}, {layer, 0}, INVALID_ID, INVALID_ID, INVALID_ID);
+  }
+  list.sort();
+
+  std::vector<uint64_t> expected = layers;
+  std::ranges::sort(expected, std::greater{});
+  std::vector<uint64_t> sorted{};
+  for(const LayerComp& layer : list.objects.layers)
+  {
+    sorted.emplace_back(layer.layer);
+  }
+  CHECK(sorted == expected);
+  CHECK(!list.objects.orderChanged());
+}
+
+int main()
+{
+  for(const size_t count : {0, 1, 2, 100, 5000})
+  {
+    checkAgainstStableSort(count, 7, false);
+    checkAgainstStableSort(count, 1000, false);
+  }
+  checkAgainstStableSort(PARALLEL_SORT_THRESHOLD * 2, 7, true);
+  checkAgainstStableSort(PARALLEL_SORT_THRESHOLD * 2 + 3, 100000, true);
+  checkSortKeyOrder();
+  checkLargeLayers();
+  return checkResult();
+}
@@ -0,0 +1,105 @@
+#include "check.hh"
+
+#include <glrender/glrSpatialIndex.hh>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+using namespace glr;
+
+Bounds randomBounds(std::mt19937& random, const float extent, const float maxSize)
+{
+  std::uniform_real_distribution<float> position(-extent, extent);
+  std::uniform_real_distribution<float> size(0.0f, maxSize);
+  const vec3<float> min{position(random), position(random), position(random)};
+  return {min, {min.x() + size(random), min.y() + size(random), min.z() + size(random)}};
+}
+
+//Queries may return extra candidates, but never miss an overlapping object or return one twice
+void checkQuery(const SpatialIndex& index, const std::unordered_map<ID, Bounds>& objects, const Bounds& query)
+{
+  std::vector<ID> found{};
+  index.query(query, found);
+  std::ranges::sort(found);
+  CHECK(std::ranges::adjacent_find(found) == found.end());
+  for(const auto& [handle, bounds] : objects)
+  {
+    if(boundsOverlap(bounds, query))
+    {
+      CHECK(std::ranges::binary_search(found, handle));
+    }
+  }
+  for(const ID handle : found)
+  {
+    CHECK(objects.contains(handle));
+  }
+}
+
+void checkAgainstBruteForce(SpatialIndex& index)
+{
+  constexpr float inf = std::numeric_limits<float>::infinity();
+  std::mt19937 random(7);
+  std::unordered_map<ID, Bounds> objects{};
+  for(ID handle = 1; handle <= 500; handle++)
+  {
+    objects[handle] = randomBounds(random, 100.0f, 8.0f);
+    index.insert(handle, objects[handle]);
+  }
+
+  //Objects far bigger than the others, and one that covers everything
+  objects[1000] = {{-1.0e5f, -1.0e5f, -1.0f}, {1.0e5f, 1.0e5f, 1.0f}};
+  index.insert(1000, objects[1000]);
+  objects[1001] = {{-inf, -inf, -inf}, {inf, inf, inf}};
+  index.insert(1001, objects[1001]);
+
+  const auto checkQueries = [&]
+  {
+    for(int32_t i = 0; i < 100; i++)
+    {
+      checkQuery(index, objects, randomBounds(random, 120.0f, 40.0f));
+    }
+    checkQuery(index, objects, {{-inf, -inf, -inf}, {inf, inf, inf}});
+    checkQuery(index, objects, {{-inf, -inf, -inf}, {0.0f, 0.0f, 0.0f}});
+    checkQuery(index, objects, {{5000.0f, 5000.0f, 0.0f}, {5001.0f, 5001.0f, 0.0f}});
+  };
+  checkQueries();
+
+  //Move some objects a little and some a long way, then remove some
+  for(ID handle = 1; handle <= 500; handle += 3)
+  {
+    Bounds& bounds = objects[handle];
+    const float offset = handle % 2 ? 0.05f : 50.0f;
+    bounds.min.x() += offset;
+    bounds.max.x() += offset;
+    index.update(handle, bounds);
+  }
+  for(ID handle = 2; handle <= 500; handle += 5)
+  {
+    objects.erase(handle);
+    index.remove(handle);
+  }
+  objects.erase(1000);
+  index.remove(1000);
+  checkQueries();
+
+  //Copies answer the same queries
+  const std::unique_ptr<SpatialIndex> copy = index.clone();
+  checkQuery(*copy, objects, {{-inf, -inf, -inf}, {inf, inf, inf}});
+
+  index.clear();
+  std::vector<ID> found{};
+  index.query({{-inf, -inf, -inf}, {inf, inf, inf}}, found);
+  CHECK(found.empty());
+}
+
+int main()
+{
+  UniformGrid grid(4.0f);
+  checkAgainstBruteForce(grid);
+  BoundingVolumeHierarchy bvh(0.1f);
+  checkAgainstBruteForce(bvh);
+  return checkResult();
+}